@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "batch-receiver.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <istream>
+#include <streambuf>
+
+namespace {
+
+// Largest UDP payload
+const size_t MAX_DATAGRAM{65507};
+// Receive time and the drop counter of the socket
+const size_t CONTROL_SIZE{CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t))};
+// Longest a blocking receive waits before checking for stop() [us]
+const int64_t RECEIVE_TIMEOUT{100000};
+
+// Reads a datagram in place, for extractEnvelope()
+class DatagramBuffer : public std::streambuf {
+  public:
+    DatagramBuffer(char *data, size_t size)
+    {
+      setg(data, data, data + size);
+    }
+};
+
+bool isMulticast(const std::string &address)
+{
+  in_addr parsed;
+  if (inet_pton(AF_INET, address.c_str(), &parsed) != 1) {
+    return false;
+  }
+  const uint32_t first = ntohl(parsed.s_addr) >> 24;
+  return first >= 224 && first <= 239;
+}
+
+}
+
+BatchReceiver::BatchReceiver(const std::string &address, uint16_t port, const BatchReceiverConfig &config,
+    Delegate delegate)
+  : m_config(config)
+  , m_delegate(std::move(delegate))
+  , m_socket{-1}
+  , m_data(std::max(config.batch, 1u) * MAX_DATAGRAM)
+  , m_control(std::max(config.batch, 1u) * CONTROL_SIZE)
+  , m_iovecs(std::max(config.batch, 1u))
+  , m_messages(std::max(config.batch, 1u))
+  , m_kernelDropCounter{0}
+  , m_syscalls{0}
+  , m_datagrams{0}
+  , m_emptyPolls{0}
+  , m_kernelDrops{0}
+  , m_invalid{0}
+  , m_maxBatch{0}
+  , m_running{false}
+  , m_thread{}
+{
+  m_config.batch = static_cast<uint32_t>(m_messages.size());
+  in_addr group;
+  if (inet_pton(AF_INET, address.c_str(), &group) != 1) {
+    return;
+  }
+  const bool multicast = isMulticast(address);
+
+  m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (m_socket < 0) {
+    return;
+  }
+  // Shared with other receivers of the session on this machine; receive
+  // time, drop counter and a larger buffer are best effort
+  const int yes{1};
+  const int receiveBuffer{26214400};
+  const timeval timeout{0, static_cast<suseconds_t>(RECEIVE_TIMEOUT)};
+  bool ok = setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == 0
+    && setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0;
+  setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMPNS, &yes, sizeof(yes));
+  setsockopt(m_socket, SOL_SOCKET, SO_RXQ_OVFL, &yes, sizeof(yes));
+  setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+
+  sockaddr_in local;
+  std::memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_port = htons(port);
+  local.sin_addr.s_addr = multicast ? htonl(INADDR_ANY) : group.s_addr;
+  ok = ok && bind(m_socket, reinterpret_cast<sockaddr *>(&local), sizeof(local)) == 0;
+  if (ok && multicast) {
+    ip_mreq membership;
+    membership.imr_multiaddr = group;
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    ok = setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == 0;
+  }
+  if (!ok) {
+    close(m_socket);
+    m_socket = -1;
+    return;
+  }
+
+  for (uint32_t i = 0; i < m_config.batch; i++) {
+    m_iovecs[i].iov_base = &m_data[i * MAX_DATAGRAM];
+    m_iovecs[i].iov_len = MAX_DATAGRAM;
+    std::memset(&m_messages[i], 0, sizeof(mmsghdr));
+    m_messages[i].msg_hdr.msg_iov = &m_iovecs[i];
+    m_messages[i].msg_hdr.msg_iovlen = 1;
+    m_messages[i].msg_hdr.msg_control = &m_control[i * CONTROL_SIZE];
+    m_messages[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+  }
+  m_running.store(true, std::memory_order_relaxed);
+  m_thread = std::thread([this]() { run(); });
+}
+
+BatchReceiver::~BatchReceiver()
+{
+  stop();
+}
+
+bool BatchReceiver::isOpen() const
+{
+  return m_socket >= 0;
+}
+
+bool BatchReceiver::isRunning() const
+{
+  return m_running.load(std::memory_order_relaxed) && !cluon::TerminateHandler::instance().isTerminated.load();
+}
+
+void BatchReceiver::stop()
+{
+  m_running.store(false, std::memory_order_relaxed);
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (m_socket >= 0) {
+    close(m_socket);
+    m_socket = -1;
+  }
+}
+
+BatchReceiverCounters BatchReceiver::counters() const
+{
+  BatchReceiverCounters counters;
+  counters.syscalls = m_syscalls.load(std::memory_order_relaxed);
+  counters.datagrams = m_datagrams.load(std::memory_order_relaxed);
+  counters.emptyPolls = m_emptyPolls.load(std::memory_order_relaxed);
+  counters.kernelDrops = m_kernelDrops.load(std::memory_order_relaxed);
+  counters.invalid = m_invalid.load(std::memory_order_relaxed);
+  counters.maxBatch = m_maxBatch.load(std::memory_order_relaxed);
+  return counters;
+}
+
+void BatchReceiver::run()
+{
+  using Clock = std::chrono::steady_clock;
+  const auto busyPoll = std::chrono::microseconds(m_config.busyPoll);
+  Clock::time_point pollUntil{};
+  while (isRunning()) {
+    // Blocks for the first datagram and takes what else is queued, or only
+    // looks while busy-polling
+    const bool polling = m_config.busyPoll > 0 && Clock::now() < pollUntil;
+    const int received = recvmmsg(m_socket, m_messages.data(), m_config.batch,
+        polling ? MSG_DONTWAIT : MSG_WAITFORONE, nullptr);
+    if (received > 0) {
+      handle(static_cast<uint32_t>(received));
+      if (m_config.busyPoll > 0) {
+        pollUntil = Clock::now() + busyPoll;
+      }
+    } else if (polling) {
+      m_emptyPolls.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void BatchReceiver::handle(uint32_t count)
+{
+  m_syscalls.fetch_add(1, std::memory_order_relaxed);
+  m_datagrams.fetch_add(count, std::memory_order_relaxed);
+  if (count > m_maxBatch.load(std::memory_order_relaxed)) {
+    m_maxBatch.store(count, std::memory_order_relaxed);
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    msghdr &header = m_messages[i].msg_hdr;
+    cluon::data::TimeStamp received;
+    bool stamped{false};
+    for (cmsghdr *control = CMSG_FIRSTHDR(&header); control != nullptr; control = CMSG_NXTHDR(&header, control)) {
+      if (control->cmsg_level != SOL_SOCKET) {
+        continue;
+      }
+      if (control->cmsg_type == SCM_TIMESTAMPNS) {
+        timespec time;
+        std::memcpy(&time, CMSG_DATA(control), sizeof(time));
+        received.seconds(static_cast<int32_t>(time.tv_sec)).microseconds(static_cast<int32_t>(time.tv_nsec / 1000));
+        stamped = true;
+      } else if (control->cmsg_type == SO_RXQ_OVFL) {
+        // Total of the socket so far, wraps around
+        uint32_t drops;
+        std::memcpy(&drops, CMSG_DATA(control), sizeof(drops));
+        m_kernelDrops.fetch_add(drops - m_kernelDropCounter, std::memory_order_relaxed);
+        m_kernelDropCounter = drops;
+      }
+    }
+
+    if ((header.msg_flags & MSG_TRUNC) != 0) {
+      m_invalid.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      DatagramBuffer buffer(static_cast<char *>(m_iovecs[i].iov_base), m_messages[i].msg_len);
+      std::istream in(&buffer);
+      auto envelope = cluon::extractEnvelope(in);
+      if (envelope.first) {
+        envelope.second.received(stamped ? received : cluon::time::now());
+        m_delegate(std::move(envelope.second));
+      } else {
+        m_invalid.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    // The kernel shrinks these to what it used
+    header.msg_controllen = CONTROL_SIZE;
+    header.msg_flags = 0;
+    m_messages[i].msg_len = 0;
+  }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCH_RECEIVER_H
+#define BATCH_RECEIVER_H
+
+#include "cluon-complete.hpp"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Receives OD4 envelopes like the UDPReceiver of a cluon::OD4Session, but
+// takes up to a batch of datagrams per recvmmsg() into buffers allocated up
+// front. Envelopes are decoded straight from these buffers and stamped with
+// the kernel receive time. After traffic, the socket can optionally be
+// polled without sleeping for a bounded time, so a burst is picked up
+// without a wake-up per datagram.
+
+struct BatchReceiverConfig {
+  uint32_t batch;              // Datagrams per system call
+  uint32_t busyPoll;           // Poll without blocking this long after a datagram [us], 0 blocks right away
+};
+
+struct BatchReceiverCounters {
+  uint64_t syscalls;           // recvmmsg() calls that returned datagrams
+  uint64_t datagrams;
+  uint64_t emptyPolls;         // Busy-poll calls that found nothing
+  uint64_t kernelDrops;        // Dropped by the socket for a full receive buffer
+  uint64_t invalid;            // Truncated or not an envelope
+  uint32_t maxBatch;
+};
+
+class BatchReceiver {
+  public:
+    using Delegate = std::function<void(cluon::data::Envelope &&envelope)>;
+
+  public:
+    // Joins the group of a multicast address, else receives on the port of
+    // the given address
+    BatchReceiver(const std::string &address, uint16_t port, const BatchReceiverConfig &config, Delegate delegate);
+    BatchReceiver(const BatchReceiver &) = delete;
+    BatchReceiver &operator=(const BatchReceiver &) = delete;
+    ~BatchReceiver();
+
+  public:
+    bool isOpen() const;
+    // Also false once the process is asked to terminate
+    bool isRunning() const;
+    void stop();
+    BatchReceiverCounters counters() const;
+
+  private:
+    void run();
+    void handle(uint32_t count);
+
+  private:
+    BatchReceiverConfig m_config;
+    Delegate m_delegate;
+    int m_socket;
+    std::vector<char> m_data;
+    std::vector<char> m_control;
+    std::vector<iovec> m_iovecs;
+    std::vector<mmsghdr> m_messages;
+    uint32_t m_kernelDropCounter;
+    std::atomic<uint64_t> m_syscalls;
+    std::atomic<uint64_t> m_datagrams;
+    std::atomic<uint64_t> m_emptyPolls;
+    std::atomic<uint64_t> m_kernelDrops;
+    std::atomic<uint64_t> m_invalid;
+    std::atomic<uint32_t> m_maxBatch;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
+#endif
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "controller-batch.hpp"
+
+#include <algorithm>
+
+// The AVX2 path is compiled for that instruction set only in its own
+// function and chosen at runtime, so the binary still runs on any x86-64
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CONTROLLER_BATCH_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Vehicles per AVX2 register, the arrays are padded to a multiple of it
+const uint32_t LANES{8};
+// Largest torque magnitude converted to an integer
+const float TORQUE_RANGE{2.0e9f};
+
+// Raw views of the arrays for the step kernels
+struct BatchArrays {
+  const float *leftWheelSpeed;
+  const float *rightWheelSpeed;
+  const float *speedRequest;
+  const float *accelerationRequest;
+  const float *kp;
+  const float *ki;
+  const float *kd;
+  const float *derivativeFilterTime;
+  const float *backCalculationGain;
+  const float *feedForwardGain;
+  const float *outputMin;
+  const float *outputMax;
+  const float *regenCutoffSpeed;
+  const float *useIntegral;
+  const float *useDerivative;
+  const float *useClamping;
+  const float *useBackCalculation;
+  float *integral;
+  float *previousError;
+  float *derivative;
+  float *unsaturatedOutput;
+  float *output;
+  float *initialized;
+  int32_t *torque;
+};
+
+// Same expressions in the same order as controllerStep(), controllerTrackOutput()
+// and the regeneration cutoff in Motion::step()
+void stepLanes(const BatchArrays &a, uint32_t begin, uint32_t end, float dt)
+{
+  for (uint32_t i = begin; i < end; i++) {
+    const float speed = (a.leftWheelSpeed[i] + a.rightWheelSpeed[i]) * 0.5f;
+    const float speedError = a.speedRequest[i] - speed;
+    const float proportional = a.kp[i] * speedError;
+    const float feedForward = a.feedForwardGain[i] * a.accelerationRequest[i];
+
+    const float alpha = dt / (a.derivativeFilterTime[i] + dt);
+    const float rawDerivative = a.kd[i] * (speedError - a.previousError[i]) / std::max(dt, 1e-6f);
+    a.derivative[i] += a.useDerivative[i] * a.initialized[i] * alpha * (rawDerivative - a.derivative[i]);
+
+    const float excess = a.output[i] - a.unsaturatedOutput[i];
+    const float windingUp = (excess * speedError < 0.0f) ? 1.0f : 0.0f;
+    const float integrate = a.useIntegral[i] * (1.0f - a.useClamping[i] * windingUp);
+    a.integral[i] += integrate * a.ki[i] * speedError * dt;
+
+    const float unsaturated = proportional + a.integral[i] + a.derivative[i] + feedForward;
+    const float output = std::min(std::max(unsaturated, a.outputMin[i]), a.outputMax[i]);
+    const float backCalculation = a.useIntegral[i] * a.useBackCalculation[i] * a.backCalculationGain[i];
+    a.integral[i] += backCalculation * (output - unsaturated) * dt;
+
+    const float applied = (speed < a.regenCutoffSpeed[i] && output < 0.0f) ? 0.0f : output;
+    a.integral[i] += backCalculation * (applied - output) * dt;
+
+    a.unsaturatedOutput[i] = unsaturated;
+    a.output[i] = applied;
+    a.previousError[i] = speedError;
+    a.initialized[i] = 1.0f;
+    const float motorTorque = std::min(std::max(applied * 0.5f, -TORQUE_RANGE), TORQUE_RANGE);
+    a.torque[2 * i] = static_cast<int32_t>(motorTorque);
+    a.torque[2 * i + 1] = static_cast<int32_t>(motorTorque);
+  }
+}
+
+#ifdef CONTROLLER_BATCH_AVX2
+__attribute__((target("avx2")))
+void stepLanesAvx2(const BatchArrays &a, uint32_t lanes, float dt)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 vdt = _mm256_set1_ps(dt);
+  const __m256 dtDivisor = _mm256_max_ps(vdt, _mm256_set1_ps(1e-6f));
+  const __m256 range = _mm256_set1_ps(TORQUE_RANGE);
+  const __m256 negativeRange = _mm256_set1_ps(-TORQUE_RANGE);
+  // Duplicates each vehicle's torque for its two motors
+  const __m256i lowHalf = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+  const __m256i highHalf = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+  for (uint32_t i = 0; i < lanes; i += LANES) {
+    const __m256 speed = _mm256_mul_ps(
+        _mm256_add_ps(_mm256_loadu_ps(a.leftWheelSpeed + i), _mm256_loadu_ps(a.rightWheelSpeed + i)), half);
+    const __m256 speedError = _mm256_sub_ps(_mm256_loadu_ps(a.speedRequest + i), speed);
+    const __m256 proportional = _mm256_mul_ps(_mm256_loadu_ps(a.kp + i), speedError);
+    const __m256 feedForward = _mm256_mul_ps(_mm256_loadu_ps(a.feedForwardGain + i),
+        _mm256_loadu_ps(a.accelerationRequest + i));
+
+    const __m256 alpha = _mm256_div_ps(vdt, _mm256_add_ps(_mm256_loadu_ps(a.derivativeFilterTime + i), vdt));
+    const __m256 previousError = _mm256_loadu_ps(a.previousError + i);
+    const __m256 rawDerivative = _mm256_div_ps(
+        _mm256_mul_ps(_mm256_loadu_ps(a.kd + i), _mm256_sub_ps(speedError, previousError)), dtDivisor);
+    __m256 derivative = _mm256_loadu_ps(a.derivative + i);
+    const __m256 derivativeGain = _mm256_mul_ps(_mm256_mul_ps(
+          _mm256_loadu_ps(a.useDerivative + i), _mm256_loadu_ps(a.initialized + i)), alpha);
+    derivative = _mm256_add_ps(derivative, _mm256_mul_ps(derivativeGain, _mm256_sub_ps(rawDerivative, derivative)));
+
+    const __m256 excess = _mm256_sub_ps(_mm256_loadu_ps(a.output + i), _mm256_loadu_ps(a.unsaturatedOutput + i));
+    const __m256 windingUp = _mm256_and_ps(_mm256_cmp_ps(_mm256_mul_ps(excess, speedError), zero, _CMP_LT_OQ), one);
+    const __m256 useIntegral = _mm256_loadu_ps(a.useIntegral + i);
+    const __m256 integrate = _mm256_mul_ps(useIntegral,
+        _mm256_sub_ps(one, _mm256_mul_ps(_mm256_loadu_ps(a.useClamping + i), windingUp)));
+    __m256 integral = _mm256_loadu_ps(a.integral + i);
+    integral = _mm256_add_ps(integral, _mm256_mul_ps(_mm256_mul_ps(
+            _mm256_mul_ps(integrate, _mm256_loadu_ps(a.ki + i)), speedError), vdt));
+
+    const __m256 unsaturated = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(proportional, integral), derivative), feedForward);
+    // Operands in the order of std::min(std::max(x, lo), hi), which agree for non-NaN values
+    const __m256 output = _mm256_min_ps(_mm256_max_ps(unsaturated, _mm256_loadu_ps(a.outputMin + i)),
+        _mm256_loadu_ps(a.outputMax + i));
+    const __m256 backCalculation = _mm256_mul_ps(_mm256_mul_ps(useIntegral,
+          _mm256_loadu_ps(a.useBackCalculation + i)), _mm256_loadu_ps(a.backCalculationGain + i));
+    integral = _mm256_add_ps(integral, _mm256_mul_ps(_mm256_mul_ps(backCalculation,
+            _mm256_sub_ps(output, unsaturated)), vdt));
+
+    const __m256 regen = _mm256_and_ps(_mm256_cmp_ps(speed, _mm256_loadu_ps(a.regenCutoffSpeed + i), _CMP_LT_OQ),
+        _mm256_cmp_ps(output, zero, _CMP_LT_OQ));
+    const __m256 applied = _mm256_andnot_ps(regen, output);
+    integral = _mm256_add_ps(integral, _mm256_mul_ps(_mm256_mul_ps(backCalculation,
+            _mm256_sub_ps(applied, output)), vdt));
+
+    _mm256_storeu_ps(a.derivative + i, derivative);
+    _mm256_storeu_ps(a.integral + i, integral);
+    _mm256_storeu_ps(a.unsaturatedOutput + i, unsaturated);
+    _mm256_storeu_ps(a.output + i, applied);
+    _mm256_storeu_ps(a.previousError + i, speedError);
+    _mm256_storeu_ps(a.initialized + i, one);
+
+    const __m256 motorTorque = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(applied, half), negativeRange), range);
+    const __m256i torque = _mm256_cvttps_epi32(motorTorque);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(a.torque + 2 * i), _mm256_permutevar8x32_epi32(torque, lowHalf));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(a.torque + 2 * i + LANES), _mm256_permutevar8x32_epi32(torque, highHalf));
+  }
+}
+#endif
+
+}
+
+ControllerBatch::ControllerBatch(uint32_t vehicles, const ControllerConfig &config, float regenCutoffSpeed)
+  : m_size{vehicles}
+  , m_leftWheelSpeed{}
+  , m_rightWheelSpeed{}
+  , m_speedRequest{}
+  , m_accelerationRequest{}
+  , m_kp{}
+  , m_ki{}
+  , m_kd{}
+  , m_derivativeFilterTime{}
+  , m_backCalculationGain{}
+  , m_feedForwardGain{}
+  , m_outputMin{}
+  , m_outputMax{}
+  , m_regenCutoffSpeed{}
+  , m_useIntegral{}
+  , m_useDerivative{}
+  , m_useClamping{}
+  , m_useBackCalculation{}
+  , m_integral{}
+  , m_previousError{}
+  , m_derivative{}
+  , m_unsaturatedOutput{}
+  , m_output{}
+  , m_initialized{}
+  , m_torque{}
+{
+  resize((vehicles + LANES - 1) / LANES * LANES);
+  // Padding lanes are configured too, so they compute finite values
+  for (uint32_t i = 0; i < m_kp.size(); i++) {
+    configure(i, config, regenCutoffSpeed);
+  }
+}
+
+void ControllerBatch::resize(uint32_t lanes)
+{
+  for (std::vector<float> *array : {&m_leftWheelSpeed, &m_rightWheelSpeed, &m_speedRequest,
+      &m_accelerationRequest, &m_kp, &m_ki, &m_kd, &m_derivativeFilterTime, &m_backCalculationGain,
+      &m_feedForwardGain, &m_outputMin, &m_outputMax, &m_regenCutoffSpeed, &m_useIntegral,
+      &m_useDerivative, &m_useClamping, &m_useBackCalculation, &m_integral, &m_previousError,
+      &m_derivative, &m_unsaturatedOutput, &m_output, &m_initialized}) {
+    array->assign(lanes, 0.0f);
+  }
+  m_torque.assign(2 * lanes, 0);
+}
+
+uint32_t ControllerBatch::size() const
+{
+  return m_size;
+}
+
+void ControllerBatch::configure(uint32_t vehicle, const ControllerConfig &config, float regenCutoffSpeed)
+{
+  m_kp[vehicle] = config.kp;
+  m_ki[vehicle] = config.ki;
+  m_kd[vehicle] = config.kd;
+  m_derivativeFilterTime[vehicle] = config.derivativeFilterTime;
+  m_backCalculationGain[vehicle] = config.backCalculationGain;
+  m_feedForwardGain[vehicle] = config.feedForwardGain;
+  m_outputMin[vehicle] = config.outputMin;
+  m_outputMax[vehicle] = config.outputMax;
+  m_regenCutoffSpeed[vehicle] = regenCutoffSpeed;
+  m_useIntegral[vehicle] = (config.type == ControllerType::PI || config.type == ControllerType::PID) ? 1.0f : 0.0f;
+  m_useDerivative[vehicle] = (config.type == ControllerType::PID) ? 1.0f : 0.0f;
+  m_useClamping[vehicle] = (config.antiWindup == AntiWindup::Clamping) ? 1.0f : 0.0f;
+  m_useBackCalculation[vehicle] = (config.antiWindup == AntiWindup::BackCalculation) ? 1.0f : 0.0f;
+  reset(vehicle);
+}
+
+void ControllerBatch::reset(uint32_t vehicle)
+{
+  const ControllerState state = initialControllerState();
+  m_integral[vehicle] = state.integral;
+  m_previousError[vehicle] = state.previousError;
+  m_derivative[vehicle] = state.derivative;
+  m_unsaturatedOutput[vehicle] = state.unsaturatedOutput;
+  m_output[vehicle] = state.output;
+  m_initialized[vehicle] = static_cast<float>(state.initialized);
+}
+
+void ControllerBatch::setWheelSpeeds(uint32_t vehicle, float left, float right)
+{
+  m_leftWheelSpeed[vehicle] = left;
+  m_rightWheelSpeed[vehicle] = right;
+}
+
+void ControllerBatch::setSpeedRequest(uint32_t vehicle, float speedRequest, float accelerationRequest)
+{
+  m_speedRequest[vehicle] = speedRequest;
+  m_accelerationRequest[vehicle] = accelerationRequest;
+}
+
+void ControllerBatch::step(float dt)
+{
+  run(dt, vectorized());
+}
+
+void ControllerBatch::stepScalar(float dt)
+{
+  run(dt, false);
+}
+
+void ControllerBatch::run(float dt, bool vector)
+{
+  BatchArrays a{m_leftWheelSpeed.data(), m_rightWheelSpeed.data(), m_speedRequest.data(),
+    m_accelerationRequest.data(), m_kp.data(), m_ki.data(), m_kd.data(), m_derivativeFilterTime.data(),
+    m_backCalculationGain.data(), m_feedForwardGain.data(), m_outputMin.data(), m_outputMax.data(),
+    m_regenCutoffSpeed.data(), m_useIntegral.data(), m_useDerivative.data(), m_useClamping.data(),
+    m_useBackCalculation.data(), m_integral.data(), m_previousError.data(), m_derivative.data(),
+    m_unsaturatedOutput.data(), m_output.data(), m_initialized.data(), m_torque.data()};
+#ifdef CONTROLLER_BATCH_AVX2
+  if (vector) {
+    stepLanesAvx2(a, static_cast<uint32_t>(m_kp.size()), dt);
+    return;
+  }
+#endif
+  static_cast<void>(vector);
+  stepLanes(a, 0, m_size, dt);
+}
+
+bool ControllerBatch::vectorized()
+{
+#ifdef CONTROLLER_BATCH_AVX2
+  static const bool AVX2{__builtin_cpu_supports("avx2") != 0};
+  return AVX2;
+#else
+  return false;
+#endif
+}
+
+MotorTorques ControllerBatch::torque(uint32_t vehicle) const
+{
+  return MotorTorques{{m_torque[2 * vehicle], m_torque[2 * vehicle + 1]}};
+}
+
+ControllerState ControllerBatch::state(uint32_t vehicle) const
+{
+  ControllerState state;
+  state.integral = m_integral[vehicle];
+  state.previousError = m_previousError[vehicle];
+  state.derivative = m_derivative[vehicle];
+  state.unsaturatedOutput = m_unsaturatedOutput[vehicle];
+  state.output = m_output[vehicle];
+  state.initialized = static_cast<uint32_t>(m_initialized[vehicle]);
+  return state;
+}
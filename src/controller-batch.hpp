@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTROLLER_BATCH_H
+#define CONTROLLER_BATCH_H
+
+#include "controller.hpp"
+#include "output-stage.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// The control law of controller.hpp for many vehicles at once, for
+// simulations with hundreds of cars per process. Inputs, configuration and
+// state of all vehicles are kept as one array per quantity, and a step runs
+// the same arithmetic as controllerStep() and the regeneration cutoff of
+// Motion over all of them, eight vehicles per instruction with AVX2 when the
+// CPU has it and one at a time otherwise. Both paths give the same results.
+// The vehicle speed is the average of the two wheel speeds, the torque is
+// split evenly between the motors.
+
+class ControllerBatch {
+  public:
+    // Vehicles start with the given configuration and all inputs zero
+    ControllerBatch(uint32_t vehicles, const ControllerConfig &config, float regenCutoffSpeed);
+
+  public:
+    uint32_t size() const;
+    void configure(uint32_t vehicle, const ControllerConfig &config, float regenCutoffSpeed);
+    void reset(uint32_t vehicle);
+
+    void setWheelSpeeds(uint32_t vehicle, float left, float right);
+    // Requested acceleration [m/s^2] for the feed-forward
+    void setSpeedRequest(uint32_t vehicle, float speedRequest, float accelerationRequest);
+
+    // Steps all vehicles by dt [s]
+    void step(float dt);
+    // The portable path, whatever the CPU
+    void stepScalar(float dt);
+    static bool vectorized();
+
+    MotorTorques torque(uint32_t vehicle) const;
+    ControllerState state(uint32_t vehicle) const;
+
+  private:
+    void resize(uint32_t lanes);
+    void run(float dt, bool vector);
+
+  private:
+    uint32_t m_size;
+    // Inputs
+    std::vector<float> m_leftWheelSpeed;
+    std::vector<float> m_rightWheelSpeed;
+    std::vector<float> m_speedRequest;
+    std::vector<float> m_accelerationRequest;
+    // Configuration, the law and anti-windup as 0/1 masks
+    std::vector<float> m_kp;
+    std::vector<float> m_ki;
+    std::vector<float> m_kd;
+    std::vector<float> m_derivativeFilterTime;
+    std::vector<float> m_backCalculationGain;
+    std::vector<float> m_feedForwardGain;
+    std::vector<float> m_outputMin;
+    std::vector<float> m_outputMax;
+    std::vector<float> m_regenCutoffSpeed;
+    std::vector<float> m_useIntegral;
+    std::vector<float> m_useDerivative;
+    std::vector<float> m_useClamping;
+    std::vector<float> m_useBackCalculation;
+    // State
+    std::vector<float> m_integral;
+    std::vector<float> m_previousError;
+    std::vector<float> m_derivative;
+    std::vector<float> m_unsaturatedOutput;
+    std::vector<float> m_output;
+    std::vector<float> m_initialized;
+    // Per motor torque request [cNm]
+    std::vector<int32_t> m_torque;
+};
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "controller.hpp"
+
+#include <algorithm>
+#include <limits>
+
+ControllerConfig defaultControllerConfig(float modelGain)
+{
+  ControllerConfig config;
+  config.type = ControllerType::P;
+  config.antiWindup = AntiWindup::BackCalculation;
+  config.kp = modelGain;
+  config.ki = 0.5f * modelGain;
+  config.kd = 0.0f;
+  config.derivativeFilterTime = 0.05f;
+  config.backCalculationGain = 1.0f;
+  config.feedForwardGain = 0.0f;
+  config.outputMin = -std::numeric_limits<float>::max();
+  config.outputMax = std::numeric_limits<float>::max();
+  return config;
+}
+
+bool parseControllerType(const std::string &name, ControllerType &type)
+{
+  if (name == "p") {
+    type = ControllerType::P;
+  } else if (name == "pi") {
+    type = ControllerType::PI;
+  } else if (name == "pid") {
+    type = ControllerType::PID;
+  } else if (name == "mpc") {
+    type = ControllerType::MPC;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool parseAntiWindup(const std::string &name, AntiWindup &antiWindup)
+{
+  if (name == "none") {
+    antiWindup = AntiWindup::None;
+  } else if (name == "clamping") {
+    antiWindup = AntiWindup::Clamping;
+  } else if (name == "back-calculation") {
+    antiWindup = AntiWindup::BackCalculation;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+ControllerState initialControllerState()
+{
+  ControllerState state;
+  state.integral = 0.0f;
+  state.previousError = 0.0f;
+  state.derivative = 0.0f;
+  state.unsaturatedOutput = 0.0f;
+  state.output = 0.0f;
+  state.initialized = 0;
+  return state;
+}
+
+float controllerStep(const ControllerConfig &config, ControllerState &state,
+    float speedError, float accelerationRequest, float dt)
+{
+  // Masks for the terms of the selected control law
+  const float useIntegral = (config.type == ControllerType::PI || config.type == ControllerType::PID) ? 1.0f : 0.0f;
+  const float useDerivative = (config.type == ControllerType::PID) ? 1.0f : 0.0f;
+  const float useClamping = (config.antiWindup == AntiWindup::Clamping) ? 1.0f : 0.0f;
+  const float useBackCalculation = (config.antiWindup == AntiWindup::BackCalculation) ? 1.0f : 0.0f;
+  const float useInitialized = static_cast<float>(state.initialized);
+
+  const float proportional = config.kp * speedError;
+  const float feedForward = config.feedForwardGain * accelerationRequest;
+
+  // Derivative on the error through a first order low-pass filter; skipped on
+  // the very first step where there is no previous error to compare with
+  const float alpha = dt / (config.derivativeFilterTime + dt);
+  const float rawDerivative = config.kd * (speedError - state.previousError) / std::max(dt, 1e-6f);
+  state.derivative += useDerivative * useInitialized * alpha * (rawDerivative - state.derivative);
+
+  // Integrate unless clamping is active and the last output was saturated
+  // in the same direction as the error
+  const float excess = state.output - state.unsaturatedOutput;
+  const float windingUp = (excess * speedError < 0.0f) ? 1.0f : 0.0f;
+  const float integrate = useIntegral * (1.0f - useClamping * windingUp);
+  state.integral += integrate * config.ki * speedError * dt;
+
+  const float unsaturated = proportional + state.integral + state.derivative + feedForward;
+  const float output = std::min(std::max(unsaturated, config.outputMin), config.outputMax);
+
+  state.integral += useIntegral * useBackCalculation * config.backCalculationGain
+    * (output - unsaturated) * dt;
+
+  state.unsaturatedOutput = unsaturated;
+  state.output = output;
+  state.previousError = speedError;
+  state.initialized = 1;
+  return output;
+}
+
+void controllerTrackOutput(const ControllerConfig &config, ControllerState &state,
+    float appliedOutput, float dt)
+{
+  const float useIntegral = (config.type == ControllerType::PI || config.type == ControllerType::PID) ? 1.0f : 0.0f;
+  const float useBackCalculation = (config.antiWindup == AntiWindup::BackCalculation) ? 1.0f : 0.0f;
+
+  // Only the part of the saturation not already accounted for in the step
+  state.integral += useIntegral * useBackCalculation * config.backCalculationGain
+    * (appliedOutput - state.output) * dt;
+  state.output = appliedOutput;
+}
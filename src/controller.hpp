@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <cstdint>
+#include <string>
+
+// Longitudinal speed controller engine. Configuration and state are plain
+// fixed-size structs, so a step never allocates and controllers can be copied
+// freely. The control law is selected at runtime through the config; unused
+// terms are masked out arithmetically rather than branched on.
+
+enum class ControllerType : uint8_t {
+  P,
+  PI,
+  PID,
+  // Model-predictive, see mpc-controller.hpp; controllerStep() runs the P law
+  // as its fallback
+  MPC
+};
+
+enum class AntiWindup : uint8_t {
+  None,
+  // Stop integrating while the output is saturated in the direction of the error
+  Clamping,
+  // Bleed the integral by the saturation excess, scaled by backCalculationGain
+  BackCalculation
+};
+
+struct ControllerConfig {
+  ControllerType type;
+  AntiWindup antiWindup;
+  float kp;                    // [cNm / (m/s)]
+  float ki;                    // [cNm / m]
+  float kd;                    // [cNm / (m/s^2)]
+  float derivativeFilterTime;  // First order filter time constant [s]
+  float backCalculationGain;   // [1/s]
+  float feedForwardGain;       // Torque per requested acceleration [cNm / (m/s^2)]
+  float outputMin;             // [cNm]
+  float outputMax;             // [cNm]
+};
+
+struct ControllerState {
+  float integral;              // Integral term contribution [cNm]
+  float previousError;
+  float derivative;            // Filtered derivative term [cNm]
+  float unsaturatedOutput;
+  float output;
+  uint32_t initialized;
+};
+
+ControllerConfig defaultControllerConfig(float modelGain);
+bool parseControllerType(const std::string &name, ControllerType &type);
+bool parseAntiWindup(const std::string &name, AntiWindup &antiWindup);
+
+ControllerState initialControllerState();
+
+// Returns the saturated controller output for the given speed error [m/s] and
+// requested acceleration [m/s^2] over the sample time dt [s].
+float controllerStep(const ControllerConfig &config, ControllerState &state,
+    float speedError, float accelerationRequest, float dt);
+
+// Feeds back the torque that was actually applied after any later output
+// stage, so that back-calculation also accounts for downstream limits.
+void controllerTrackOutput(const ControllerConfig &config, ControllerState &state,
+    float appliedOutput, float dt);
+#endif
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cycle-log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <ostream>
+
+namespace {
+
+const uint32_t BYTE_ORDER_MARK{0x01020304};
+
+uint32_t roundUpToPowerOfTwo(uint32_t value)
+{
+  uint32_t result{1};
+  while (result < value && result < (1u << 31)) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}
+
+CycleLogWriter::CycleLogWriter(const std::string &path, uint32_t capacity, float flushInterval, float pollInterval)
+  : m_ring(roundUpToPowerOfTwo(capacity))
+  , m_mask{m_ring.size() - 1}
+  , m_file{path.empty() ? nullptr : std::fopen(path.c_str(), "wb")}
+  , m_flushInterval{flushInterval}
+  , m_pollInterval{pollInterval}
+  , m_head{0}
+  , m_tail{0}
+  , m_dropped{0}
+  , m_written{0}
+  , m_mutex{}
+  , m_wakeup{}
+  , m_running{false}
+  , m_thread{}
+{
+  if (m_file == nullptr) {
+    return;
+  }
+  const CycleLogHeader header{CYCLE_LOG_MAGIC, CYCLE_LOG_VERSION,
+    static_cast<uint32_t>(sizeof(CycleRecord)), BYTE_ORDER_MARK};
+  if (std::fwrite(&header, sizeof(header), 1, m_file) != 1) {
+    std::fclose(m_file);
+    m_file = nullptr;
+    return;
+  }
+  m_running = true;
+  m_thread = std::thread([this]() { run(); });
+}
+
+CycleLogWriter::~CycleLogWriter()
+{
+  stop();
+}
+
+bool CycleLogWriter::isOpen() const
+{
+  return m_file != nullptr;
+}
+
+bool CycleLogWriter::push(const CycleRecord &record)
+{
+  const uint64_t head = m_head.load(std::memory_order_relaxed);
+  if (head - m_tail.load(std::memory_order_acquire) > m_mask) {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  m_ring[head & m_mask] = record;
+  m_head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+void CycleLogWriter::stop()
+{
+  if (m_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = false;
+    }
+    m_wakeup.notify_one();
+    m_thread.join();
+  }
+  if (m_file != nullptr) {
+    drain();
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+uint32_t CycleLogWriter::capacity() const
+{
+  return static_cast<uint32_t>(m_ring.size());
+}
+
+uint64_t CycleLogWriter::pushed() const
+{
+  return m_head.load(std::memory_order_relaxed);
+}
+
+uint64_t CycleLogWriter::dropped() const
+{
+  return m_dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t CycleLogWriter::written() const
+{
+  return m_written.load(std::memory_order_relaxed);
+}
+
+// Polls instead of being woken by push(), so the control thread never enters
+// the kernel for the log
+void CycleLogWriter::run()
+{
+  const auto poll = std::chrono::duration<float>(m_pollInterval);
+  const auto flush = std::chrono::duration<float>(m_flushInterval);
+  auto lastFlush = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_wakeup.wait_for(lock, poll, [this]() { return !m_running; })) {
+    drain();
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastFlush >= flush) {
+      std::fflush(m_file);
+      lastFlush = now;
+    }
+  }
+}
+
+// Writes everything pushed so far, at most two contiguous pieces of the ring
+void CycleLogWriter::drain()
+{
+  const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+  const uint64_t head = m_head.load(std::memory_order_acquire);
+  uint64_t position = tail;
+  while (position != head) {
+    const uint64_t index = position & m_mask;
+    const uint64_t count = std::min(head - position, m_ring.size() - index);
+    const size_t done = std::fwrite(&m_ring[index], sizeof(CycleRecord), count, m_file);
+    position += done;
+    if (done != count) {
+      // Disk full or gone, the records are lost rather than blocking the ring
+      m_dropped.fetch_add(head - position, std::memory_order_relaxed);
+      position = head;
+    }
+  }
+  m_written.fetch_add(position - tail, std::memory_order_relaxed);
+  m_tail.store(position, std::memory_order_release);
+}
+
+bool readCycleLog(const std::string &path, std::vector<CycleRecord> &records, std::string &error)
+{
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    error = "cannot open " + path;
+    return false;
+  }
+  CycleLogHeader header{};
+  bool valid = std::fread(&header, sizeof(header), 1, file) == 1;
+  if (!valid || header.magic != CYCLE_LOG_MAGIC) {
+    error = path + " is not a cycle log";
+  } else if (header.byteOrder != BYTE_ORDER_MARK) {
+    error = path + " was written with another byte order";
+  } else if (header.version != CYCLE_LOG_VERSION || header.recordSize != sizeof(CycleRecord)) {
+    error = path + " has record version " + std::to_string(header.version) + " of "
+      + std::to_string(header.recordSize) + " bytes, expected " + std::to_string(CYCLE_LOG_VERSION)
+      + " of " + std::to_string(sizeof(CycleRecord));
+  } else {
+    // A partly written last record, from a crash, is ignored
+    CycleRecord record;
+    while (std::fread(&record, sizeof(record), 1, file) == 1) {
+      records.push_back(record);
+    }
+    std::fclose(file);
+    return true;
+  }
+  std::fclose(file);
+  return false;
+}
+
+void writeCycleCsvHeader(std::ostream &out, char delimiter)
+{
+  const char *columns[] = {"sequence", "time", "leftWheelSpeedReceived", "rightWheelSpeedReceived",
+    "speedRequestReceived", "rearWheelSpeedReceived", "dt", "leftWheelSpeed", "rightWheelSpeed",
+    "rearLeftWheelSpeed", "rearRightWheelSpeed", "speedRequest", "steeringRequest", "vehicleSpeed",
+    "reference", "referenceAcceleration", "speedError", "controllerTorque", "integral",
+    "distributedTorqueLeft", "distributedTorqueRight", "torqueLeft", "torqueRight", "parameterVersion",
+    "speedEstimateValid", "regenClamped", "previewValid", "mpcActive", "mpcFallback", "emergencyStop",
+    "failSafeState", "staleInputs", "outputLimited", "wheelSpeedSamples"};
+  bool first{true};
+  for (const char *column : columns) {
+    if (!first) {
+      out << delimiter;
+    }
+    out << column;
+    first = false;
+  }
+  out << '\n';
+}
+
+void writeCycleCsvRow(std::ostream &out, const CycleRecord &record, char delimiter)
+{
+  // Enough digits to read back every float exactly
+  const std::streamsize precision = out.precision(std::numeric_limits<float>::max_digits10);
+  const char d = delimiter;
+  auto flag = [&record](uint32_t mask) { return (record.flags & mask) != 0 ? 1 : 0; };
+  out << record.sequence << d << record.time << d << record.leftWheelSpeedReceived << d
+    << record.rightWheelSpeedReceived << d << record.speedRequestReceived << d
+    << record.rearWheelSpeedReceived << d << record.dt << d << record.leftWheelSpeed << d
+    << record.rightWheelSpeed << d << record.rearLeftWheelSpeed << d << record.rearRightWheelSpeed << d
+    << record.speedRequest << d << record.steeringRequest << d << record.vehicleSpeed << d
+    << record.reference << d << record.referenceAcceleration << d << record.speedError << d
+    << record.controllerTorque << d << record.integral << d << record.distributedTorque[0] << d
+    << record.distributedTorque[1] << d << record.torque[0] << d << record.torque[1] << d
+    << record.parameterVersion << d << flag(CYCLE_SPEED_ESTIMATE_VALID) << d << flag(CYCLE_REGEN_CLAMPED) << d
+    << flag(CYCLE_PREVIEW_VALID) << d << flag(CYCLE_MPC_ACTIVE) << d << flag(CYCLE_MPC_FALLBACK) << d << flag(CYCLE_EMERGENCY_STOP) << d
+    << static_cast<uint32_t>(record.failSafeState) << d << static_cast<uint32_t>(record.staleInputs) << d
+    << static_cast<uint32_t>(record.outputLimited) << d << static_cast<uint32_t>(record.wheelSpeedSamples) << '\n';
+  out.precision(precision);
+}
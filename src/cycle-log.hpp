@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CYCLE_LOG_H
+#define CYCLE_LOG_H
+
+#include "cycle-record.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Binary log of CycleRecords: a 16 byte header followed by the records as
+// they are in memory. The header carries the record size and a byte order
+// mark, so a log is only read back by a build with the same layout.
+
+const uint32_t CYCLE_LOG_MAGIC{0x474c4343}; // "CCLG"
+const uint32_t CYCLE_LOG_VERSION{1};
+
+struct CycleLogHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t byteOrder;          // 0x01020304 as written
+};
+
+// Streams records from one control thread to a file. push() copies the
+// record into a ring allocated up front and returns; it never waits, never
+// allocates and never makes a system call. A writer thread wakes up every
+// poll interval, writes what has arrived and flushes the file every flush
+// interval. Records that find the ring full are dropped and counted.
+class CycleLogWriter {
+  public:
+    // Capacity is rounded up to a power of two, intervals in [s]. Not open,
+    // and without a writer thread, for an empty path.
+    CycleLogWriter(const std::string &path, uint32_t capacity, float flushInterval, float pollInterval);
+    CycleLogWriter(const CycleLogWriter &) = delete;
+    CycleLogWriter &operator=(const CycleLogWriter &) = delete;
+    // Writes what is left in the ring
+    ~CycleLogWriter();
+
+  public:
+    bool isOpen() const;
+    // Only ever called from one thread
+    bool push(const CycleRecord &record);
+    // Writes the remaining records and closes the file, idempotent
+    void stop();
+
+    uint32_t capacity() const;
+    uint64_t pushed() const;
+    uint64_t dropped() const;
+    uint64_t written() const;
+
+  private:
+    void run();
+    void drain();
+
+  private:
+    std::vector<CycleRecord> m_ring;
+    uint64_t m_mask;
+    std::FILE *m_file;
+    const float m_flushInterval;
+    const float m_pollInterval;
+    // Producer and consumer positions on separate cache lines
+    alignas(64) std::atomic<uint64_t> m_head;
+    alignas(64) std::atomic<uint64_t> m_tail;
+    alignas(64) std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_written;
+    // Only wakes the writer early on stop(), push() does not touch them
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_running;
+    std::thread m_thread;
+};
+
+// All records of a log, false with an error message if it is not a cycle log
+// of this build
+bool readCycleLog(const std::string &path, std::vector<CycleRecord> &records, std::string &error);
+
+void writeCycleCsvHeader(std::ostream &out, char delimiter);
+void writeCycleCsvRow(std::ostream &out, const CycleRecord &record, char delimiter);
+#endif
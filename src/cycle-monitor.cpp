@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cycle-monitor.hpp"
+
+#include <cstdlib>
+
+// All times are in microseconds.
+CycleMonitor::CycleMonitor(float freq)
+  : m_period{static_cast<int64_t>(1000000.0f / ((freq > 0.0f) ? freq : 1.0f))}
+  , m_lastCycleStart{0}
+  , m_lastJitter{0}
+  , m_maxJitter{0}
+  , m_sumJitter{0}
+  , m_maxComputeTime{0}
+  , m_cycles{0}
+  , m_overruns{0}
+{
+}
+
+void CycleMonitor::record(int64_t cycleStart, int64_t cycleEnd)
+{
+  const int64_t computeTime = cycleEnd - cycleStart;
+  if (computeTime > m_maxComputeTime) {
+    m_maxComputeTime = computeTime;
+  }
+
+  bool overrun = computeTime > m_period;
+
+  // The first cycle has no predecessor to measure the interval against
+  if (m_cycles > 0) {
+    const int64_t interval = cycleStart - m_lastCycleStart;
+    m_lastJitter = interval - m_period;
+
+    const int64_t absJitter = std::llabs(m_lastJitter);
+    if (absJitter > m_maxJitter) {
+      m_maxJitter = absJitter;
+    }
+    m_sumJitter += absJitter;
+
+    if (m_lastJitter > m_period) {
+      overrun = true;
+    }
+  }
+
+  if (overrun) {
+    m_overruns++;
+  }
+  m_lastCycleStart = cycleStart;
+  m_cycles++;
+}
+
+void CycleMonitor::reset()
+{
+  m_lastCycleStart = 0;
+  m_lastJitter = 0;
+  m_maxJitter = 0;
+  m_sumJitter = 0;
+  m_maxComputeTime = 0;
+  m_cycles = 0;
+  m_overruns = 0;
+}
+
+int64_t CycleMonitor::period() const
+{
+  return m_period;
+}
+
+uint64_t CycleMonitor::cycles() const
+{
+  return m_cycles;
+}
+
+uint64_t CycleMonitor::overruns() const
+{
+  return m_overruns;
+}
+
+int64_t CycleMonitor::lastJitter() const
+{
+  return m_lastJitter;
+}
+
+int64_t CycleMonitor::maxJitter() const
+{
+  return m_maxJitter;
+}
+
+float CycleMonitor::meanJitter() const
+{
+  if (m_cycles < 2) {
+    return 0.0f;
+  }
+  return static_cast<float>(m_sumJitter) / static_cast<float>(m_cycles - 1);
+}
+
+int64_t CycleMonitor::maxComputeTime() const
+{
+  return m_maxComputeTime;
+}
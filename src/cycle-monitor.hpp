@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CYCLE_MONITOR_H
+#define CYCLE_MONITOR_H
+
+#include <cstdint>
+
+// Keeps track of how well a periodic control loop holds its sample time.
+// Jitter is the deviation of the measured cycle start interval from the
+// nominal period, an overrun is a cycle whose start was late by more than a
+// period or whose work did not fit into one period.
+class CycleMonitor {
+  public:
+    explicit CycleMonitor(float freq);
+
+  public:
+    void record(int64_t cycleStart, int64_t cycleEnd);
+    void reset();
+
+    int64_t period() const;
+    uint64_t cycles() const;
+    uint64_t overruns() const;
+    int64_t lastJitter() const;
+    int64_t maxJitter() const;
+    float meanJitter() const;
+    int64_t maxComputeTime() const;
+
+  private:
+    int64_t m_period;
+    int64_t m_lastCycleStart;
+    int64_t m_lastJitter;
+    int64_t m_maxJitter;
+    int64_t m_sumJitter;
+    int64_t m_maxComputeTime;
+    uint64_t m_cycles;
+    uint64_t m_overruns;
+};
+#endif
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CYCLE_RECORD_H
+#define CYCLE_RECORD_H
+
+#include <cstdint>
+#include <type_traits>
+
+// What one Motion::step() saw, computed and sent, as a fixed-size plain
+// record. It is written to the cycle log byte for byte, so fields are only
+// ever appended and the layout has no padding.
+
+enum CycleFlag : uint32_t {
+  CYCLE_SPEED_ESTIMATE_VALID = 1u << 0,
+  // Negative torque below the regeneration cutoff was set to zero
+  CYCLE_REGEN_CLAMPED = 1u << 1,
+  CYCLE_PREVIEW_VALID = 1u << 2,
+  CYCLE_MPC_ACTIVE = 1u << 3,
+  // The MPC did not finish and the P law was used
+  CYCLE_MPC_FALLBACK = 1u << 4,
+  // RES emergency stop latched, torque held at zero
+  CYCLE_EMERGENCY_STOP = 1u << 5
+};
+
+struct CycleRecord {
+  uint64_t sequence;                // Steps since the Motion instance was created
+  int64_t time;                     // Of the step [us]
+  int64_t leftWheelSpeedReceived;   // [us]
+  int64_t rightWheelSpeedReceived;  // [us]
+  int64_t speedRequestReceived;     // [us]
+  int64_t rearWheelSpeedReceived;   // [us]
+  float dt;                         // [s]
+  float leftWheelSpeed;             // [m/s]
+  float rightWheelSpeed;            // [m/s]
+  float rearLeftWheelSpeed;         // [m/s]
+  float rearRightWheelSpeed;        // [m/s]
+  float speedRequest;               // As received [m/s]
+  float steeringRequest;            // [rad]
+  float vehicleSpeed;               // Used by the controller [m/s]
+  float reference;                  // Interpolated speed request [m/s]
+  float referenceAcceleration;      // [m/s^2]
+  float speedError;                 // [m/s]
+  float controllerTorque;           // Total, before the regeneration cutoff [cNm]
+  float integral;                   // Integral term after the step [cNm]
+  float distributedTorque[2];       // Left, right after the slip limiter [cNm]
+  int32_t torque[2];                // Left, right as sent [cNm]
+  uint32_t parameterVersion;
+  uint32_t flags;                   // CycleFlag
+  uint8_t failSafeState;            // FailSafeState
+  uint8_t staleInputs;              // Bit mask over WatchedInput
+  uint8_t outputLimited;            // OutputStageState::limited
+  uint8_t wheelSpeedSamples;        // Drained by the step, all wheels, at most 255
+};
+
+static_assert(std::is_trivially_copyable<CycleRecord>::value, "CycleRecord is written as raw bytes");
+static_assert(sizeof(CycleRecord) == 128, "CycleRecord layout changed, bump CYCLE_LOG_VERSION");
+#endif
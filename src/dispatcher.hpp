@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include "cluon-complete.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+
+// Routes incoming envelopes by (message ID, senderStamp) through a flat table
+// of plain function pointers. Installed as the single catch-all delegate of an
+// OD4Session, it replaces the session's one-delegate-per-ID map, so several
+// handlers can subscribe to the same message ID.
+
+const uint32_t ANY_SENDER_STAMP{0xFFFFFFFF};
+
+using EnvelopeHandler = void (*)(void *context, const cluon::data::Envelope &envelope);
+
+struct Route {
+  int32_t dataType;
+  uint32_t senderStamp;
+  EnvelopeHandler handler;
+  void *context;
+};
+
+template <typename Context, void (*Handler)(Context &, const cluon::data::Envelope &)>
+void invokeHandler(void *context, const cluon::data::Envelope &envelope)
+{
+  Handler(*static_cast<Context *>(context), envelope);
+}
+
+template <typename Context, void (*Handler)(Context &, const cluon::data::Envelope &)>
+constexpr Route makeRoute(int32_t dataType, uint32_t senderStamp, Context &context)
+{
+  return Route{dataType, senderStamp, &invokeHandler<Context, Handler>, &context};
+}
+
+// One table out of the routes of several modules, in order
+template <size_t N, size_t M>
+std::array<Route, N + M> joinRoutes(const std::array<Route, N> &first, const std::array<Route, M> &second)
+{
+  std::array<Route, N + M> routes;
+  for (size_t i = 0; i < N; i++) {
+    routes[i] = first[i];
+  }
+  for (size_t i = 0; i < M; i++) {
+    routes[N + i] = second[i];
+  }
+  return routes;
+}
+
+// Decodes a message without taking over the envelope, so that several
+// handlers can decode the same envelope.
+template <typename T>
+T decodeMessage(const cluon::data::Envelope &envelope)
+{
+  cluon::FromProtoVisitor decoder;
+  std::stringstream sstr(envelope.serializedData());
+  decoder.decodeFrom(sstr);
+
+  T msg;
+  msg.accept(decoder);
+  return msg;
+}
+
+template <size_t N>
+class Dispatcher {
+  public:
+    explicit Dispatcher(const std::array<Route, N> &routes)
+      : m_routes(routes)
+      , m_started{false}
+    {
+    }
+
+    Dispatcher(const Dispatcher &) = delete;
+    Dispatcher &operator=(const Dispatcher &) = delete;
+
+  public:
+    // Envelopes are dropped until all handler contexts are ready
+    void start()
+    {
+      m_started.store(true, std::memory_order_release);
+    }
+
+    void stop()
+    {
+      m_started.store(false, std::memory_order_release);
+    }
+
+    // Returns the number of handlers the envelope was delivered to
+    uint32_t dispatch(const cluon::data::Envelope &envelope) const
+    {
+      uint32_t delivered{0};
+      if (m_started.load(std::memory_order_acquire)) {
+        const int32_t dataType = envelope.dataType();
+        const uint32_t senderStamp = envelope.senderStamp();
+        for (const Route &route : m_routes) {
+          if (route.dataType == dataType
+              && (route.senderStamp == senderStamp || route.senderStamp == ANY_SENDER_STAMP)) {
+            route.handler(route.context, envelope);
+            delivered++;
+          }
+        }
+      }
+      return delivered;
+    }
+
+  private:
+    const std::array<Route, N> m_routes;
+    std::atomic<bool> m_started;
+};
+#endif
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "emergency-stop.hpp"
+#include "message-decoder.hpp"
+
+EmergencyStopResult handleResStatus(Motion &motion, TorqueRequestSender *sender,
+    const ZeroTorqueFallback &fallback, const cluon::data::Envelope &envelope)
+{
+  const auto status = decodeIntMessage<opendlv::cfsdProxyCANReading::RESStatus>(envelope);
+  EmergencyStopResult result{status.resEStop() != 0, false, false};
+  const int64_t received = cluon::time::toMicroseconds(envelope.received());
+  result.latched = motion.setEmergencyStop(result.stop,
+      received != 0 ? received : cluon::time::toMicroseconds(cluon::time::now()));
+
+  // Only after latching, so that a control cycle sending torque meanwhile
+  // either sees the stop when it checks again after its send or is followed
+  // by this request. Repeated on every status reporting the stop, in case a
+  // datagram got lost.
+  if (result.stop) {
+    result.sent = sender != nullptr && sender->isOpen()
+      && sender->send(0, 0, cluon::time::toMicroseconds(envelope.sampleTimeStamp()));
+    if (!result.sent && fallback) {
+      result.sent = fallback(envelope.sampleTimeStamp());
+    }
+  }
+  return result;
+}
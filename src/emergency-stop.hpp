@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EMERGENCY_STOP_H
+#define EMERGENCY_STOP_H
+
+#include "cluon-complete.hpp"
+#include "logic-motion.hpp"
+#include "torque-request-sender.hpp"
+
+#include <functional>
+
+// Fast path for the RES emergency stop, run in the thread that receives the
+// RESStatus instead of waiting for the next control cycle. A non-zero
+// resEStop latches the stop in Motion and sends a zero torque request right
+// away; every later step holds the torque at zero until the stop is lifted.
+// The sender is only for this path, as a TorqueRequestSender belongs to a
+// single thread. Without it, or should it fail to send, the request goes
+// through the fallback instead, e.g. the OD4 session.
+
+struct EmergencyStopResult {
+  bool stop;                   // The RES reports the emergency stop
+  bool latched;                // This status latched it
+  bool sent;                   // A zero torque request went out
+};
+
+// Sends a zero torque request with the given sample time, true if it went out
+using ZeroTorqueFallback = std::function<bool(const cluon::data::TimeStamp &sampleTime)>;
+
+// The sender may be null, e.g. when its socket could not be opened
+EmergencyStopResult handleResStatus(Motion &motion, TorqueRequestSender *sender,
+    const ZeroTorqueFallback &fallback, const cluon::data::Envelope &envelope);
+#endif
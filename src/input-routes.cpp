@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "input-routes.hpp"
+#include "message-decoder.hpp"
+
+#include <iostream>
+
+namespace {
+
+uint32_t senderStampOf(const std::map<std::string, std::string> &commandlineArguments, const std::string &key)
+{
+  auto option = commandlineArguments.find(key);
+  return (option != commandlineArguments.end()) ? static_cast<uint32_t>(std::stoi(option->second)) : ANY_SENDER_STAMP;
+}
+
+int64_t sampleTimeOf(const InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  return (feed.replayTime != 0) ? feed.replayTime : cluon::time::toMicroseconds(envelope.sampleTimeStamp());
+}
+
+int64_t receivedOf(const InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  return (feed.replayTime != 0) ? feed.replayTime : cluon::time::toMicroseconds(envelope.received());
+}
+
+void onLeftWheelSpeedReading(InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  auto wheelSpeedReading = decodeFloatMessage<opendlv::proxy::WheelSpeedReading>(envelope);
+  feed.motion.setLeftWheelSpeed(wheelSpeedReading.wheelSpeed(), sampleTimeOf(feed, envelope), receivedOf(feed, envelope));
+  if (feed.verbose) {
+    std::cout << "[ACTION-MOTION] FL wheel speed reading: " << wheelSpeedReading.wheelSpeed() << std::endl;
+  }
+}
+
+void onRightWheelSpeedReading(InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  auto wheelSpeedReading = decodeFloatMessage<opendlv::proxy::WheelSpeedReading>(envelope);
+  feed.motion.setRightWheelSpeed(wheelSpeedReading.wheelSpeed(), sampleTimeOf(feed, envelope), receivedOf(feed, envelope));
+  if (feed.verbose) {
+    std::cout << "[ACTION-MOTION] FR wheel speed reading: " << wheelSpeedReading.wheelSpeed() << std::endl;
+  }
+}
+
+void onRearWheelSpeeds(InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  auto wheelSpeeds = decodeFloatMessage<opendlv::cfsdProxyCANReading::WheelSpeedRare>(envelope);
+  feed.motion.setRearWheelSpeeds(wheelSpeeds.wheelRareLeft(), wheelSpeeds.wheelRareRight(),
+      sampleTimeOf(feed, envelope), receivedOf(feed, envelope));
+  if (feed.verbose) {
+    std::cout << "[ACTION-MOTION] RL/RR wheel speed reading: " << wheelSpeeds.wheelRareLeft()
+      << ", " << wheelSpeeds.wheelRareRight() << std::endl;
+  }
+}
+
+void onGroundSpeedReading(InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  auto groundSpeedReading = decodeFloatMessage<opendlv::proxy::GroundSpeedReading>(envelope);
+  feed.motion.setGroundSpeed(groundSpeedReading.groundSpeed(), sampleTimeOf(feed, envelope), receivedOf(feed, envelope));
+}
+
+void onAccelerationReading(InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  auto accelerationReading = decodeFloatMessage<opendlv::proxy::AccelerationReading>(envelope);
+  feed.motion.setAcceleration(accelerationReading.accelerationX(), sampleTimeOf(feed, envelope), receivedOf(feed, envelope));
+}
+
+void onGroundSteeringRequest(InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  auto steeringRequest = decodeFloatMessage<opendlv::proxy::GroundSteeringRequest>(envelope);
+  feed.motion.setSteeringRequest(steeringRequest.groundSteering(), sampleTimeOf(feed, envelope), receivedOf(feed, envelope));
+}
+
+void onPreviewPoint(InputFeed &feed, const cluon::data::Envelope &envelope)
+{
+  auto previewPoint = decodeFloatMessage<opendlv::logic::action::PreviewPoint>(envelope);
+  feed.motion.setPreviewPoint(previewPoint.azimuthAngle(), previewPoint.distance(),
+      sampleTimeOf(feed, envelope), receivedOf(feed, envelope));
+}
+
+}
+
+InputSenderStamps inputSenderStamps(const std::map<std::string, std::string> &commandlineArguments)
+{
+  InputSenderStamps stamps;
+  stamps.groundSpeed = senderStampOf(commandlineArguments, "ground-speed-id");
+  stamps.imu = senderStampOf(commandlineArguments, "imu-id");
+  stamps.steering = senderStampOf(commandlineArguments, "steering-id");
+  stamps.preview = senderStampOf(commandlineArguments, "preview-id");
+  return stamps;
+}
+
+std::set<std::string> inputSenderStampOptions()
+{
+  return {"ground-speed-id", "imu-id", "steering-id", "preview-id"};
+}
+
+std::array<Route, SENSOR_ROUTES> sensorRoutes(InputFeed &feed, const InputSenderStamps &stamps)
+{
+  return {{
+    makeRoute<InputFeed, onLeftWheelSpeedReading>(opendlv::proxy::WheelSpeedReading::ID(), 1904, feed),
+    makeRoute<InputFeed, onRightWheelSpeedReading>(opendlv::proxy::WheelSpeedReading::ID(), 1903, feed),
+    makeRoute<InputFeed, onRearWheelSpeeds>(opendlv::cfsdProxyCANReading::WheelSpeedRare::ID(), ANY_SENDER_STAMP, feed),
+    makeRoute<InputFeed, onGroundSpeedReading>(opendlv::proxy::GroundSpeedReading::ID(), stamps.groundSpeed, feed),
+    makeRoute<InputFeed, onAccelerationReading>(opendlv::proxy::AccelerationReading::ID(), stamps.imu, feed),
+    makeRoute<InputFeed, onGroundSteeringRequest>(opendlv::proxy::GroundSteeringRequest::ID(), stamps.steering, feed),
+    makeRoute<InputFeed, onPreviewPoint>(opendlv::logic::action::PreviewPoint::ID(), stamps.preview, feed)
+  }};
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUT_ROUTES_H
+#define INPUT_ROUTES_H
+
+#include "dispatcher.hpp"
+#include "logic-motion.hpp"
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+// The sensor part of the route table, shared by motion and motion-replay so
+// both feed Motion from the same messages and senders. The RES status, the
+// speed requests and the parameter requests are routed by each program, as
+// what follows them differs.
+
+// Sender stamps of the inputs more than one sender may publish
+struct InputSenderStamps {
+  uint32_t groundSpeed;
+  uint32_t imu;
+  uint32_t steering;
+  uint32_t preview;
+};
+
+// From --ground-speed-id, --imu-id, --steering-id and --preview-id, any
+// sender for those not given
+InputSenderStamps inputSenderStamps(const std::map<std::string, std::string> &commandlineArguments);
+// Names of those options
+std::set<std::string> inputSenderStampOptions();
+
+struct InputFeed {
+  Motion &motion;
+  const bool verbose;
+  // When non-zero, sample and receive time of every input instead of the
+  // times of the envelope, for replays [us]
+  int64_t replayTime;
+};
+
+const size_t SENSOR_ROUTES{7};
+
+// Wheel speeds, ground speed, IMU, steering request and preview point
+std::array<Route, SENSOR_ROUTES> sensorRoutes(InputFeed &feed, const InputSenderStamps &stamps);
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "input-watchdog.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+WatchdogConfig defaultWatchdogConfig()
+{
+  WatchdogConfig config;
+  config.enabled = true;
+  config.wheelSpeedTimeout = 0.1f;
+  config.speedRequestTimeout = 0.5f;
+  config.degradedTime = 0.2f;
+  config.rampRate = 10000.0f;
+  return config;
+}
+
+WatchdogState initialWatchdogState()
+{
+  WatchdogState state;
+  state.state = FailSafeState::Nominal;
+  state.staleInputs = 0;
+  state.criticalTime = 0.0f;
+  state.output = {{0.0f, 0.0f}};
+  return state;
+}
+
+bool inputFresh(int64_t received, float timeout, int64_t now)
+{
+  return received != 0 && now - received <= static_cast<int64_t>(timeout * 1e6f);
+}
+
+uint32_t staleInputs(const WatchdogConfig &config,
+    const std::array<int64_t, WATCHED_INPUTS> &received, int64_t now)
+{
+  const std::array<float, WATCHED_INPUTS> timeout{{
+    config.wheelSpeedTimeout, config.wheelSpeedTimeout, config.speedRequestTimeout}};
+  uint32_t stale{0};
+  for (uint32_t i = 0; i < WATCHED_INPUTS; i++) {
+    stale |= static_cast<uint32_t>(!inputFresh(received[i], timeout[i], now)) << i;
+  }
+  return stale;
+}
+
+WheelPair watchdogUpdate(const WatchdogConfig &config, WatchdogState &state,
+    uint32_t stale, const WheelPair &torque, float dt)
+{
+  constexpr uint32_t WHEEL_SPEEDS{1u << WATCH_LEFT_WHEEL_SPEED | 1u << WATCH_RIGHT_WHEEL_SPEED};
+  const bool critical = (stale & (1u << WATCH_SPEED_REQUEST)) != 0 || (stale & WHEEL_SPEEDS) == WHEEL_SPEEDS;
+  state.staleInputs = stale;
+  state.criticalTime = critical ? state.criticalTime + dt : 0.0f;
+
+  if (!config.enabled) {
+    state.state = FailSafeState::Nominal;
+  } else if (state.state == FailSafeState::SafeStop) {
+    // Latched until everything is fresh again
+    if (stale == 0) {
+      state.state = FailSafeState::Nominal;
+    }
+  } else if (critical && state.criticalTime >= config.degradedTime) {
+    state.state = FailSafeState::SafeStop;
+  } else {
+    state.state = (stale == 0) ? FailSafeState::Nominal : FailSafeState::Degraded;
+  }
+
+  if (state.state == FailSafeState::SafeStop) {
+    // Towards zero from the last applied torque, never past it
+    const float step = config.rampRate * dt;
+    for (uint32_t i = 0; i < state.output.size(); i++) {
+      const float magnitude = std::max(std::fabs(state.output[i]) - step, 0.0f);
+      state.output[i] = std::copysign(magnitude, state.output[i]);
+    }
+  } else {
+    state.output = torque;
+  }
+  return state.output;
+}
+
+const char *failSafeStateName(FailSafeState state)
+{
+  switch (state) {
+    case FailSafeState::Nominal:
+      return "nominal";
+    case FailSafeState::Degraded:
+      return "degraded";
+    case FailSafeState::SafeStop:
+      return "safe-stop";
+  }
+  return "";
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUT_WATCHDOG_H
+#define INPUT_WATCHDOG_H
+
+#include "torque-distribution.hpp"
+
+#include <array>
+#include <cstdint>
+
+// Checks the age of the controller inputs every cycle and takes the torque
+// output to zero when they stop arriving. Plain structs and a constant amount
+// of work per step, like the controller.
+
+enum class FailSafeState : uint8_t {
+  Nominal,
+  // Some input is stale, control continues on what is left
+  Degraded,
+  // The speed request or all wheel speeds are stale for longer than the
+  // degraded time, torque ramps to zero until every input is fresh again
+  SafeStop
+};
+
+enum WatchedInput : uint8_t {
+  WATCH_LEFT_WHEEL_SPEED,
+  WATCH_RIGHT_WHEEL_SPEED,
+  WATCH_SPEED_REQUEST,
+  WATCHED_INPUTS
+};
+
+struct WatchdogConfig {
+  bool enabled;
+  float wheelSpeedTimeout;     // [s]
+  float speedRequestTimeout;   // [s]
+  float degradedTime;          // Time before degraded turns into safe stop [s]
+  float rampRate;              // Torque decrease per wheel in safe stop [cNm/s]
+};
+
+struct WatchdogState {
+  FailSafeState state;
+  uint32_t staleInputs;        // Bit per WatchedInput
+  float criticalTime;          // Time the inputs have been critically stale [s]
+  WheelPair output;            // Torque after the watchdog [cNm]
+};
+
+WatchdogConfig defaultWatchdogConfig();
+WatchdogState initialWatchdogState();
+
+// Whether an input received at received is younger than timeout [s], one
+// that was never received (time 0) is not. Times in [us].
+bool inputFresh(int64_t received, float timeout, int64_t now);
+
+// Bit per WatchedInput that is not fresh. Times in [us].
+uint32_t staleInputs(const WatchdogConfig &config,
+    const std::array<int64_t, WATCHED_INPUTS> &received, int64_t now);
+
+// Returns the torque to apply for the requested one over the sample time dt [s]
+WheelPair watchdogUpdate(const WatchdogConfig &config, WatchdogState &state,
+    uint32_t stale, const WheelPair &torque, float dt);
+
+const char *failSafeStateName(FailSafeState state);
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latency-histogram.hpp"
+
+LatencyHistogram::LatencyHistogram()
+  : m_buckets{}
+  , m_count{0}
+  , m_sum{0}
+  , m_max{0}
+{
+  for (auto &bucket : m_buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::record(int64_t value)
+{
+  const uint64_t v = (value > 0) ? static_cast<uint64_t>(value) : 0;
+  m_buckets[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(v, std::memory_order_relaxed);
+
+  int64_t max = m_max.load(std::memory_order_relaxed);
+  while (static_cast<int64_t>(v) > max
+      && !m_max.compare_exchange_weak(max, static_cast<int64_t>(v), std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::count() const
+{
+  return m_count.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::max() const
+{
+  return m_max.load(std::memory_order_relaxed);
+}
+
+float LatencyHistogram::mean() const
+{
+  const uint64_t count = m_count.load(std::memory_order_relaxed);
+  if (count == 0) {
+    return 0.0f;
+  }
+  return static_cast<float>(m_sum.load(std::memory_order_relaxed)) / static_cast<float>(count);
+}
+
+int64_t LatencyHistogram::percentile(float quantile) const
+{
+  std::array<uint64_t, BUCKETS> counts;
+  uint64_t total{0};
+  for (uint32_t i = 0; i < BUCKETS; i++) {
+    counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  const uint64_t rank = static_cast<uint64_t>(quantile * static_cast<float>(total - 1)) + 1;
+  uint64_t seen{0};
+  for (uint32_t i = 0; i < BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      // The last bucket also collects everything beyond the covered range
+      const int64_t upper = upperBoundOf(i);
+      const int64_t max = m_max.load(std::memory_order_relaxed);
+      return (upper < max && i + 1 < BUCKETS) ? upper : max;
+    }
+  }
+  return m_max.load(std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::bucketOf(uint64_t value)
+{
+  if (value < 16) {
+    return static_cast<uint32_t>(value);
+  }
+  const uint32_t exponent = 63 - static_cast<uint32_t>(__builtin_clzll(value));
+  if (exponent > 31) {
+    return BUCKETS - 1;
+  }
+  const uint32_t sub = static_cast<uint32_t>(value >> (exponent - 3)) & 7u;
+  return 16 + (exponent - 4) * 8 + sub;
+}
+
+int64_t LatencyHistogram::upperBoundOf(uint32_t bucket)
+{
+  if (bucket < 16) {
+    return static_cast<int64_t>(bucket);
+  }
+  const uint32_t exponent = 4 + (bucket - 16) / 8;
+  const uint32_t sub = (bucket - 16) % 8;
+  return static_cast<int64_t>(((8ull + sub + 1) << (exponent - 3)) - 1);
+}
@@ -18,13 +18,60 @@
 #include "cluon-complete.hpp"
 #include "logic-motion.hpp"
 
-Motion::Motion()
-  : m_leftWheelSpeed{0.0f}
-  , m_rightWheelSpeed{0.0f}
-  , m_speedRequest{0.0f}
-  , m_pGain{}
+#include <algorithm>
+
+namespace {
+
+// Consistent reads of the inputs tried per step before going on without them
+const uint32_t INPUT_ATTEMPTS{64};
 
-  , m_readingsMutex{}
+// Hands the sum of the samples since the previous step to values
+SampleDrain drainSum(WheelSpeedHistory &history, float (&values)[2])
+{
+  values[0] = 0.0f;
+  values[1] = 0.0f;
+  return history.drain([&values](const TimedSample &sample) {
+      values[0] += sample.value[0];
+      values[1] += sample.value[1];
+    });
+}
+
+}
+
+Motion::Motion()
+  : m_inputs{}
+  , m_lastInputs{}
+  , m_leftWheelSpeeds{}
+  , m_rightWheelSpeeds{}
+  , m_rearWheelSpeeds{}
+  , m_sampleCounts{0, 0, 0, 0}
+  , m_record{}
+  , m_parameterStore{nullptr}
+  , m_parameterVersion{0}
+  , m_modelGain{}
+  , m_gearRatio{}
+  , m_wheelRadius{}
+  , m_controllerConfig{}
+  , m_controllerState{initialControllerState()}
+  , m_regenCutoffSpeed{5.0f / 3.6f}
+  , m_estimatorConfig{defaultEstimatorConfig()}
+  , m_estimatorState{initialEstimatorState()}
+  , m_speedEstimate{0.0f, false, 0}
+  , m_distributionConfig{defaultDistributionConfig()}
+  , m_distribution{}
+  , m_watchdogConfig{defaultWatchdogConfig()}
+  , m_watchdogState{initialWatchdogState()}
+  , m_mpcConfig{defaultMpcConfig()}
+  , m_mpcModel{mpcSetUp(m_mpcConfig)}
+  , m_mpcState{initialMpcState()}
+  , m_outputConfig{defaultOutputStageConfig()}
+  , m_outputModel{}
+  , m_outputState{initialOutputStageState()}
+  , m_trajectoryConfig{defaultTrajectoryConfig()}
+  , m_trajectoryState{initialTrajectoryState()}
+  , m_lastSpeedRequestReceived{0}
+  , m_previousStep{}
+  , m_hasPreviousStep{false}
 {
   setUp();
 }
@@ -36,14 +83,34 @@ Motion::~Motion()
 
 void Motion::setUp()
 {
-  // Calculate constant P gain based on model
-  // TODO: see if PI controller needed / better
-  const float gearRatio = 16.0f;
-  const float mass = 217.4f;
-  const float wheelRadius = 0.22f;
-  m_pGain = mass * wheelRadius / gearRatio * 100.0f;
+  // Defaults from the model of the car, see parameter-store.cpp
+  applyParameters(defaultMotionParameters());
+}
 
-  std::cout << "Setting up longitudinal controller" << std::endl;
+void Motion::setParameterStore(const ParameterStore *store)
+{
+  m_parameterStore = store;
+  m_parameterVersion = 0;
+}
+
+void Motion::applyParameters(const MotionParameters &parameters)
+{
+  // Constant gain based on model, torque in [cNm] needed per [m/s^2], used
+  // as default P gain and as feed-forward gain
+  m_modelGain = modelGainOf(parameters);
+  m_gearRatio = parameters.gearRatio;
+  m_wheelRadius = parameters.wheelRadius;
+  m_regenCutoffSpeed = parameters.regenCutoffSpeed;
+  m_controllerConfig = parameters.controller;
+  m_estimatorConfig = parameters.estimator;
+  m_distributionConfig = parameters.distribution;
+  m_watchdogConfig = parameters.watchdog;
+  m_trajectoryConfig = parameters.trajectory;
+  m_mpcConfig = parameters.mpc;
+  m_mpcModel = mpcSetUp(m_mpcConfig);
+  m_outputConfig = parameters.output;
+  m_outputModel = outputStageSetUp(m_outputConfig, m_wheelRadius, m_gearRatio);
+  m_parameterVersion = parameters.version;
 }
 
 void Motion::tearDown()
@@ -52,30 +119,240 @@ void Motion::tearDown()
 
 opendlv::cfsdProxy::TorqueRequestDual Motion::step()
 {
+  const auto now = std::chrono::steady_clock::now();
+  float dt = 0.0f;
+  if (m_hasPreviousStep) {
+    dt = std::chrono::duration<float>(now - m_previousStep).count();
+  }
+  m_previousStep = now;
+  m_hasPreviousStep = true;
+  return step(dt);
+}
+
+opendlv::cfsdProxy::TorqueRequestDual Motion::step(float dt)
+{
+  return step(dt, cluon::time::toMicroseconds(cluon::time::now()));
+}
+
+opendlv::cfsdProxy::TorqueRequestDual Motion::step(float dt, int64_t now)
+{
+  // Switch to a newly published parameter block, a plain copy without locks
+  if (m_parameterStore != nullptr) {
+    MotionParameters parameters;
+    if (m_parameterStore->copyIfNewer(m_parameterVersion, parameters)) {
+      applyParameters(parameters);
+    }
+  }
+
   // ------------ CALCULATE TORQUE ---------------
 
-  // Copy data to avoid conflict
-  float speedReading, speedRequest;
-  {
-    std::lock_guard<std::mutex> lock(m_readingsMutex);
+  // Consistent copy of the latest inputs, never blocks the writers. Should a
+  // writer hold them for longer, e.g. preempted by this thread on its CPU,
+  // the step goes on with the previous copy instead of waiting for it.
+  MotionInputs inputs = m_lastInputs;
+  m_inputs.tryLoad(inputs, INPUT_ATTEMPTS);
+  m_lastInputs = inputs;
 
-    speedReading = (m_leftWheelSpeed + m_rightWheelSpeed) / 2.0f;
-    speedRequest = m_speedRequest;
+  // Every wheel speed sample since the previous step, a burst is averaged
+  // instead of all but the last one being dropped
+  float left[2], right[2], rear[2];
+  const SampleDrain leftDrain = drainSum(m_leftWheelSpeeds, left);
+  const SampleDrain rightDrain = drainSum(m_rightWheelSpeeds, right);
+  const SampleDrain rearDrain = drainSum(m_rearWheelSpeeds, rear);
+  m_sampleCounts.leftWheelSpeed = leftDrain.count;
+  m_sampleCounts.rightWheelSpeed = rightDrain.count;
+  m_sampleCounts.rearWheelSpeeds = rearDrain.count;
+  m_sampleCounts.lost = leftDrain.lost + rightDrain.lost + rearDrain.lost;
+
+  // Release a latched emergency stop once the planner asked for a speed
+  // again after the RES was released, unless it was pressed again meanwhile
+  bool emergencyStop = inputs.emergencyStop != 0;
+  if (emergencyStop && inputs.emergencyStopReleased > inputs.emergencyStopReceived
+      && inputs.speedRequestReceived > inputs.emergencyStopReleased) {
+    const int64_t released = inputs.emergencyStopReleased;
+    // Or in a later step, if a writer holds the inputs
+    m_inputs.tryUpdate([released, &emergencyStop](MotionInputs &current) {
+        if (current.emergencyStopReleased == released) {
+          current.emergencyStop = 0;
+          emergencyStop = false;
+        }
+      }, INPUT_ATTEMPTS);
+  }
+
+  // Vehicle speed from all wheels and the IMU, falls back to the front
+  // wheel average while there is no valid estimate
+  SpeedMeasurements measurements;
+  measurements.speed[FRONT_LEFT] = inputs.leftWheelSpeed;
+  measurements.speed[FRONT_RIGHT] = inputs.rightWheelSpeed;
+  measurements.speed[REAR_LEFT] = inputs.rearLeftWheelSpeed;
+  measurements.speed[REAR_RIGHT] = inputs.rearRightWheelSpeed;
+  if (m_estimatorConfig.averageSamples) {
+    if (leftDrain.count > 0) {
+      measurements.speed[FRONT_LEFT] = left[0] / static_cast<float>(leftDrain.count);
+    }
+    if (rightDrain.count > 0) {
+      measurements.speed[FRONT_RIGHT] = right[0] / static_cast<float>(rightDrain.count);
+    }
+    if (rearDrain.count > 0) {
+      measurements.speed[REAR_LEFT] = rear[0] / static_cast<float>(rearDrain.count);
+      measurements.speed[REAR_RIGHT] = rear[1] / static_cast<float>(rearDrain.count);
+    }
   }
-  
+  measurements.speed[GROUND_SPEED] = inputs.groundSpeed;
+  // Only fresh sensors take part in the fusion and the slip control, the
+  // front wheels as the watchdog sees them, the others with the same timeout
+  const uint32_t stale = staleInputs(m_watchdogConfig,
+      {{inputs.leftWheelSpeedReceived, inputs.rightWheelSpeedReceived, inputs.speedRequestReceived}}, now);
+  const bool leftFresh = (stale & (1u << WATCH_LEFT_WHEEL_SPEED)) == 0;
+  const bool rightFresh = (stale & (1u << WATCH_RIGHT_WHEEL_SPEED)) == 0;
+  const bool rearFresh = inputFresh(inputs.rearWheelSpeedReceived, m_watchdogConfig.wheelSpeedTimeout, now);
+  const bool groundFresh = inputFresh(inputs.groundSpeedReceived, m_watchdogConfig.wheelSpeedTimeout, now);
+  measurements.available = static_cast<uint32_t>(leftFresh) << FRONT_LEFT
+    | static_cast<uint32_t>(rightFresh) << FRONT_RIGHT
+    | static_cast<uint32_t>(rearFresh) << REAR_LEFT
+    | static_cast<uint32_t>(rearFresh) << REAR_RIGHT
+    | static_cast<uint32_t>(groundFresh) << GROUND_SPEED;
+  measurements.acceleration = inputs.acceleration;
+  measurements.accelerationAvailable = static_cast<uint32_t>(
+      inputFresh(inputs.accelerationReceived, m_watchdogConfig.wheelSpeedTimeout, now));
+  m_speedEstimate = estimatorUpdate(m_estimatorConfig, m_estimatorState, measurements, dt);
+
+  float speedReading = m_speedEstimate.valid ? m_speedEstimate.speed
+    : (measurements.speed[FRONT_LEFT] + measurements.speed[FRONT_RIGHT]) / 2.0f;
+
+  // Reference speed interpolated between the requests, its slope is the
+  // requested acceleration for the feed-forward term
+  TrajectoryInputs trajectoryInputs;
+  trajectoryInputs.speedRequest = inputs.speedRequest;
+  trajectoryInputs.newRequest = inputs.speedRequestReceived != m_lastSpeedRequestReceived;
+  trajectoryInputs.vehicleSpeed = speedReading;
+  trajectoryInputs.previewCurvature = previewCurvature(inputs.previewAzimuthAngle, inputs.previewDistance);
+  trajectoryInputs.previewValid = inputs.previewReceived != 0
+    && now - inputs.previewReceived < static_cast<int64_t>(m_trajectoryConfig.previewTimeout * 1e6f);
+  m_lastSpeedRequestReceived = inputs.speedRequestReceived;
+  float speedRequest = trajectoryUpdate(m_trajectoryConfig, m_trajectoryState, trajectoryInputs, dt);
+  float accelerationRequest = m_trajectoryState.acceleration;
+
+  const float previousTorque = m_controllerState.output;
   float speedError = speedRequest - speedReading;
-  float torque = speedError * m_pGain; // In [cNm]
+  float torque = controllerStep(m_controllerConfig, m_controllerState,
+      speedError, accelerationRequest, dt); // In [cNm]
 
-  // Check the torque if the speed is below 5 km/h, important for regenerative braking
+  bool mpcSolved{false};
+  // The model-predictive controller plans against the motor limits itself,
+  // the P law above stands in whenever a solve does not finish in time
+  if (m_controllerConfig.type == ControllerType::MPC) {
+    MpcInputs mpcInputs;
+    mpcInputs.speed = speedReading;
+    mpcInputs.reference = speedRequest;
+    mpcInputs.referenceAcceleration = accelerationRequest;
+    mpcInputs.speedRequest = inputs.speedRequest;
+    mpcInputs.previousTorque = previousTorque;
+    mpcInputs.torqueMin = std::max(m_controllerConfig.outputMin,
+        m_distributionConfig.motorMin[LEFT] + m_distributionConfig.motorMin[RIGHT]);
+    mpcInputs.torqueMax = std::min(m_controllerConfig.outputMax,
+        m_distributionConfig.motorMax[LEFT] + m_distributionConfig.motorMax[RIGHT]);
+    mpcInputs.maxTorqueRate = m_outputConfig.maxTorqueRate;
+    mpcInputs.powerLimit = m_outputConfig.powerLimit;
+    mpcInputs.regenCutoffSpeed = m_regenCutoffSpeed;
+    mpcInputs.gearRatio = m_gearRatio;
+    mpcInputs.wheelRadius = m_wheelRadius;
+    mpcInputs.dt = dt;
+    mpcSolved = mpcStep(m_mpcConfig, m_mpcModel, m_mpcState, mpcInputs, m_modelGain, torque);
+  }
+  const float controllerTorque = torque;
+
+  // Check the torque if the speed is below the cutoff (5 km/h by default), important for regenerative braking
   // TODO: Check if there already exists a guard for this in the rear node
-  if (speedReading < 5.0f / 3.6f && torque < 0.0f){
+  const bool regenClamped = speedReading < m_regenCutoffSpeed && torque < 0.0f;
+  if (regenClamped){
     torque = 0.0f;
+    controllerTrackOutput(m_controllerConfig, m_controllerState, torque, dt);
+  }
+
+  // Torque distribution, with slip limiting on the driven wheels
+  DistributionInputs distributionInputs;
+  distributionInputs.torque = torque;
+  distributionInputs.vehicleSpeed = speedReading;
+  distributionInputs.vehicleSpeedValid = m_speedEstimate.valid;
+  if (m_distributionConfig.rearWheelDrive) {
+    distributionInputs.wheelSpeed = {{inputs.rearLeftWheelSpeed, inputs.rearRightWheelSpeed}};
+    distributionInputs.wheelSpeedValid = rearFresh;
+  } else {
+    distributionInputs.wheelSpeed = {{inputs.leftWheelSpeed, inputs.rightWheelSpeed}};
+    distributionInputs.wheelSpeedValid = leftFresh && rightFresh;
+  }
+  distributionInputs.steeringAngle = inputs.steeringRequest;
+  m_distribution = distributeTorque(m_distributionConfig, distributionInputs);
+
+  // Ramp to zero if the inputs stopped arriving, restart the controller
+  // from scratch once they are back
+  const FailSafeState previousState = m_watchdogState.state;
+  const WheelPair output = watchdogUpdate(m_watchdogConfig, m_watchdogState, stale, m_distribution.torque, dt);
+  if (previousState == FailSafeState::SafeStop && m_watchdogState.state != FailSafeState::SafeStop) {
+    m_controllerState = initialControllerState();
+  }
+
+  // Torque, power and slew limits per motor, the power limit at the speed of
+  // the driven wheel when known
+  const WheelPair motorSpeed = distributionInputs.wheelSpeedValid ?
+    distributionInputs.wheelSpeed : WheelPair{{speedReading, speedReading}};
+  const int32_t elapsed = static_cast<int32_t>(std::min(std::max(dt, 0.0f), 1000.0f) * 1e6f);
+  MotorTorques limited = outputStageUpdate(m_outputModel, m_outputState, output, motorSpeed, elapsed);
+  if (emergencyStop) {
+    // Straight to zero, past the slew limit, and start over once released
+    limited = {{0, 0}};
+    m_outputState.output = limited;
+    m_watchdogState.output = {{0.0f, 0.0f}};
+    m_controllerState = initialControllerState();
   }
 
-  // Torque distribution
-  int torqueLeft = static_cast<int>(torque * 0.5f);
-  int torqueRight = static_cast<int>(torque * 0.5f);
+  // Let the integrator know about torque removed by the slip limiter, the
+  // watchdog and the output stage
+  controllerTrackOutput(m_controllerConfig, m_controllerState,
+      static_cast<float>(limited[LEFT] + limited[RIGHT]), dt);
+
+  // Plain stores into a preallocated record, for the cycle log
+  CycleRecord &record = m_record;
+  record.sequence++;
+  record.time = now;
+  record.leftWheelSpeedReceived = inputs.leftWheelSpeedReceived;
+  record.rightWheelSpeedReceived = inputs.rightWheelSpeedReceived;
+  record.speedRequestReceived = inputs.speedRequestReceived;
+  record.rearWheelSpeedReceived = inputs.rearWheelSpeedReceived;
+  record.dt = dt;
+  record.leftWheelSpeed = inputs.leftWheelSpeed;
+  record.rightWheelSpeed = inputs.rightWheelSpeed;
+  record.rearLeftWheelSpeed = inputs.rearLeftWheelSpeed;
+  record.rearRightWheelSpeed = inputs.rearRightWheelSpeed;
+  record.speedRequest = inputs.speedRequest;
+  record.steeringRequest = inputs.steeringRequest;
+  record.vehicleSpeed = speedReading;
+  record.reference = speedRequest;
+  record.referenceAcceleration = accelerationRequest;
+  record.speedError = speedError;
+  record.controllerTorque = controllerTorque;
+  record.integral = m_controllerState.integral;
+  record.distributedTorque[LEFT] = m_distribution.torque[LEFT];
+  record.distributedTorque[RIGHT] = m_distribution.torque[RIGHT];
+  record.torque[LEFT] = limited[LEFT];
+  record.torque[RIGHT] = limited[RIGHT];
+  record.parameterVersion = m_parameterVersion;
+  const bool mpcActive = m_controllerConfig.type == ControllerType::MPC;
+  record.flags = static_cast<uint32_t>(m_speedEstimate.valid) * CYCLE_SPEED_ESTIMATE_VALID
+    | static_cast<uint32_t>(regenClamped) * CYCLE_REGEN_CLAMPED
+    | static_cast<uint32_t>(trajectoryInputs.previewValid) * CYCLE_PREVIEW_VALID
+    | static_cast<uint32_t>(mpcActive) * CYCLE_MPC_ACTIVE
+    | static_cast<uint32_t>(mpcActive && !mpcSolved) * CYCLE_MPC_FALLBACK
+    | static_cast<uint32_t>(emergencyStop) * CYCLE_EMERGENCY_STOP;
+  record.failSafeState = static_cast<uint8_t>(m_watchdogState.state);
+  record.staleInputs = static_cast<uint8_t>(stale);
+  record.outputLimited = static_cast<uint8_t>(m_outputState.limited);
+  record.wheelSpeedSamples = static_cast<uint8_t>(std::min<uint32_t>(
+        leftDrain.count + rightDrain.count + rearDrain.count, 255));
 
+  int torqueLeft = limited[LEFT];
+  int torqueRight = limited[RIGHT];
 
   // ------------ RETURN CORRECT MESSAGE TYPE ---------------
   opendlv::cfsdProxy::TorqueRequestDual msgTorque;
@@ -88,21 +365,257 @@ opendlv::cfsdProxy::TorqueRequestDual Motion::step()
 
 
 
-// Mutex protected setters
+void Motion::setController(const ControllerConfig &config)
+{
+  m_controllerConfig = config;
+  m_controllerState = initialControllerState();
+}
+
+ControllerConfig Motion::controllerConfig() const
+{
+  return m_controllerConfig;
+}
+
+float Motion::modelGain() const
+{
+  return m_modelGain;
+}
+
+void Motion::setRegenCutoffSpeed(float speed)
+{
+  m_regenCutoffSpeed = speed;
+}
+
+float Motion::regenCutoffSpeed() const
+{
+  return m_regenCutoffSpeed;
+}
+
+// Lock-free setters
 void Motion::setLeftWheelSpeed(float speed)
 {
-  std::lock_guard<std::mutex> lock(m_readingsMutex);
-  m_leftWheelSpeed = speed;
+  const int64_t now = cluon::time::toMicroseconds(cluon::time::now());
+  setLeftWheelSpeed(speed, now, now);
+}
+
+void Motion::setLeftWheelSpeed(float speed, int64_t sampleTime, int64_t received)
+{
+  m_inputs.update([speed, sampleTime, received](MotionInputs &inputs) {
+      inputs.leftWheelSpeed = speed;
+      inputs.leftWheelSpeedSampleTime = sampleTime;
+      inputs.leftWheelSpeedReceived = received;
+    });
+  m_leftWheelSpeeds.push({sampleTime, received, {speed, 0.0f}});
 }
 
 void Motion::setRightWheelSpeed(float speed)
 {
-  std::lock_guard<std::mutex> lock(m_readingsMutex);
-  m_rightWheelSpeed = speed;
+  const int64_t now = cluon::time::toMicroseconds(cluon::time::now());
+  setRightWheelSpeed(speed, now, now);
+}
+
+void Motion::setRightWheelSpeed(float speed, int64_t sampleTime, int64_t received)
+{
+  m_inputs.update([speed, sampleTime, received](MotionInputs &inputs) {
+      inputs.rightWheelSpeed = speed;
+      inputs.rightWheelSpeedSampleTime = sampleTime;
+      inputs.rightWheelSpeedReceived = received;
+    });
+  m_rightWheelSpeeds.push({sampleTime, received, {speed, 0.0f}});
 }
 
 void Motion::setSpeedRequest(float speed)
 {
-  std::lock_guard<std::mutex> lock(m_readingsMutex);
-  m_speedRequest = speed;
-}
\ No newline at end of file
+  const int64_t now = cluon::time::toMicroseconds(cluon::time::now());
+  setSpeedRequest(speed, now, now);
+}
+
+void Motion::setSpeedRequest(float speed, int64_t sampleTime, int64_t received)
+{
+  m_inputs.update([speed, sampleTime, received](MotionInputs &inputs) {
+      inputs.speedRequest = speed;
+      inputs.speedRequestSampleTime = sampleTime;
+      inputs.speedRequestReceived = received;
+    });
+}
+
+void Motion::setRearWheelSpeeds(float left, float right, int64_t sampleTime, int64_t received)
+{
+  m_inputs.update([left, right, sampleTime, received](MotionInputs &inputs) {
+      inputs.rearLeftWheelSpeed = left;
+      inputs.rearRightWheelSpeed = right;
+      inputs.rearWheelSpeedSampleTime = sampleTime;
+      inputs.rearWheelSpeedReceived = received;
+    });
+  m_rearWheelSpeeds.push({sampleTime, received, {left, right}});
+}
+
+void Motion::setGroundSpeed(float speed, int64_t sampleTime, int64_t received)
+{
+  m_inputs.update([speed, sampleTime, received](MotionInputs &inputs) {
+      inputs.groundSpeed = speed;
+      inputs.groundSpeedSampleTime = sampleTime;
+      inputs.groundSpeedReceived = received;
+    });
+}
+
+void Motion::setAcceleration(float acceleration, int64_t sampleTime, int64_t received)
+{
+  m_inputs.update([acceleration, sampleTime, received](MotionInputs &inputs) {
+      inputs.acceleration = acceleration;
+      inputs.accelerationSampleTime = sampleTime;
+      inputs.accelerationReceived = received;
+    });
+}
+
+void Motion::setPreviewPoint(float azimuthAngle, float distance, int64_t sampleTime, int64_t received)
+{
+  m_inputs.update([azimuthAngle, distance, sampleTime, received](MotionInputs &inputs) {
+      inputs.previewAzimuthAngle = azimuthAngle;
+      inputs.previewDistance = distance;
+      inputs.previewSampleTime = sampleTime;
+      inputs.previewReceived = received;
+    });
+}
+
+void Motion::setSteeringRequest(float groundSteering, int64_t sampleTime, int64_t received)
+{
+  m_inputs.update([groundSteering, sampleTime, received](MotionInputs &inputs) {
+      inputs.steeringRequest = groundSteering;
+      inputs.steeringRequestSampleTime = sampleTime;
+      inputs.steeringRequestReceived = received;
+    });
+}
+
+bool Motion::setEmergencyStop(bool stop, int64_t received)
+{
+  bool latched{false};
+  m_inputs.update([stop, received, &latched](MotionInputs &inputs) {
+      if (stop && inputs.emergencyStop == 0) {
+        inputs.emergencyStop = 1;
+        inputs.emergencyStopReceived = received;
+        inputs.emergencyStopReleased = 0;
+        latched = true;
+      } else if (stop) {
+        // Pressed again before the stop was lifted
+        inputs.emergencyStopReleased = 0;
+      } else if (inputs.emergencyStop != 0 && inputs.emergencyStopReleased == 0) {
+        inputs.emergencyStopReleased = received;
+      }
+    });
+  return latched;
+}
+
+bool Motion::emergencyStopped() const
+{
+  MotionInputs inputs = m_lastInputs;
+  m_inputs.tryLoad(inputs, INPUT_ATTEMPTS);
+  return inputs.emergencyStop != 0;
+}
+
+MotionInputs Motion::inputs() const
+{
+  return m_inputs.load();
+}
+
+MotionInputs Motion::lastInputs() const
+{
+  return m_lastInputs;
+}
+
+CycleRecord Motion::lastRecord() const
+{
+  return m_record;
+}
+
+MotionSampleCounts Motion::lastSampleCounts() const
+{
+  return m_sampleCounts;
+}
+
+bool Motion::latestLeftWheelSpeed(TimedSample &sample) const
+{
+  return m_leftWheelSpeeds.latest(sample);
+}
+
+bool Motion::latestRightWheelSpeed(TimedSample &sample) const
+{
+  return m_rightWheelSpeeds.latest(sample);
+}
+
+bool Motion::latestRearWheelSpeeds(TimedSample &sample) const
+{
+  return m_rearWheelSpeeds.latest(sample);
+}
+
+SpeedEstimate Motion::speedEstimate() const
+{
+  return m_speedEstimate;
+}
+
+void Motion::setEstimator(const EstimatorConfig &config)
+{
+  m_estimatorConfig = config;
+  m_estimatorState = initialEstimatorState();
+}
+
+DistributionOutput Motion::distribution() const
+{
+  return m_distribution;
+}
+
+DistributionConfig Motion::distributionConfig() const
+{
+  return m_distributionConfig;
+}
+
+void Motion::setDistribution(const DistributionConfig &config)
+{
+  m_distributionConfig = config;
+}
+
+MpcState Motion::mpcState() const
+{
+  return m_mpcState;
+}
+
+void Motion::setMpc(const MpcConfig &config)
+{
+  m_mpcConfig = config;
+  m_mpcModel = mpcSetUp(config);
+  m_mpcState = initialMpcState();
+}
+
+OutputStageState Motion::outputStageState() const
+{
+  return m_outputState;
+}
+
+void Motion::setOutputStage(const OutputStageConfig &config)
+{
+  m_outputConfig = config;
+  m_outputModel = outputStageSetUp(config, m_wheelRadius, m_gearRatio);
+  m_outputState = initialOutputStageState();
+}
+
+TrajectoryState Motion::trajectoryState() const
+{
+  return m_trajectoryState;
+}
+
+void Motion::setTrajectory(const TrajectoryConfig &config)
+{
+  m_trajectoryConfig = config;
+  m_trajectoryState = initialTrajectoryState();
+}
+
+WatchdogState Motion::watchdogState() const
+{
+  return m_watchdogState;
+}
+
+void Motion::setWatchdog(const WatchdogConfig &config)
+{
+  m_watchdogConfig = config;
+  m_watchdogState = initialWatchdogState();
+}
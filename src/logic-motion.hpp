@@ -20,21 +20,143 @@
 
 #include "opendlv-standard-message-set.hpp"
 #include "cfsd-extended-message-set.hpp"
+#include "controller.hpp"
+#include "cycle-record.hpp"
+#include "input-watchdog.hpp"
+#include "mpc-controller.hpp"
+#include "output-stage.hpp"
+#include "parameter-store.hpp"
+#include "sample-ring.hpp"
+#include "seqlock.hpp"
+#include "speed-estimator.hpp"
+#include "speed-trajectory.hpp"
+#include "torque-distribution.hpp"
 
-#include <mutex>
+#include <chrono>
+#include <cstdint>
 
+// Latest controller inputs, exchanged as one consistent snapshot between the
+// receiving threads and step(). Each input carries the sample time and the
+// time it was received, both in microseconds.
+struct MotionInputs {
+  float leftWheelSpeed;
+  float rightWheelSpeed;
+  float speedRequest;
+  int64_t leftWheelSpeedSampleTime;
+  int64_t leftWheelSpeedReceived;
+  int64_t rightWheelSpeedSampleTime;
+  int64_t rightWheelSpeedReceived;
+  int64_t speedRequestSampleTime;
+  int64_t speedRequestReceived;
+  float rearLeftWheelSpeed;
+  float rearRightWheelSpeed;
+  float groundSpeed;
+  float acceleration;
+  int64_t rearWheelSpeedSampleTime;
+  int64_t rearWheelSpeedReceived;
+  int64_t groundSpeedSampleTime;
+  int64_t groundSpeedReceived;
+  int64_t accelerationSampleTime;
+  int64_t accelerationReceived;
+  float steeringRequest;
+  int64_t steeringRequestSampleTime;
+  int64_t steeringRequestReceived;
+  float previewAzimuthAngle;
+  float previewDistance;
+  int64_t previewSampleTime;
+  int64_t previewReceived;
+  uint32_t emergencyStop;      // Latched, see Motion::setEmergencyStop()
+  int64_t emergencyStopReceived;
+  int64_t emergencyStopReleased;
+};
+
+// Samples of each wheel speed sensor kept between two steps
+const uint32_t WHEEL_SPEED_HISTORY{16};
+using WheelSpeedHistory = SampleRing<TimedSample, WHEEL_SPEED_HISTORY>;
+
+// Wheel speed samples the last step() drained, per sensor
+struct MotionSampleCounts {
+  uint32_t leftWheelSpeed;
+  uint32_t rightWheelSpeed;
+  uint32_t rearWheelSpeeds;
+  uint32_t lost;               // Overwritten before the step, all sensors
+};
 
+// Copyable, a copy continues from the inputs and controller state of the
+// original. Stepping neither locks nor allocates.
 class Motion {
   public:
     Motion();
+    Motion(const Motion &) = default;
+    Motion &operator=(const Motion &) = default;
     ~Motion();
 
   public:
+    // Sample time measured since the previous step
     opendlv::cfsdProxy::TorqueRequestDual step();
+    // Fixed sample time in [s]
+    opendlv::cfsdProxy::TorqueRequestDual step(float dt);
+    // Input ages for the watchdog are taken against now [us] instead of the
+    // system clock, for replaying recordings
+    opendlv::cfsdProxy::TorqueRequestDual step(float dt, int64_t now);
 
+    // Picks up newly published parameter blocks at the start of each step,
+    // keeping the controller state. The store must outlive this instance.
+    void setParameterStore(const ParameterStore *store);
+    // Not thread-safe with step(), to be called before the control loop starts
+    void applyParameters(const MotionParameters &parameters);
+    void setController(const ControllerConfig &config);
+    ControllerConfig controllerConfig() const;
+    float modelGain() const;
+    // Below this speed in [m/s] no negative torque is requested
+    void setRegenCutoffSpeed(float speed);
+    float regenCutoffSpeed() const;
+
+    // Without times, the input is stamped with the current time
     void setLeftWheelSpeed(float speed);
+    void setLeftWheelSpeed(float speed, int64_t sampleTime, int64_t received);
     void setRightWheelSpeed(float speed);
+    void setRightWheelSpeed(float speed, int64_t sampleTime, int64_t received);
     void setSpeedRequest(float groundSpeed);
+    void setSpeedRequest(float groundSpeed, int64_t sampleTime, int64_t received);
+    // Further inputs to the speed estimator
+    void setRearWheelSpeeds(float left, float right, int64_t sampleTime, int64_t received);
+    void setGroundSpeed(float speed, int64_t sampleTime, int64_t received);
+    void setAcceleration(float acceleration, int64_t sampleTime, int64_t received);
+    // Input to the torque distribution
+    void setSteeringRequest(float groundSteering, int64_t sampleTime, int64_t received);
+    // Point ahead on the path, caps the reference speed before corners
+    void setPreviewPoint(float azimuthAngle, float distance, int64_t sampleTime, int64_t received);
+    // RES emergency stop. A stop holds the torque at zero, past every limit,
+    // until the RES is released and a speed request newer than the release
+    // arrives. Returns true if this call latched the stop.
+    bool setEmergencyStop(bool stop, int64_t received);
+    // From the thread that steps, as the last step stands in while a writer
+    // holds the inputs
+    bool emergencyStopped() const;
+    MotionInputs inputs() const;
+    // The snapshot the last step() worked on
+    MotionInputs lastInputs() const;
+    // Inputs, intermediate terms and output of the last step()
+    CycleRecord lastRecord() const;
+    MotionSampleCounts lastSampleCounts() const;
+    // Newest wheel speed samples, false before the first one
+    bool latestLeftWheelSpeed(TimedSample &sample) const;
+    bool latestRightWheelSpeed(TimedSample &sample) const;
+    bool latestRearWheelSpeeds(TimedSample &sample) const;
+    SpeedEstimate speedEstimate() const;
+    void setEstimator(const EstimatorConfig &config);
+    DistributionOutput distribution() const;
+    DistributionConfig distributionConfig() const;
+    void setDistribution(const DistributionConfig &config);
+    MpcState mpcState() const;
+    void setMpc(const MpcConfig &config);
+    OutputStageState outputStageState() const;
+    void setOutputStage(const OutputStageConfig &config);
+    TrajectoryState trajectoryState() const;
+    void setTrajectory(const TrajectoryConfig &config);
+    WatchdogState watchdogState() const;
+    void setWatchdog(const WatchdogConfig &config);
 
   private:
     void setUp();
@@ -42,14 +164,39 @@ class Motion {
 
 
   private:
-    float m_leftWheelSpeed;
-    float m_rightWheelSpeed;
-    float m_speedRequest;
-    float m_pGain;
-
-    std::mutex m_readingsMutex;
-
-    
+    SeqLock<MotionInputs> m_inputs;
+    MotionInputs m_lastInputs;
+    WheelSpeedHistory m_leftWheelSpeeds;
+    WheelSpeedHistory m_rightWheelSpeeds;
+    WheelSpeedHistory m_rearWheelSpeeds;
+    MotionSampleCounts m_sampleCounts;
+    CycleRecord m_record;
+    const ParameterStore *m_parameterStore;
+    uint32_t m_parameterVersion;
+    float m_modelGain;
+    float m_gearRatio;
+    float m_wheelRadius;
+    ControllerConfig m_controllerConfig;
+    ControllerState m_controllerState;
+    float m_regenCutoffSpeed;
+    EstimatorConfig m_estimatorConfig;
+    EstimatorState m_estimatorState;
+    SpeedEstimate m_speedEstimate;
+    DistributionConfig m_distributionConfig;
+    DistributionOutput m_distribution;
+    WatchdogConfig m_watchdogConfig;
+    WatchdogState m_watchdogState;
+    MpcConfig m_mpcConfig;
+    MpcModel m_mpcModel;
+    MpcState m_mpcState;
+    OutputStageConfig m_outputConfig;
+    OutputStageModel m_outputModel;
+    OutputStageState m_outputState;
+    TrajectoryConfig m_trajectoryConfig;
+    TrajectoryState m_trajectoryState;
+    int64_t m_lastSpeedRequestReceived;
+    std::chrono::steady_clock::time_point m_previousStep;
+    bool m_hasPreviousStep;
 };
 #endif
 
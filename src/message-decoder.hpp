@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGE_DECODER_H
+#define MESSAGE_DECODER_H
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "cfsd-extended-message-set.hpp"
+#include "dispatcher.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Decoders for the messages this service consumes that only carry floats,
+// or only int32s, with field IDs 1..N. They read the fields straight from the serialized
+// payload instead of going through FromProtoVisitor, which builds a map of
+// std::any per message and copies the payload into a stringstream.
+
+template <typename T>
+struct FloatMessage;
+
+// Messages with int32 fields with IDs 1..N, decoded the same way
+template <typename T>
+struct IntMessage;
+
+template <>
+struct IntMessage<opendlv::cfsdProxyCANReading::RESStatus> {
+  static constexpr uint32_t FIELDS{4};
+  static void assign(opendlv::cfsdProxyCANReading::RESStatus &msg, const std::array<int32_t, FIELDS> &values)
+  {
+    msg.resStatus(values[0]).resEStop(values[1]).resQuality(values[2]).resButtons(values[3]);
+  }
+};
+
+template <>
+struct FloatMessage<opendlv::proxy::WheelSpeedReading> {
+  static constexpr uint32_t FIELDS{1};
+  static void assign(opendlv::proxy::WheelSpeedReading &msg, const std::array<float, FIELDS> &values)
+  {
+    msg.wheelSpeed(values[0]);
+  }
+};
+
+template <>
+struct FloatMessage<opendlv::proxy::GroundSpeedRequest> {
+  static constexpr uint32_t FIELDS{1};
+  static void assign(opendlv::proxy::GroundSpeedRequest &msg, const std::array<float, FIELDS> &values)
+  {
+    msg.groundSpeed(values[0]);
+  }
+};
+
+template <>
+struct FloatMessage<opendlv::proxy::GroundSpeedReading> {
+  static constexpr uint32_t FIELDS{1};
+  static void assign(opendlv::proxy::GroundSpeedReading &msg, const std::array<float, FIELDS> &values)
+  {
+    msg.groundSpeed(values[0]);
+  }
+};
+
+template <>
+struct FloatMessage<opendlv::proxy::GroundSteeringRequest> {
+  static constexpr uint32_t FIELDS{1};
+  static void assign(opendlv::proxy::GroundSteeringRequest &msg, const std::array<float, FIELDS> &values)
+  {
+    msg.groundSteering(values[0]);
+  }
+};
+
+template <>
+struct FloatMessage<opendlv::proxy::AccelerationReading> {
+  static constexpr uint32_t FIELDS{3};
+  static void assign(opendlv::proxy::AccelerationReading &msg, const std::array<float, FIELDS> &values)
+  {
+    msg.accelerationX(values[0]).accelerationY(values[1]).accelerationZ(values[2]);
+  }
+};
+
+template <>
+struct FloatMessage<opendlv::logic::action::PreviewPoint> {
+  static constexpr uint32_t FIELDS{3};
+  static void assign(opendlv::logic::action::PreviewPoint &msg, const std::array<float, FIELDS> &values)
+  {
+    msg.azimuthAngle(values[0]).zenithAngle(values[1]).distance(values[2]);
+  }
+};
+
+template <>
+struct FloatMessage<opendlv::cfsdProxyCANReading::WheelSpeedRare> {
+  static constexpr uint32_t FIELDS{2};
+  static void assign(opendlv::cfsdProxyCANReading::WheelSpeedRare &msg, const std::array<float, FIELDS> &values)
+  {
+    msg.wheelRareRight(values[0]).wheelRareLeft(values[1]);
+  }
+};
+
+// Reads a varint, returns the number of bytes used or 0 if truncated
+inline size_t readVarInt(const char *data, size_t size, uint64_t &value)
+{
+  value = 0;
+  for (size_t i = 0; i < size && i < 10; i++) {
+    const uint64_t byte = static_cast<uint8_t>(data[i]);
+    value |= (byte & 0x7f) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+// Walks the fields of a proto payload and hands the varints and 32 bit values
+// of fields 1..N to the callbacks, others are skipped. Returns false on a
+// malformed payload.
+template <uint32_t N, typename V, typename F>
+bool walkFields(const char *data, size_t size, V &&onVarInt, F &&onFixed32)
+{
+  size_t position{0};
+  while (position < size) {
+    uint64_t key;
+    size_t used = readVarInt(data + position, size - position, key);
+    if (used == 0) {
+      return false;
+    }
+    position += used;
+
+    const uint64_t field = key >> 3;
+    const bool wanted = field >= 1 && field <= N;
+    uint64_t skip{0};
+    switch (key & 0x7) {
+      case 0:
+        {
+          uint64_t value;
+          used = readVarInt(data + position, size - position, value);
+          if (used == 0) {
+            return false;
+          }
+          if (wanted) {
+            onVarInt(static_cast<uint32_t>(field - 1), value);
+          }
+          position += used;
+        }
+        break;
+      case 1:
+        skip = 8;
+        break;
+      case 2:
+        used = readVarInt(data + position, size - position, skip);
+        if (used == 0) {
+          return false;
+        }
+        position += used;
+        break;
+      case 5:
+        if (size - position < sizeof(float)) {
+          return false;
+        }
+        if (wanted) {
+          onFixed32(static_cast<uint32_t>(field - 1), data + position);
+        }
+        skip = sizeof(float);
+        break;
+      default:
+        return false;
+    }
+    if (size - position < skip) {
+      return false;
+    }
+    position += skip;
+  }
+  return true;
+}
+
+// Fills the float fields 1..N of a proto payload, fields that are missing
+// stay zero. Returns false on a malformed payload.
+template <uint32_t N>
+bool decodeFloatFields(const char *data, size_t size, std::array<float, N> &values)
+{
+  values.fill(0.0f);
+  return walkFields<N>(data, size, [](uint32_t, uint64_t) {},
+      [&values](uint32_t index, const char *value) {
+        // Little-endian on the wire as on all targets of this service
+        std::memcpy(&values[index], value, sizeof(float));
+      });
+}
+
+// Fills the zig-zag encoded int32 fields 1..N of a proto payload, fields
+// that are missing stay zero. Returns false on a malformed payload.
+template <uint32_t N>
+bool decodeIntFields(const char *data, size_t size, std::array<int32_t, N> &values)
+{
+  values.fill(0);
+  return walkFields<N>(data, size,
+      [&values](uint32_t index, uint64_t value) {
+        const uint32_t encoded = static_cast<uint32_t>(value);
+        values[index] = static_cast<int32_t>((encoded >> 1) ^ (~(encoded & 1u) + 1u));
+      },
+      [](uint32_t, const char *) {});
+}
+
+// Same result as decodeMessage<T>(), which remains the fallback for
+// malformed payloads. The payloads of these messages are at most 15 bytes
+// and fit the small string buffer of the copy, so nothing is allocated.
+template <typename T>
+T decodeFloatMessage(const cluon::data::Envelope &envelope)
+{
+  const std::string payload{envelope.serializedData()};
+  std::array<float, FloatMessage<T>::FIELDS> values;
+  if (!decodeFloatFields<FloatMessage<T>::FIELDS>(payload.data(), payload.size(), values)) {
+    return decodeMessage<T>(envelope);
+  }
+  T msg;
+  FloatMessage<T>::assign(msg, values);
+  return msg;
+}
+
+// As decodeFloatMessage(); the varints of a RESStatus in normal operation
+// take a byte or two each, so its payload fits the small string buffer too
+template <typename T>
+T decodeIntMessage(const cluon::data::Envelope &envelope)
+{
+  const std::string payload{envelope.serializedData()};
+  std::array<int32_t, IntMessage<T>::FIELDS> values;
+  if (!decodeIntFields<IntMessage<T>::FIELDS>(payload.data(), payload.size(), values)) {
+    return decodeMessage<T>(envelope);
+  }
+  T msg;
+  IntMessage<T>::assign(msg, values);
+  return msg;
+}
+#endif
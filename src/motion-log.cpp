@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+
+#include "cycle-log.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Converts a cycle log written by motion --cycle-log to CSV, one row per
+// control step, optionally restricted to a time window.
+
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 == commandlineArguments.count("log")) {
+    std::cerr << argv[0] << " converts a cycle log of the longitudinal controller to CSV" << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --log=<Cycle log> [--csv=<CSV file, standard output if not given>]" << std::endl;
+    std::cerr << "         [--from=<First step time in us>] [--to=<Last step time in us>] [--delimiter=<Column separator>]" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --log=cycles.bin --csv=cycles.csv" << std::endl;
+    retCode = 1;
+  } else {
+    const int64_t FROM{(commandlineArguments.count("from") != 0) ? std::stoll(commandlineArguments["from"]) : INT64_MIN};
+    const int64_t TO{(commandlineArguments.count("to") != 0) ? std::stoll(commandlineArguments["to"]) : INT64_MAX};
+    const char DELIMITER{(commandlineArguments.count("delimiter") != 0 && !commandlineArguments["delimiter"].empty()) ?
+      commandlineArguments["delimiter"][0] : ';'};
+
+    std::vector<CycleRecord> records;
+    std::string error;
+    if (!readCycleLog(commandlineArguments["log"], records, error)) {
+      std::cerr << "[ACTION-MOTION] " << error << std::endl;
+      return 1;
+    }
+
+    std::ofstream file;
+    if (commandlineArguments.count("csv") != 0) {
+      file.open(commandlineArguments["csv"], std::ios::out | std::ios::trunc);
+      if (!file.is_open()) {
+        std::cerr << "[ACTION-MOTION] Could not write " << commandlineArguments["csv"] << std::endl;
+        return 1;
+      }
+    }
+    std::ostream &out = file.is_open() ? file : std::cout;
+
+    writeCycleCsvHeader(out, DELIMITER);
+    uint64_t rows{0};
+    uint64_t gaps{0};
+    uint64_t expected{0};
+    for (const CycleRecord &record : records) {
+      // Steps missing between records were dropped by a full ring
+      if (expected != 0 && record.sequence != expected) {
+        gaps++;
+      }
+      expected = record.sequence + 1;
+      if (record.time >= FROM && record.time <= TO) {
+        writeCycleCsvRow(out, record, DELIMITER);
+        rows++;
+      }
+    }
+    std::cerr << "[ACTION-MOTION] " << rows << " of " << records.size() << " cycles converted, "
+      << gaps << " gaps in the sequence" << std::endl;
+  }
+  return retCode;
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "logic-motion.hpp"
+#include "dispatcher.hpp"
+#include "input-routes.hpp"
+#include "message-decoder.hpp"
+#include "parameter-store.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Offline replay of a recording through Motion. The inputs are taken from
+// the recording through the same routes as in motion, and the controller is
+// configured from the same parameters; the resulting torque requests are
+// written to a new recording and/or a CSV file. Time is the sample time of
+// the recording, so results do not depend on the replay speed.
+
+namespace {
+
+struct Replay {
+  Motion &motion;
+  ParameterSource &parameters;
+  const bool periodic;
+  int64_t previousRequestTime;
+  int64_t now;
+  std::ofstream *rec;
+  cluon::ToCSVVisitor *csv;
+  std::vector<int64_t> csvTimes;
+  uint64_t torqueRequests;
+};
+
+void writeTorque(Replay &replay, float dt)
+{
+  opendlv::cfsdProxy::TorqueRequestDual msgTorque = replay.motion.step(dt, replay.now);
+  replay.torqueRequests++;
+
+  if (replay.rec != nullptr) {
+    cluon::ToProtoVisitor encoder;
+    msgTorque.accept(encoder);
+
+    cluon::data::Envelope envelope;
+    envelope.dataType(opendlv::cfsdProxy::TorqueRequestDual::ID());
+    envelope.serializedData(encoder.encodedData());
+    envelope.sent(cluon::time::fromMicroseconds(replay.now));
+    envelope.sampleTimeStamp(cluon::time::fromMicroseconds(replay.now));
+    envelope.senderStamp(2101);
+    const std::string data = cluon::serializeEnvelope(std::move(envelope));
+    replay.rec->write(data.c_str(), static_cast<std::streamsize>(data.size()));
+  }
+  if (replay.csv != nullptr) {
+    msgTorque.accept(*replay.csv);
+    replay.csvTimes.push_back(replay.now);
+  }
+}
+
+// Latched like the fast path of motion, the zero torque request follows
+// with the next control cycle
+void onResStatus(Replay &replay, const cluon::data::Envelope &envelope)
+{
+  const auto status = decodeIntMessage<opendlv::cfsdProxyCANReading::RESStatus>(envelope);
+  replay.motion.setEmergencyStop(status.resEStop() != 0, replay.now);
+}
+
+void onGroundSpeedRequest(Replay &replay, const cluon::data::Envelope &envelope)
+{
+  replay.motion.setSpeedRequest(decodeFloatMessage<opendlv::proxy::GroundSpeedRequest>(envelope).groundSpeed(), replay.now, replay.now);
+
+  // Same as the data-driven service: one torque request per speed request
+  if (!replay.periodic) {
+    float dt = 0.0f;
+    if (replay.previousRequestTime != 0) {
+      dt = static_cast<float>(replay.now - replay.previousRequestTime) * 1e-6f;
+    }
+    replay.previousRequestTime = replay.now;
+    writeTorque(replay, dt);
+  }
+}
+
+// Recorded parameter changes, applied like in motion
+void onParameterRequest(Replay &replay, const cluon::data::Envelope &envelope)
+{
+  auto request = decodeMessage<opendlv::cfsdLogic::LongitudinalControlParameterRequest>(envelope);
+  std::string error;
+  if (!replay.parameters.override(parseParameterString(request.parameters()), error)) {
+    std::cerr << "[ACTION-MOTION] Recorded parameters rejected: " << error << std::endl;
+  }
+}
+
+// Prefixes every CSV row with the sample time of the torque request
+void writeCsv(const std::string &file, const std::string &csv, const std::vector<int64_t> &times)
+{
+  std::ofstream out(file, std::ios::out | std::ios::trunc);
+  std::stringstream lines(csv);
+  std::string line;
+  std::getline(lines, line);
+  out << "sampleTimeStamp;" << line << '\n';
+  for (int64_t time : times) {
+    std::getline(lines, line);
+    out << time << ';' << line << '\n';
+  }
+}
+
+}
+
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 == commandlineArguments.count("rec")
+      || (0 == commandlineArguments.count("out") && 0 == commandlineArguments.count("csv"))) {
+    std::cerr << argv[0] << " replays a recording through the longitudinal controller" << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --rec=<Recording> [--out=<Recording with torque requests>] [--csv=<CSV with torque requests>]"
+      << std::endl;
+    std::cerr << "         [--freq=<Control frequency in Hz>] [--realtime]" << std::endl;
+    std::cerr << "         [--steering-id=<senderStamp of GroundSteeringRequest>] [--preview-id=<senderStamp of PreviewPoint>]" << std::endl;
+    std::cerr << "         [--imu-id=<senderStamp of AccelerationReading>] [--ground-speed-id=<senderStamp of GroundSpeedReading>]" << std::endl;
+    std::cerr << "         Any parameter of motion (--controller, --kp, --parameters, ...) configures the controller" << std::endl;
+    std::cerr << "         Without --freq, a torque request is computed for every ground speed request" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --rec=endurance.rec --csv=torque.csv --freq=100" << std::endl;
+    retCode = 1;
+  } else {
+    const bool REALTIME{commandlineArguments.count("realtime") != 0};
+    const float FREQ{(commandlineArguments.count("freq") != 0) ? std::stof(commandlineArguments["freq"]) : 0.0f};
+    const bool PERIODIC{FREQ > 0.0f};
+    const int64_t PERIOD{PERIODIC ? static_cast<int64_t>(1000000.0f / FREQ) : 0};
+
+    cluon::Player player(commandlineArguments["rec"], false, false);
+    if (!player.hasMoreData()) {
+      std::cerr << "[ACTION-MOTION] Could not read " << commandlineArguments["rec"] << std::endl;
+      return 1;
+    }
+
+    std::ofstream rec;
+    if (commandlineArguments.count("out") != 0) {
+      rec.open(commandlineArguments["out"], std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+    cluon::ToCSVVisitor csv(';', true);
+
+    // The same parameters as the motion microservice
+    ParameterStore parameterStore{defaultMotionParameters()};
+    const std::string PARAMETER_FILE{(commandlineArguments.count("parameters") != 0) ?
+      commandlineArguments["parameters"] : ""};
+    ProgramOptions options{"rec", "out", "csv", "realtime", "freq", "parameters"};
+    const std::set<std::string> stampOptions = inputSenderStampOptions();
+    options.insert(stampOptions.begin(), stampOptions.end());
+    ParameterSource parameterSource{parameterStore, commandlineArguments, options, PARAMETER_FILE};
+    std::string error;
+    if (!parameterSource.reload(error)) {
+      std::cerr << "[ACTION-MOTION] Invalid parameters: " << error << std::endl;
+      return 1;
+    }
+
+    Motion motion;
+    motion.setParameterStore(&parameterStore);
+    Replay replay{motion, parameterSource, PERIODIC, 0, 0,
+      rec.is_open() ? &rec : nullptr,
+      (commandlineArguments.count("csv") != 0) ? &csv : nullptr,
+      {}, 0};
+
+    // Sensors through the routes of motion, stamped with the sample time
+    InputFeed feed{motion, false, 0};
+    const std::array<Route, 1> first{{
+      makeRoute<Replay, onResStatus>(opendlv::cfsdProxyCANReading::RESStatus::ID(), ANY_SENDER_STAMP, replay)}};
+    const std::array<Route, 2> last{{
+      makeRoute<Replay, onGroundSpeedRequest>(opendlv::proxy::GroundSpeedRequest::ID(), 1500, replay),
+      makeRoute<Replay, onParameterRequest>(opendlv::cfsdLogic::LongitudinalControlParameterRequest::ID(),
+          ANY_SENDER_STAMP, replay)}};
+    Dispatcher<1 + SENSOR_ROUTES + 2> dispatcher{
+      joinRoutes(joinRoutes(first, sensorRoutes(feed, inputSenderStamps(commandlineArguments))), last)};
+    dispatcher.start();
+
+    const auto started = std::chrono::steady_clock::now();
+    uint64_t envelopes{0};
+    int64_t nextCycle{0};
+    while (player.hasMoreData()) {
+      auto next = player.getNextEnvelopeToBeReplayed();
+      if (!next.first) {
+        continue;
+      }
+      if (REALTIME) {
+        std::this_thread::sleep_for(std::chrono::microseconds(player.delay()));
+      }
+
+      const cluon::data::Envelope &envelope = next.second;
+      const int64_t sampleTime = cluon::time::toMicroseconds(envelope.sampleTimeStamp());
+
+      // Run all control cycles that are due before this envelope
+      if (PERIODIC) {
+        if (nextCycle == 0) {
+          nextCycle = sampleTime;
+        }
+        while (nextCycle <= sampleTime) {
+          replay.now = nextCycle;
+          writeTorque(replay, 1.0f / FREQ);
+          nextCycle += PERIOD;
+        }
+      }
+
+      replay.now = sampleTime;
+      feed.replayTime = sampleTime;
+      dispatcher.dispatch(envelope);
+      envelopes++;
+    }
+
+    if (replay.csv != nullptr) {
+      writeCsv(commandlineArguments["csv"], csv.csv(), replay.csvTimes);
+    }
+
+    const float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "[ACTION-MOTION] Replayed " << envelopes << " envelopes into "
+      << replay.torqueRequests << " torque requests in " << elapsed << " s" << std::endl;
+  }
+  return retCode;
+}
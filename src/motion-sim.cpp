@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "logic-motion.hpp"
+#include "message-decoder.hpp"
+#include "parameter-store.hpp"
+#include "shared-input.hpp"
+#include "speed-profile.hpp"
+#include "vehicle-model.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Closed-loop simulation of the longitudinal controller on a vehicle model.
+// By default Motion runs in-process on simulated time, as fast as the CPU
+// allows. With --cid the model instead stands in for the sensors of the car
+// on an OD4 session in real time, for the motion microservice itself.
+
+namespace {
+
+// Latest torque request of the motion microservice
+struct TorqueInput {
+  std::atomic<int32_t> left;
+  std::atomic<int32_t> right;
+  std::atomic<uint64_t> received;
+};
+
+void writeTrace(const std::string &file, const std::vector<ClosedLoopSample> &trace)
+{
+  std::ofstream csv(file, std::ios::out | std::ios::trunc);
+  csv << "time;speedRequest;speed;acceleration;torqueLeft;torqueRight;slipLeft;slipRight" << '\n';
+  for (const ClosedLoopSample &sample : trace) {
+    csv << sample.time << ';' << sample.speedRequest << ';' << sample.speed << ';' << sample.acceleration
+      << ';' << sample.torqueRequest[LEFT] << ';' << sample.torqueRequest[RIGHT]
+      << ';' << sample.slip[LEFT] << ';' << sample.slip[RIGHT] << '\n';
+  }
+}
+
+void report(const ClosedLoopResult &result, const ClosedLoopConfig &config)
+{
+  std::cout << "[ACTION-MOTION] Steps: " << result.steps;
+  if (result.distanceTime >= 0.0f) {
+    std::cout << ", " << config.distance << " m in " << result.distanceTime << " s";
+  } else {
+    std::cout << ", " << config.distance << " m not reached";
+  }
+  std::cout << ", final speed: " << result.finalSpeed << " m/s, max speed: " << result.maxSpeed
+    << " m/s, tracking error: " << result.trackingError << " m/s RMS, max slip: " << result.maxSlip << std::endl;
+}
+
+// Runs the model on the wall clock, publishing the wheel speeds, the
+// acceleration and the speed requests and applying the torque requests that
+// come back on the session. With a shared memory name, the wheel speeds and
+// speed requests are written there instead, for motion --shm-input.
+ClosedLoopResult runOnSession(uint16_t cid, const std::string &shm, const VehicleConfig &vehicle,
+    const ClosedLoopConfig &config, const std::vector<ProfilePoint> &profile, std::vector<ClosedLoopSample> *trace)
+{
+  TorqueInput torque{{0}, {0}, {0}};
+  cluon::OD4Session od4{cid};
+  std::unique_ptr<SharedInputWriter> sharedInput;
+  if (!shm.empty()) {
+    sharedInput.reset(new SharedInputWriter(shm));
+    if (!sharedInput->isOpen()) {
+      std::cerr << "[ACTION-MOTION] No shared memory " << shm << ", is motion running with --shm-input?" << std::endl;
+      sharedInput.reset();
+    }
+  }
+  auto writeShared = [&sharedInput](SharedInputKind kind, int64_t sampleTime, float left, float right) {
+      SharedInputRecord record{};
+      record.sampleTime = sampleTime;
+      record.value[0] = left;
+      record.value[1] = right;
+      record.kind = kind;
+      sharedInput->write(record);
+    };
+  od4.dataTrigger(opendlv::cfsdProxy::TorqueRequestDual::ID(), [&torque](cluon::data::Envelope &&envelope) {
+      if (envelope.senderStamp() == 2101) {
+        auto msg = decodeMessage<opendlv::cfsdProxy::TorqueRequestDual>(envelope);
+        torque.left.store(msg.torqueLeft(), std::memory_order_relaxed);
+        torque.right.store(msg.torqueRight(), std::memory_order_relaxed);
+        torque.received.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+
+  ClosedLoopResult result{0, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  const uint64_t steps = static_cast<uint64_t>(std::ceil(profile.back().time / config.dt));
+  const uint64_t requestSteps = std::max<uint64_t>(1,
+      static_cast<uint64_t>(std::lround(config.requestPeriod / config.dt)));
+  VehicleState state = initialVehicleState();
+  size_t segment{0};
+  float speedRequest{0.0f};
+  double sumError{0.0};
+  uint64_t settled{0};
+  od4.timeTrigger(1.0f / config.dt, [&]() -> bool {
+      const cluon::data::TimeStamp now = cluon::time::now();
+      const float time = static_cast<float>(static_cast<double>(result.steps) * static_cast<double>(config.dt));
+      const int64_t sampleTime = cluon::time::toMicroseconds(now);
+      if (result.steps % requestSteps == 0) {
+        speedRequest = profileSpeedAt(profile, time, segment);
+        if (sharedInput) {
+          writeShared(SharedInputKind::SpeedRequest, sampleTime, speedRequest, 0.0f);
+        } else {
+          opendlv::proxy::GroundSpeedRequest msgRequest;
+          msgRequest.groundSpeed(speedRequest);
+          od4.send(msgRequest, now, 1500);
+        }
+      }
+
+      // Front wheels on 1904 (left) and 1903 (right), rear wheels on WheelSpeedRare
+      const float front = vehicle.rearWheelDrive ? state.speed : state.wheelSpeed[LEFT];
+      const float frontRight = vehicle.rearWheelDrive ? state.speed : state.wheelSpeed[RIGHT];
+      const float rearLeft = vehicle.rearWheelDrive ? state.wheelSpeed[LEFT] : state.speed;
+      const float rearRight = vehicle.rearWheelDrive ? state.wheelSpeed[RIGHT] : state.speed;
+      if (sharedInput) {
+        writeShared(SharedInputKind::LeftWheelSpeed, sampleTime, front, 0.0f);
+        writeShared(SharedInputKind::RightWheelSpeed, sampleTime, frontRight, 0.0f);
+        writeShared(SharedInputKind::RearWheelSpeeds, sampleTime, rearLeft, rearRight);
+      } else {
+        opendlv::proxy::WheelSpeedReading msgWheelSpeed;
+        msgWheelSpeed.wheelSpeed(front);
+        od4.send(msgWheelSpeed, now, 1904);
+        msgWheelSpeed.wheelSpeed(frontRight);
+        od4.send(msgWheelSpeed, now, 1903);
+        opendlv::cfsdProxyCANReading::WheelSpeedRare msgRear;
+        msgRear.wheelRareLeft(rearLeft);
+        msgRear.wheelRareRight(rearRight);
+        od4.send(msgRear, now);
+      }
+      opendlv::proxy::AccelerationReading msgAcceleration;
+      msgAcceleration.accelerationX(state.acceleration);
+      od4.send(msgAcceleration, now);
+
+      const WheelPair torqueRequest{{static_cast<float>(torque.left.load(std::memory_order_relaxed)),
+        static_cast<float>(torque.right.load(std::memory_order_relaxed))}};
+      vehicleStep(vehicle, state, torqueRequest, config.dt);
+
+      if (result.distanceTime < 0.0f && state.position >= config.distance) {
+        result.distanceTime = state.time;
+      }
+      result.maxSpeed = std::max(result.maxSpeed, state.speed);
+      result.maxSlip = std::max(result.maxSlip, std::max(std::fabs(state.slip[LEFT]), std::fabs(state.slip[RIGHT])));
+      if (time >= config.settleTime) {
+        const float error = speedRequest - state.speed;
+        sumError += static_cast<double>(error * error);
+        settled++;
+      }
+      result.steps++;
+      if (trace != nullptr) {
+        trace->push_back({state.time, speedRequest, state.speed, state.acceleration, torqueRequest, state.slip});
+      }
+      return result.steps < steps;
+    });
+
+  if (torque.received.load(std::memory_order_relaxed) == 0) {
+    std::cerr << "[ACTION-MOTION] No torque requests received on session " << cid << std::endl;
+  }
+  result.finalSpeed = state.speed;
+  result.trackingError = static_cast<float>(std::sqrt(sumError / static_cast<double>(std::max<uint64_t>(settled, 1))));
+  return result;
+}
+
+}
+
+int32_t main(int32_t argc, char **argv) {
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 != commandlineArguments.count("help")) {
+    std::cerr << argv[0] << " runs the longitudinal controller against a vehicle model" << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " [--rec=<Recording with ground speed requests> | --profile=<acceleration|endurance>]" << std::endl;
+    std::cerr << "         [--freq=<Controller and model frequency in Hz>] [--request-freq=<Speed request frequency in Hz>]" << std::endl;
+    std::cerr << "         [--distance=<Timed run length in m>] [--csv=<Trace of every step>]" << std::endl;
+    std::cerr << "         [--max-time=<Fail if the run length takes longer, in s>] [--max-tracking-error=<Fail above, in m/s RMS>]" << std::endl;
+    std::cerr << "         [--max-slip=<Fail if a driven wheel slips more, as slip ratio>] [--settle-time=<Tracking error only from then on, in s>]" << std::endl;
+    std::cerr << "         [--sim-mass=<kg>] [--motor-torque=<Nm per motor>] [--motor-power=<W per motor>] [--friction=<Peak friction coefficient>]" << std::endl;
+    std::cerr << "         [--drag-area=<0.5 * rho * Cd * A in kg/m>] [--rolling-resistance=<Coefficient>]" << std::endl;
+    std::cerr << "         [--cid=<OpenDaVINCI session ID to stand in for the sensors of a running motion>]" << std::endl;
+    std::cerr << "         [--shm=<Shared memory of motion --shm-input for wheel speeds and speed requests, with --cid>]" << std::endl;
+    std::cerr << "         Any parameter of motion (--controller, --kp, --parameters, ...) configures the in-process controller" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --profile=acceleration --controller=pi --max-time=5" << std::endl;
+    return 1;
+  }
+
+  std::vector<ProfilePoint> profile = (commandlineArguments.count("rec") != 0) ?
+    recordedProfile(commandlineArguments["rec"]) : syntheticProfile(commandlineArguments["profile"]);
+  if (profile.size() < 2) {
+    std::cerr << "[ACTION-MOTION] Speed request profile needs at least two points" << std::endl;
+    return 1;
+  }
+
+  // The controller takes the same parameters as the motion microservice
+  ParameterStore parameterStore{defaultMotionParameters()};
+  const std::string PARAMETER_FILE{(commandlineArguments.count("parameters") != 0) ?
+    commandlineArguments["parameters"] : ""};
+  const ProgramOptions OPTIONS{"help", "rec", "profile", "distance", "parameters", "sim-mass", "motor-torque",
+    "motor-power", "friction", "drag-area", "rolling-resistance", "freq", "request-freq", "csv", "cid", "shm",
+    "max-time", "max-tracking-error", "max-slip", "settle-time"};
+  ParameterSource parameterSource{parameterStore, commandlineArguments, OPTIONS, PARAMETER_FILE};
+  std::string error;
+  if (!parameterSource.reload(error)) {
+    std::cerr << "[ACTION-MOTION] Invalid parameters: " << error << std::endl;
+    return 1;
+  }
+  const MotionParameters &parameters = *parameterStore.current();
+
+  // The same car as the controller assumes, unless told otherwise
+  VehicleConfig vehicle = vehicleConfigOf(parameters);
+  auto readFloat = [&commandlineArguments](const std::string &key, float &value) {
+      if (commandlineArguments.count(key) != 0) {
+        value = std::stof(commandlineArguments[key]);
+      }
+    };
+  readFloat("sim-mass", vehicle.mass);
+  readFloat("motor-torque", vehicle.motorTorqueMax);
+  readFloat("motor-power", vehicle.motorPowerMax);
+  readFloat("friction", vehicle.friction);
+  readFloat("drag-area", vehicle.dragArea);
+  readFloat("rolling-resistance", vehicle.rollingResistance);
+
+  ClosedLoopConfig config = defaultClosedLoopConfig();
+  const float FREQ{(commandlineArguments.count("freq") != 0) ? std::stof(commandlineArguments["freq"]) : 1.0f / config.dt};
+  const float REQUEST_FREQ{(commandlineArguments.count("request-freq") != 0) ?
+    std::stof(commandlineArguments["request-freq"]) : 1.0f / config.requestPeriod};
+  if (FREQ <= 0.0f || REQUEST_FREQ <= 0.0f) {
+    std::cerr << "[ACTION-MOTION] Frequencies must be positive" << std::endl;
+    return 1;
+  }
+  config.dt = 1.0f / FREQ;
+  config.requestPeriod = 1.0f / REQUEST_FREQ;
+  readFloat("distance", config.distance);
+  readFloat("settle-time", config.settleTime);
+
+  const bool TRACE{commandlineArguments.count("csv") != 0};
+  std::vector<ClosedLoopSample> trace;
+  if (TRACE) {
+    trace.reserve(static_cast<size_t>(profile.back().time / config.dt) + 1);
+  }
+
+  ClosedLoopResult result;
+  if (commandlineArguments.count("cid") != 0) {
+    const uint16_t CID{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
+    std::cout << "[ACTION-MOTION] Simulating on session " << CID << " at " << FREQ << " Hz for "
+      << profile.back().time << " s" << std::endl;
+    const std::string SHM{(commandlineArguments.count("shm") != 0) ? commandlineArguments["shm"] : ""};
+    result = runOnSession(CID, SHM, vehicle, config, profile, TRACE ? &trace : nullptr);
+    report(result, config);
+  } else {
+    Motion motion;
+    motion.applyParameters(parameters);
+    const auto started = std::chrono::steady_clock::now();
+    result = runClosedLoop(motion, vehicle, config, profile, TRACE ? &trace : nullptr);
+    const float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - started).count();
+    report(result, config);
+    std::cout << "[ACTION-MOTION] Simulated " << profile.back().time << " s in " << elapsed << " s, "
+      << profile.back().time / std::max(elapsed, 1e-6f) << " times real time" << std::endl;
+  }
+
+  if (TRACE) {
+    writeTrace(commandlineArguments["csv"], trace);
+  }
+
+  // Regression limits for CI
+  int32_t retCode{0};
+  if (commandlineArguments.count("max-time") != 0) {
+    const float maxTime = std::stof(commandlineArguments["max-time"]);
+    if (result.distanceTime < 0.0f || result.distanceTime > maxTime) {
+      std::cerr << "[ACTION-MOTION] " << config.distance << " m not within " << maxTime << " s" << std::endl;
+      retCode = 1;
+    }
+  }
+  if (commandlineArguments.count("max-tracking-error") != 0) {
+    const float maxError = std::stof(commandlineArguments["max-tracking-error"]);
+    if (result.trackingError > maxError) {
+      std::cerr << "[ACTION-MOTION] Tracking error above " << maxError << " m/s" << std::endl;
+      retCode = 1;
+    }
+  }
+  if (commandlineArguments.count("max-slip") != 0) {
+    const float maxSlip = std::stof(commandlineArguments["max-slip"]);
+    if (result.maxSlip > maxSlip) {
+      std::cerr << "[ACTION-MOTION] Slip above " << maxSlip << std::endl;
+      retCode = 1;
+    }
+  }
+  return retCode;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "logic-motion.hpp"
+#include "parameter-store.hpp"
+#include "speed-profile.hpp"
+#include "vehicle-model.hpp"
+#include "work-stealing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Batch tuning of the longitudinal controller. Every combination of the given
+// gain, saturation and regen cutoff ranges drives the vehicle model of
+// motion-sim along a speed request profile, in parallel on all cores, and the
+// configurations are ranked by tracking error, torque effort and jerk.
+
+namespace {
+
+struct Candidate {
+  MotionParameters parameters;
+};
+
+struct Result {
+  float trackingError;  // RMS speed error [m/s]
+  float effort;         // RMS total torque [Nm]
+  float jerk;           // RMS jerk [m/s^3]
+  float score;
+};
+
+// Values of a sweep range "min:max:count", or a single value
+std::vector<float> parseRange(const std::string &range, float fallback)
+{
+  std::vector<float> values;
+  if (range.empty()) {
+    values.push_back(fallback);
+    return values;
+  }
+  const size_t first = range.find(':');
+  if (first == std::string::npos) {
+    values.push_back(std::stof(range));
+    return values;
+  }
+  const size_t second = range.find(':', first + 1);
+  const float min = std::stof(range.substr(0, first));
+  const float max = std::stof(range.substr(first + 1, second - first - 1));
+  const int32_t count = (second == std::string::npos) ? 2 : std::stoi(range.substr(second + 1));
+  for (int32_t i = 0; i < count; i++) {
+    values.push_back(min + (max - min) * static_cast<float>(i) / static_cast<float>(std::max(count - 1, 1)));
+  }
+  return values;
+}
+
+// Closed loop run of one candidate on the vehicle model of motion-sim
+Result evaluate(const Candidate &candidate, const VehicleConfig &vehicle, const ClosedLoopConfig &config,
+    const std::vector<ProfilePoint> &profile)
+{
+  Motion motion;
+  motion.applyParameters(candidate.parameters);
+  const ClosedLoopResult run = runClosedLoop(motion, vehicle, config, profile, nullptr);
+
+  Result result;
+  result.trackingError = run.trackingError;
+  result.effort = run.effort;
+  result.jerk = run.jerk;
+  result.score = 0.0f;
+  return result;
+}
+
+}
+
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 != commandlineArguments.count("help")) {
+    std::cerr << argv[0] << " ranks controller configurations on a speed request profile" << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " [--rec=<Recording with ground speed requests> | --profile=<acceleration|endurance>]" << std::endl;
+    std::cerr << "         [--controller=<p|pi|pid|mpc>] [--kp=<min:max:count>] [--ki=<min:max:count>] [--kd=<min:max:count>]" << std::endl;
+    std::cerr << "         [--torque-max=<min:max:count in cNm>] [--regen-cutoff=<min:max:count in m/s>]" << std::endl;
+    std::cerr << "         [--freq=<Control frequency in Hz>] [--threads=<Number of threads>] [--top=<Number of results>]" << std::endl;
+    std::cerr << "         [--effort-weight=<Score per Nm>] [--jerk-weight=<Score per m/s^3>] [--csv=<All results>]" << std::endl;
+    std::cerr << "         Any other parameter of motion (--mass, --slip-limit, --parameters, ...) applies to all candidates" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --profile=acceleration --controller=pi --kp=50:300:20 --ki=0:200:20" << std::endl;
+    return 1;
+  }
+
+  const float FREQ{(commandlineArguments.count("freq") != 0) ? std::stof(commandlineArguments["freq"]) : 100.0f};
+  const uint32_t THREADS{(commandlineArguments.count("threads") != 0) ?
+    static_cast<uint32_t>(std::stoi(commandlineArguments["threads"])) : std::max(1u, std::thread::hardware_concurrency())};
+  const uint32_t TOP{(commandlineArguments.count("top") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["top"])) : 10};
+  const float EFFORT_WEIGHT{(commandlineArguments.count("effort-weight") != 0) ? std::stof(commandlineArguments["effort-weight"]) : 0.001f};
+  const float JERK_WEIGHT{(commandlineArguments.count("jerk-weight") != 0) ? std::stof(commandlineArguments["jerk-weight"]) : 0.01f};
+
+  std::vector<ProfilePoint> profile = (commandlineArguments.count("rec") != 0) ?
+    recordedProfile(commandlineArguments["rec"]) : syntheticProfile(commandlineArguments["profile"]);
+  if (profile.size() < 2) {
+    std::cerr << "[ACTION-MOTION] Speed request profile needs at least two points" << std::endl;
+    return 1;
+  }
+
+  // The same parameters as the motion microservice, apart from the swept ones
+  const ProgramOptions OPTIONS{"help", "rec", "profile", "parameters", "freq", "threads", "top", "effort-weight",
+    "jerk-weight", "csv", "kp", "ki", "kd", "torque-max", "regen-cutoff"};
+  ParameterStore parameterStore{defaultMotionParameters()};
+  const std::string PARAMETER_FILE{(commandlineArguments.count("parameters") != 0) ?
+    commandlineArguments["parameters"] : ""};
+  ParameterSource parameterSource{parameterStore, commandlineArguments, OPTIONS, PARAMETER_FILE};
+  std::string error;
+  if (!parameterSource.reload(error)) {
+    std::cerr << "[ACTION-MOTION] Invalid parameters: " << error << std::endl;
+    return 1;
+  }
+  const MotionParameters base = *parameterStore.current();
+  const VehicleConfig vehicle = vehicleConfigOf(base);
+  ClosedLoopConfig config = defaultClosedLoopConfig();
+  config.dt = 1.0f / FREQ;
+
+  // Full grid of candidates
+  std::vector<Candidate> candidates;
+  for (float kp : parseRange(commandlineArguments["kp"], base.controller.kp)) {
+    for (float ki : parseRange(commandlineArguments["ki"], base.controller.ki)) {
+      for (float kd : parseRange(commandlineArguments["kd"], base.controller.kd)) {
+        for (float torqueMax : parseRange(commandlineArguments["torque-max"], base.controller.outputMax)) {
+          for (float regenCutoff : parseRange(commandlineArguments["regen-cutoff"], base.regenCutoffSpeed)) {
+            Candidate candidate{base};
+            candidate.parameters.controller.kp = kp;
+            candidate.parameters.controller.ki = ki;
+            candidate.parameters.controller.kd = kd;
+            candidate.parameters.controller.outputMax = torqueMax;
+            candidate.parameters.controller.outputMin = -torqueMax;
+            candidate.parameters.regenCutoffSpeed = regenCutoff;
+            candidates.push_back(candidate);
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<Result> results(candidates.size());
+  const auto started = std::chrono::steady_clock::now();
+  parallelFor(static_cast<uint32_t>(candidates.size()), THREADS,
+      [&](uint32_t i) {
+        results[i] = evaluate(candidates[i], vehicle, config, profile);
+        results[i].score = results[i].trackingError + EFFORT_WEIGHT * results[i].effort
+          + JERK_WEIGHT * results[i].jerk;
+      });
+  const float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - started).count();
+
+  std::vector<uint32_t> ranking(candidates.size());
+  for (uint32_t i = 0; i < ranking.size(); i++) {
+    ranking[i] = i;
+  }
+  std::sort(ranking.begin(), ranking.end(),
+      [&results](uint32_t a, uint32_t b) { return results[a].score < results[b].score; });
+
+  std::cout << "[ACTION-MOTION] Evaluated " << candidates.size() << " configurations on "
+    << THREADS << " threads in " << elapsed << " s" << std::endl;
+  std::cout << "rank;score;trackingError;effort;jerk;kp;ki;kd;torqueMax;regenCutoff" << std::endl;
+  for (uint32_t r = 0; r < ranking.size() && r < TOP; r++) {
+    const Candidate &c = candidates[ranking[r]];
+    const Result &res = results[ranking[r]];
+    std::cout << r + 1 << ';' << res.score << ';' << res.trackingError << ';' << res.effort << ';' << res.jerk
+      << ';' << c.parameters.controller.kp << ';' << c.parameters.controller.ki
+      << ';' << c.parameters.controller.kd << ';' << c.parameters.controller.outputMax
+      << ';' << c.parameters.regenCutoffSpeed << std::endl;
+  }
+
+  if (commandlineArguments.count("csv") != 0) {
+    std::ofstream csv(commandlineArguments["csv"], std::ios::out | std::ios::trunc);
+    csv << "rank;score;trackingError;effort;jerk;kp;ki;kd;torqueMax;regenCutoff" << '\n';
+    for (uint32_t r = 0; r < ranking.size(); r++) {
+      const Candidate &c = candidates[ranking[r]];
+      const Result &res = results[ranking[r]];
+      csv << r + 1 << ';' << res.score << ';' << res.trackingError << ';' << res.effort << ';' << res.jerk
+        << ';' << c.parameters.controller.kp << ';' << c.parameters.controller.ki
+        << ';' << c.parameters.controller.kd << ';' << c.parameters.controller.outputMax
+        << ';' << c.parameters.regenCutoffSpeed << '\n';
+    }
+  }
+  return retCode;
+}
@@ -19,70 +19,519 @@
 #include "opendlv-standard-message-set.hpp"
 
 #include "logic-motion.hpp"
+#include "batch-receiver.hpp"
+#include "cycle-log.hpp"
+#include "cycle-monitor.hpp"
+#include "dispatcher.hpp"
+#include "emergency-stop.hpp"
+#include "input-routes.hpp"
+#include "message-decoder.hpp"
+#include "latency-histogram.hpp"
+#include "parameter-store.hpp"
+#include "realtime.hpp"
+#include "shared-input.hpp"
+#include "torque-request-sender.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
 #include <thread>
 #include <chrono>
 
+namespace {
+
+// Per-cycle timing of the control path, all in microseconds
+struct LoopLatencies {
+  LatencyHistogram wheelSpeedAge;    // Wheel speed arrival to start of step
+  LatencyHistogram speedRequestAge;  // Speed request arrival to start of step
+  LatencyHistogram computeTime;      // step()
+  LatencyHistogram sendTime;         // od4.send()
+  LatencyHistogram endToEnd;         // Wheel speed arrival to torque request sent
+};
+
+// Shared by all input handlers, passed as context through the dispatcher
+struct Service {
+  Motion &motion;
+  ParameterSource &parameters;
+  TorqueRequestSender &torqueSender;
+  TorqueRequestSender &emergencySender;  // Of the receiving thread
+  CycleLogWriter *cycleLog;    // Null without --cycle-log
+  std::atomic<cluon::OD4Session *> od4;
+  cluon::UDPSender *sender;    // Instead of the session with --recv-batch
+  const bool verbose;
+  const bool periodic;
+  LoopLatencies latencies;
+  WatchdogState watchdog;      // As last published
+};
+
+int64_t microsecondsOf(const cluon::data::TimeStamp &timeStamp)
+{
+  return cluon::time::toMicroseconds(timeStamp);
+}
+
+// Through the session, or encoded like OD4Session::send() when a batched
+// receiver takes the place of the session
+template <typename T>
+void publish(Service &service, T &message, const cluon::data::TimeStamp &sampleTimeStamp, uint32_t senderStamp)
+{
+  cluon::OD4Session *od4 = service.od4.load(std::memory_order_relaxed);
+  if (od4 != nullptr) {
+    od4->send(message, sampleTimeStamp, senderStamp);
+  } else if (service.sender != nullptr) {
+    cluon::ToProtoVisitor encoder;
+    message.accept(encoder);
+    cluon::data::Envelope envelope;
+    envelope.dataType(static_cast<int32_t>(T::ID()));
+    envelope.serializedData(encoder.encodedData());
+    envelope.sent(cluon::time::now());
+    envelope.sampleTimeStamp(sampleTimeStamp);
+    envelope.senderStamp(senderStamp);
+    service.sender->send(cluon::serializeEnvelope(std::move(envelope)));
+  }
+}
+
+// Preencoded envelope straight to the socket, no allocation on this path
+void sendTorque(Service &service, opendlv::cfsdProxy::TorqueRequestDual &msgTorque,
+    const cluon::data::TimeStamp &cycleStart)
+{
+  if (service.torqueSender.isOpen()) {
+    service.torqueSender.send(msgTorque.torqueLeft(), msgTorque.torqueRight(), microsecondsOf(cycleStart));
+  } else {
+    publish(service, msgTorque, cycleStart, 2101);
+  }
+}
+
+// Runs one control step and sends the torque request, with a fixed sample
+// time dt or the measured one if dt is zero
+opendlv::cfsdProxy::TorqueRequestDual controlCycle(Service &service, float dt)
+{
+  const cluon::data::TimeStamp cycleStart = cluon::time::now();
+  const int64_t started = microsecondsOf(cycleStart);
+
+  opendlv::cfsdProxy::TorqueRequestDual msgTorque = (dt > 0.0f) ? service.motion.step(dt) : service.motion.step();
+  const int64_t computed = microsecondsOf(cluon::time::now());
+  // Latched by the receiving thread while this step was running
+  if (service.motion.emergencyStopped()) {
+    msgTorque.torqueLeft(0);
+    msgTorque.torqueRight(0);
+  }
+  sendTorque(service, msgTorque, cycleStart);
+  // Latched between the check and the send, the zero request of the
+  // receiving thread may have gone out before this one. The receiving thread
+  // latches before it sends, so either its zero follows this request or the
+  // stop is seen here and zero goes out again.
+  if ((msgTorque.torqueLeft() != 0 || msgTorque.torqueRight() != 0) && service.motion.emergencyStopped()) {
+    msgTorque.torqueLeft(0);
+    msgTorque.torqueRight(0);
+    sendTorque(service, msgTorque, cycleStart);
+  }
+  const int64_t sent = microsecondsOf(cluon::time::now());
+  if (service.cycleLog != nullptr) {
+    service.cycleLog->push(service.motion.lastRecord());
+  }
+
+  // Published on changes only, so the encoding cost stays off most cycles
+  const WatchdogState watchdog = service.motion.watchdogState();
+  if (watchdog.state != service.watchdog.state || watchdog.staleInputs != service.watchdog.staleInputs) {
+    opendlv::cfsdLogic::LongitudinalControlState msgState;
+    msgState.state(static_cast<uint8_t>(watchdog.state));
+    msgState.staleInputs(watchdog.staleInputs);
+    publish(service, msgState, cycleStart, 2101);
+    if (watchdog.state != service.watchdog.state) {
+      std::cout << "[ACTION-MOTION] Inputs " << failSafeStateName(watchdog.state)
+        << ", stale: " << watchdog.staleInputs << std::endl;
+    }
+    service.watchdog = watchdog;
+  }
+
+  LoopLatencies &latencies = service.latencies;
+  const MotionInputs inputs = service.motion.lastInputs();
+  const int64_t wheelSpeedReceived = std::min(inputs.leftWheelSpeedReceived, inputs.rightWheelSpeedReceived);
+  if (wheelSpeedReceived > 0) {
+    latencies.wheelSpeedAge.record(started - wheelSpeedReceived);
+    latencies.endToEnd.record(sent - wheelSpeedReceived);
+  }
+  if (inputs.speedRequestReceived > 0) {
+    latencies.speedRequestAge.record(started - inputs.speedRequestReceived);
+  }
+  latencies.computeTime.record(computed - started);
+  latencies.sendTime.record(sent - computed);
+  return msgTorque;
+}
+
+void publishDiagnostics(Service &service, uint64_t overruns)
+{
+  const LoopLatencies &latencies = service.latencies;
+  auto p99 = [](const LatencyHistogram &h) { return static_cast<uint32_t>(h.percentile(0.99f)); };
+  auto max = [](const LatencyHistogram &h) { return static_cast<uint32_t>(h.max()); };
+
+  opendlv::cfsdLogic::LongitudinalControlDiagnostics msg;
+  msg.cycles(static_cast<uint32_t>(latencies.computeTime.count()));
+  msg.overruns(static_cast<uint32_t>(overruns));
+  msg.wheelSpeedAgeP99(p99(latencies.wheelSpeedAge));
+  msg.wheelSpeedAgeMax(max(latencies.wheelSpeedAge));
+  msg.speedRequestAgeP99(p99(latencies.speedRequestAge));
+  msg.speedRequestAgeMax(max(latencies.speedRequestAge));
+  msg.computeTimeP99(p99(latencies.computeTime));
+  msg.computeTimeMax(max(latencies.computeTime));
+  msg.sendTimeP99(p99(latencies.sendTime));
+  msg.sendTimeMax(max(latencies.sendTime));
+  msg.endToEndP99(p99(latencies.endToEnd));
+  msg.endToEndMax(max(latencies.endToEnd));
+  publish(service, msg, cluon::time::now(), 2101);
+}
+
+void dumpLatencies(const LoopLatencies &latencies)
+{
+  auto dump = [](const std::string &name, const LatencyHistogram &h) {
+      std::cout << "[ACTION-MOTION] " << name << ": n " << h.count() << ", mean " << h.mean()
+        << " us, p50 " << h.percentile(0.5f) << " us, p99 " << h.percentile(0.99f)
+        << " us, max " << h.max() << " us" << std::endl;
+    };
+  dump("Wheel speed age", latencies.wheelSpeedAge);
+  dump("Speed request age", latencies.speedRequestAge);
+  dump("Compute time", latencies.computeTime);
+  dump("Send time", latencies.sendTime);
+  dump("Wheel speed to torque request", latencies.endToEnd);
+}
+
+// First in the route table, see emergency-stop.hpp
+void onResStatus(Service &service, const cluon::data::Envelope &envelope)
+{
+  // Like sendTorque(), through the session without the dedicated socket
+  auto fallback = [&service](const cluon::data::TimeStamp &sampleTime) {
+      if (service.od4.load(std::memory_order_relaxed) == nullptr && service.sender == nullptr) {
+        return false;
+      }
+      opendlv::cfsdProxy::TorqueRequestDual msgTorque;
+      msgTorque.torqueLeft(0);
+      msgTorque.torqueRight(0);
+      publish(service, msgTorque, sampleTime, 2101);
+      return true;
+    };
+  const EmergencyStopResult result = handleResStatus(service.motion, &service.emergencySender, fallback, envelope);
+  if (result.latched) {
+    std::cout << "[ACTION-MOTION] RES emergency stop, torque held at zero"
+      << (result.sent ? "" : " (zero torque request not sent)") << std::endl;
+  }
+}
+
+void onGroundSpeedRequest(Service &service, const cluon::data::Envelope &envelope)
+{
+  auto gsr = decodeFloatMessage<opendlv::proxy::GroundSpeedRequest>(envelope);
+  service.motion.setSpeedRequest(gsr.groundSpeed(),
+      microsecondsOf(envelope.sampleTimeStamp()), microsecondsOf(envelope.received()));
+
+  // Calculate and send torque request once we get a new groundSpeedRequest,
+  // unless the fixed-rate control loop owns the output
+  if (!service.periodic) {
+    controlCycle(service, 0.0f);
+  }
+
+  if (service.verbose) {
+    std::cout << "[ACTION-MOTION] Groundspeed request: " << gsr.groundSpeed() << std::endl;
+  }
+}
+
+// Records of co-located producers with --shm-input, the time they were
+// written takes the place of the receive time of an envelope. Only with
+// --freq, the control loop picks the speed request up.
+void onSharedInput(Service &service, const SharedInputRecord &record)
+{
+  switch (record.kind) {
+    case SharedInputKind::LeftWheelSpeed:
+      service.motion.setLeftWheelSpeed(record.value[0], record.sampleTime, record.written);
+      break;
+    case SharedInputKind::RightWheelSpeed:
+      service.motion.setRightWheelSpeed(record.value[0], record.sampleTime, record.written);
+      break;
+    case SharedInputKind::RearWheelSpeeds:
+      service.motion.setRearWheelSpeeds(record.value[0], record.value[1], record.sampleTime, record.written);
+      break;
+    case SharedInputKind::SpeedRequest:
+      service.motion.setSpeedRequest(record.value[0], record.sampleTime, record.written);
+      break;
+  }
+}
+
+// Runtime parameter changes, rejected as a whole if any value is invalid
+void onParameterRequest(Service &service, const cluon::data::Envelope &envelope)
+{
+  auto request = decodeMessage<opendlv::cfsdLogic::LongitudinalControlParameterRequest>(envelope);
+  std::string error;
+  if (service.parameters.override(parseParameterString(request.parameters()), error)) {
+    std::cout << "[ACTION-MOTION] Parameters updated: " << request.parameters() << std::endl;
+  } else {
+    std::cerr << "[ACTION-MOTION] Parameters rejected: " << error << std::endl;
+  }
+}
+
+
+}
+
 int32_t main(int32_t argc, char **argv) {
     int32_t retCode{0};
     auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
     if (0 == commandlineArguments.count("cid")) {
         std::cerr << argv[0] << "Generates the acceleration requests for Lynx" << std::endl;
-        std::cerr << "Usage:   " << argv[0] << " --cid=<OpenDaVINCI session ID> [--verbose=<Print or not>]"
+        std::cerr << "Usage:   " << argv[0] << " --cid=<OpenDaVINCI session ID> [--freq=<Control frequency in Hz>] [--verbose=<Print or not>]"
         << std::endl;
-        std::cerr << "Example: " << argv[0] << "--cid=111 [--verbose]" << std::endl;
+        std::cerr << "         [--controller=<p|pi|pid|mpc>] [--kp=<cNm/(m/s)>] [--ki=<cNm/m>] [--kd=<cNm/(m/s^2)>]" << std::endl;
+        std::cerr << "         [--td=<Derivative filter time in s>] [--anti-windup=<none|clamping|back-calculation>] [--kb=<1/s>]" << std::endl;
+        std::cerr << "         [--feed-forward=<Scale of model acceleration feed-forward>] [--torque-min=<cNm>] [--torque-max=<cNm>]" << std::endl;
+        std::cerr << "         [--mpc-step=<Horizon step in s>] [--mpc-tracking-weight] [--mpc-rate-weight] [--mpc-effort-weight] [--mpc-iterations] [--mpc-timeout=<us, 0 for none>]" << std::endl;
+        std::cerr << "         [--max-torque-rate=<Total cNm/s>] [--power-limit=<Total W>]" << std::endl;
+        std::cerr << "         [--yaw-gain=<cNm/(rad/s)>] [--slip-limit=<Slip ratio>] [--slip-band=<Slip ratio>] [--motor-max=<cNm per motor>] [--front-wheel-drive]" << std::endl;
+        std::cerr << "         [--mass=<kg>] [--wheel-radius=<m>] [--gear-ratio=<ratio>] [--regen-cutoff=<m/s>]" << std::endl;
+        std::cerr << "         [--no-sample-averaging]" << std::endl;
+        std::cerr << "         [--wheel-speed-timeout=<s>] [--speed-request-timeout=<s>] [--degraded-time=<s>] [--ramp-rate=<cNm/s>] [--no-watchdog]" << std::endl;
+        std::cerr << "         [--parameters=<File with key=value lines, reloaded on change>]" << std::endl;
+        std::cerr << "         [--recv-batch=<Datagrams per receive system call>] [--busy-poll=<Poll without sleeping after traffic in us>]" << std::endl;
+        std::cerr << "         [--shm-input=<Shared memory for wheel speeds and speed requests of co-located producers, with --freq>]" << std::endl;
+        std::cerr << "         [--rt-priority=<SCHED_FIFO priority of the control thread>] [--cpu=<CPU to pin it to>] [--rt-heap=<Prefaulted heap in MiB>]" << std::endl;
+        std::cerr << "         [--cycle-log=<Binary log of every control step, see motion-log>] [--cycle-log-flush=<s>]" << std::endl;
+        std::cerr << "         [--max-interval=<Longest request interpolation in s>] [--max-acceleration=<m/s^2>] [--max-deceleration=<m/s^2>] [--no-interpolation]" << std::endl;
+        std::cerr << "         [--lateral-acceleration-limit=<m/s^2, caps speed to the curvature of the preview point>] [--preview-timeout=<s>]" << std::endl;
+        std::cerr << "         [--steering-id=<senderStamp of GroundSteeringRequest>] [--preview-id=<senderStamp of PreviewPoint>]" << std::endl;
+        std::cerr << "         [--imu-id=<senderStamp of AccelerationReading>] [--ground-speed-id=<senderStamp of GroundSpeedReading>]" << std::endl;
+        std::cerr << "         Without --freq, a torque request is sent for every incoming ground speed request" << std::endl;
+        std::cerr << "Example: " << argv[0] << "--cid=111 --freq=100 [--verbose]" << std::endl;
         retCode = 1;
     } else {
-
-        // Interface to a running OpenDaVINCI session.  
-        cluon::OD4Session od4{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
         bool VERBOSE{static_cast<bool>(commandlineArguments.count("verbose"))};
+        const float FREQ{(commandlineArguments.count("freq") != 0) ? std::stof(commandlineArguments["freq"]) : 0.0f};
+        const bool PERIODIC{FREQ > 0.0f};
+        // Without --freq every speed request runs a control cycle on the
+        // thread that received it, and the shared memory input has a thread
+        // of its own next to the session
+        if (!PERIODIC && commandlineArguments.count("shm-input") != 0) {
+          std::cerr << "[ACTION-MOTION] --shm-input needs --freq" << std::endl;
+          return 1;
+        }
+
+        // Opt-in real-time profile: memory is locked for the whole process
+        // here, before the other threads start; the control loop gets its own
+        // pinned SCHED_FIFO thread below
+        const bool REALTIME{commandlineArguments.count("rt-priority") != 0 || commandlineArguments.count("cpu") != 0};
+        RealtimeConfig realtimeConfig{defaultRealtimeConfig()};
+        RealtimeStatus realtimeStatus{initialRealtimeStatus()};
+        if (REALTIME) {
+          realtimeConfig.priority = (commandlineArguments.count("rt-priority") != 0) ?
+            std::stoi(commandlineArguments["rt-priority"]) : 0;
+          realtimeConfig.cpu = (commandlineArguments.count("cpu") != 0) ? std::stoi(commandlineArguments["cpu"]) : -1;
+          realtimeConfig.lockMemory = true;
+          realtimeConfig.heapPrefault = static_cast<uint32_t>((commandlineArguments.count("rt-heap") != 0) ?
+            std::stoi(commandlineArguments["rt-heap"]) : 16) * 1024 * 1024;
+          realtimeConfig.stackPrefault = 256 * 1024;
+          setUpRealtimeProcess(realtimeConfig, realtimeStatus);
+          if (!PERIODIC) {
+            std::cerr << "[ACTION-MOTION] --rt-priority and --cpu need --freq, only memory is locked" << std::endl;
+          }
+        }
+
+        // Parameters from the command line and the parameter file, changed at
+        // runtime when the file changes or on a LongitudinalControlParameterRequest
+        ParameterStore parameterStore{defaultMotionParameters()};
+        // The control loop also bounds the MPC solve in time, the tools leave
+        // it to the iterations to stay reproducible
+        if (commandlineArguments.count("mpc-timeout") == 0) {
+          commandlineArguments["mpc-timeout"] = "500";
+        }
+        const std::string PARAMETER_FILE{(commandlineArguments.count("parameters") != 0) ?
+          commandlineArguments["parameters"] : ""};
+        ProgramOptions options{"cid", "freq", "verbose", "rt-priority", "cpu", "rt-heap", "parameters",
+          "cycle-log", "cycle-log-flush", "recv-batch", "busy-poll", "shm-input"};
+        const std::set<std::string> stampOptions = inputSenderStampOptions();
+        options.insert(stampOptions.begin(), stampOptions.end());
+        ParameterSource parameterSource{parameterStore, commandlineArguments, options, PARAMETER_FILE};
+        std::string error;
+        if (!parameterSource.reload(error)) {
+          std::cerr << "[ACTION-MOTION] Invalid parameters: " << error << std::endl;
+          return 1;
+        }
 
         Motion motion;
+        motion.setParameterStore(&parameterStore);
+        std::cout << "Setting up longitudinal controller" << std::endl;
+        const uint16_t CID{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
+        TorqueRequestSender torqueSender{CID, 2101};
+        TorqueRequestSender emergencySender{CID, 2101};
 
-        //TODO: Should we use wheelSpeedReadings or filtered groundSpeedReading?
-        auto onWheelSpeedReading{[&motion, VERBOSE](cluon::data::Envelope &&envelope)
-        {
-          uint16_t senderStamp = envelope.senderStamp();
-          if (senderStamp == 1904) {
-            auto wheelSpeedReading = cluon::extractMessage<opendlv::proxy::WheelSpeedReading>(std::move(envelope));
-            motion.setLeftWheelSpeed(wheelSpeedReading.wheelSpeed());
-            if (VERBOSE) {
-              std::cout << "[ACTION-MOTION] FL wheel speed reading: " << wheelSpeedReading.wheelSpeed() << std::endl;
-            }
-          } else if (senderStamp == 1903) {
-            auto wheelSpeedReading = cluon::extractMessage<opendlv::proxy::WheelSpeedReading>(std::move(envelope));
-            motion.setRightWheelSpeed(wheelSpeedReading.wheelSpeed());
-            if (VERBOSE) {
-              std::cout << "[ACTION-MOTION] FR wheel speed reading: " << wheelSpeedReading.wheelSpeed() << std::endl;
-            }
+        // Every control step to a file, written off the control thread. About
+        // 80 s at 100 Hz fit into the ring, far more than the writer falls behind.
+        const std::string CYCLE_LOG{(commandlineArguments.count("cycle-log") != 0) ?
+          commandlineArguments["cycle-log"] : ""};
+        const float FLUSH_INTERVAL{(commandlineArguments.count("cycle-log-flush") != 0) ?
+          std::stof(commandlineArguments["cycle-log-flush"]) : 1.0f};
+        CycleLogWriter cycleLog{CYCLE_LOG, CYCLE_LOG.empty() ? 1u : 8192u, FLUSH_INTERVAL, 0.01f};
+        if (!CYCLE_LOG.empty() && !cycleLog.isOpen()) {
+          std::cerr << "[ACTION-MOTION] Could not write " << CYCLE_LOG << std::endl;
+          return 1;
+        }
+        Service service{motion, parameterSource, torqueSender, emergencySender, cycleLog.isOpen() ? &cycleLog : nullptr, {nullptr}, nullptr, VERBOSE, PERIODIC, {},
+          initialWatchdogState()};
+
+        // The speed estimator fuses all wheel speeds, an external ground speed
+        // and the IMU, fed through the routes shared with motion-replay
+        InputFeed feed{motion, VERBOSE, 0};
+        const std::array<Route, 1> first{{
+          makeRoute<Service, onResStatus>(opendlv::cfsdProxyCANReading::RESStatus::ID(), ANY_SENDER_STAMP, service)}};
+        const std::array<Route, 2> last{{
+          makeRoute<Service, onGroundSpeedRequest>(opendlv::proxy::GroundSpeedRequest::ID(), 1500, service),
+          makeRoute<Service, onParameterRequest>(opendlv::cfsdLogic::LongitudinalControlParameterRequest::ID(),
+              ANY_SENDER_STAMP, service)}};
+        Dispatcher<1 + SENSOR_ROUTES + 2> dispatcher{
+          joinRoutes(joinRoutes(first, sensorRoutes(feed, inputSenderStamps(commandlineArguments))), last)};
+
+        // Interface to a running OpenDaVINCI session, all envelopes go through
+        // the dispatcher. With --recv-batch a batched receiver and a plain
+        // sender take the place of the session.
+        const uint32_t RECV_BATCH{(commandlineArguments.count("recv-batch") != 0) ?
+          static_cast<uint32_t>(std::stoi(commandlineArguments["recv-batch"])) : 0};
+        std::unique_ptr<cluon::OD4Session> od4;
+        std::unique_ptr<cluon::UDPSender> sender;
+        std::unique_ptr<BatchReceiver> receiver;
+        auto toDispatcher{[&dispatcher](cluon::data::Envelope &&envelope) { dispatcher.dispatch(envelope); }};
+        if (RECV_BATCH > 0) {
+          BatchReceiverConfig receiverConfig;
+          receiverConfig.batch = RECV_BATCH;
+          receiverConfig.busyPoll = (commandlineArguments.count("busy-poll") != 0) ?
+            static_cast<uint32_t>(std::stoi(commandlineArguments["busy-poll"])) : 0;
+          const std::string GROUP{"225.0.0." + std::to_string(CID)};
+          sender.reset(new cluon::UDPSender(GROUP, 12175));
+          service.sender = sender.get();
+          receiver.reset(new BatchReceiver(GROUP, 12175, receiverConfig, toDispatcher));
+          if (!receiver->isOpen()) {
+            std::cerr << "[ACTION-MOTION] Could not receive from " << GROUP << std::endl;
+            return 1;
           }
-        }};
-        od4.dataTrigger(opendlv::proxy::WheelSpeedReading::ID(), onWheelSpeedReading);
-
-      auto onGroundSpeedRequest{[&motion, &od4, VERBOSE](cluon::data::Envelope &&envelope)
-        {
-          uint16_t senderStamp = envelope.senderStamp();
-          if (senderStamp == 1500) {
-            auto gsr = cluon::extractMessage<opendlv::proxy::GroundSpeedRequest>(std::move(envelope));
-            motion.setSpeedRequest(gsr.groundSpeed());
-
-            // Calculate and send torque request once we get a new groundSpeedRequest
-            opendlv::cfsdProxy::TorqueRequestDual msgTorque = motion.step();
-            cluon::data::TimeStamp sampleTime = cluon::time::now();
-            od4.send(msgTorque, sampleTime, 2101);
-
-            if (VERBOSE) {
-              std::cout << "[ACTION-MOTION] Groundspeed request: " << gsr.groundSpeed() << std::endl;
+        } else {
+          od4.reset(new cluon::OD4Session(CID, toDispatcher));
+          service.od4.store(od4.get(), std::memory_order_relaxed);
+        }
+        auto isRunning{[&od4, &receiver]() { return od4 ? od4->isRunning() : receiver->isRunning(); }};
+        dispatcher.start();
+
+        // Co-located producers write into shared memory next to the session
+        const std::string SHM_INPUT{(commandlineArguments.count("shm-input") != 0) ?
+          commandlineArguments["shm-input"] : ""};
+        std::unique_ptr<SharedInputReader> sharedInput;
+        std::thread sharedInputThread;
+        if (!SHM_INPUT.empty()) {
+          sharedInput.reset(new SharedInputReader(SHM_INPUT, 1024));
+          if (!sharedInput->isOpen()) {
+            std::cerr << "[ACTION-MOTION] Could not create shared memory " << SHM_INPUT << std::endl;
+            return 1;
+          }
+          sharedInputThread = std::thread([&service, &sharedInput, &isRunning]() {
+              std::array<SharedInputRecord, 64> records;
+              while (isRunning()) {
+                const uint32_t count = sharedInput->read(records.data(), static_cast<uint32_t>(records.size()), 100000);
+                for (uint32_t i = 0; i < count; i++) {
+                  onSharedInput(service, records[i]);
+                }
+              }
+            });
+        }
+
+        // Reloads the parameter file when it changes
+        std::atomic<bool> watching{!PARAMETER_FILE.empty()};
+        std::thread watcher([&parameterSource, &watching]() {
+            using namespace std::literals::chrono_literals;
+            while (watching.load(std::memory_order_relaxed)) {
+              std::this_thread::sleep_for(500ms);
+              std::string reloadError;
+              if (parameterSource.fileChanged()) {
+                if (parameterSource.reload(reloadError)) {
+                  std::cout << "[ACTION-MOTION] Parameters reloaded" << std::endl;
+                } else {
+                  std::cerr << "[ACTION-MOTION] Parameters not reloaded: " << reloadError << std::endl;
+                }
+              }
             }
+          });
+
+        if (PERIODIC) {
+          // Fixed-rate control loop, runs step() on the latest cached inputs
+          CycleMonitor monitor(FREQ);
+          const uint64_t REPORT_CYCLES{static_cast<uint64_t>(FREQ) > 0 ? static_cast<uint64_t>(FREQ) : 1};
+          const float SAMPLE_TIME{1.0f / FREQ};
+          auto atFrequency{[&service, &isRunning, &monitor, VERBOSE, REPORT_CYCLES, SAMPLE_TIME]() -> bool
+            {
+              const int64_t cycleStart = microsecondsOf(cluon::time::now());
+              opendlv::cfsdProxy::TorqueRequestDual msgTorque = controlCycle(service, SAMPLE_TIME);
+              monitor.record(cycleStart, microsecondsOf(cluon::time::now()));
+
+              if (VERBOSE) {
+                std::cout << "[ACTION-MOTION] Torque request: " << msgTorque.torqueLeft()
+                  << ", " << msgTorque.torqueRight() << ", jitter: " << monitor.lastJitter() << " us" << std::endl;
+              }
+              if (monitor.cycles() % REPORT_CYCLES == 0) {
+                std::cout << "[ACTION-MOTION] Cycles: " << monitor.cycles()
+                  << ", overruns: " << monitor.overruns()
+                  << ", mean jitter: " << monitor.meanJitter() << " us"
+                  << ", max jitter: " << monitor.maxJitter() << " us"
+                  << ", max compute: " << monitor.maxComputeTime() << " us" << std::endl;
+                publishDiagnostics(service, monitor.overruns());
+              }
+              return isRunning();
+            }};
+          if (REALTIME) {
+            std::thread control([&realtimeConfig, &realtimeStatus, &atFrequency, FREQ]() {
+                setUpRealtimeThread(realtimeConfig, realtimeStatus);
+                std::istringstream report(realtimeReport(realtimeStatus));
+                std::string line;
+                while (std::getline(report, line)) {
+                  std::cout << "[ACTION-MOTION] Real-time " << line << std::endl;
+                }
+                runAtFrequency(FREQ, atFrequency);
+              });
+            control.join();
+          } else if (od4) {
+            od4->timeTrigger(FREQ, atFrequency);
+          } else {
+            runAtFrequency(FREQ, atFrequency);
           }
-        }};
-        od4.dataTrigger(opendlv::proxy::WheelSpeedReading::ID(), onGroundSpeedRequest);
 
-        // Just sleep as this microservice is data driven
-        using namespace std::literals::chrono_literals;
-        while(od4.isRunning()) {
-          std::this_thread::sleep_for(1s);
+          std::cout << "[ACTION-MOTION] Control loop at " << FREQ << " Hz finished after "
+            << monitor.cycles() << " cycles, " << monitor.overruns() << " overruns, max jitter "
+            << monitor.maxJitter() << " us" << std::endl;
+        } else {
+          // Just sleep as this microservice is data driven
+          using namespace std::literals::chrono_literals;
+          while(isRunning()) {
+            std::this_thread::sleep_for(1s);
+            publishDiagnostics(service, 0);
+          }
+        }
+        dispatcher.stop();
+        watching.store(false, std::memory_order_relaxed);
+        watcher.join();
+        if (sharedInputThread.joinable()) {
+          sharedInput->wake();
+          sharedInputThread.join();
+          std::cout << "[ACTION-MOTION] Shared memory input: " << sharedInput->received() << " records, "
+            << sharedInput->lost() << " lost" << std::endl;
+        }
+        dumpLatencies(service.latencies);
+        if (receiver) {
+          receiver->stop();
+          const BatchReceiverCounters counters = receiver->counters();
+          std::cout << "[ACTION-MOTION] Received " << counters.datagrams << " datagrams in "
+            << counters.syscalls << " system calls ("
+            << static_cast<float>(counters.datagrams) / static_cast<float>(std::max<uint64_t>(counters.syscalls, 1))
+            << " per call, at most " << counters.maxBatch << "), " << counters.emptyPolls << " empty polls, "
+            << counters.kernelDrops << " dropped by the socket, " << counters.invalid << " invalid" << std::endl;
+        }
+        if (cycleLog.isOpen()) {
+          cycleLog.stop();
+          std::cout << "[ACTION-MOTION] Cycle log: " << cycleLog.written() << " cycles written, "
+            << cycleLog.dropped() << " dropped" << std::endl;
         }
 
     }
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mpc-controller.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr uint32_t N{MPC_HORIZON};
+constexpr uint32_t CONSTRAINTS{2 * MPC_HORIZON};
+// ADMM parameters, the variables are accelerations so one scale fits all;
+// rho is of the order of the Hessian entries for the default weights
+constexpr float RHO{0.1f};
+constexpr float SIGMA{1e-6f};
+constexpr float ALPHA{1.6f};
+constexpr float TOLERANCE{1e-3f};
+constexpr float RELATIVE_TOLERANCE{1e-3f};
+constexpr uint32_t CHECK_EVERY{5};
+
+using Vector = std::array<float, N>;
+using Matrix = std::array<float, N * N>;
+
+void multiply(const Matrix &m, const Vector &v, Vector &result)
+{
+  for (uint32_t i = 0; i < N; i++) {
+    float sum{0.0f};
+    for (uint32_t j = 0; j < N; j++) {
+      sum += m[i * N + j] * v[j];
+    }
+    result[i] = sum;
+  }
+}
+
+// Gauss-Jordan with partial pivoting, the matrix is symmetric positive definite
+bool invert(Matrix m, Matrix &inverse)
+{
+  inverse.fill(0.0f);
+  for (uint32_t i = 0; i < N; i++) {
+    inverse[i * N + i] = 1.0f;
+  }
+  for (uint32_t column = 0; column < N; column++) {
+    uint32_t pivot = column;
+    for (uint32_t row = column + 1; row < N; row++) {
+      if (std::fabs(m[row * N + column]) > std::fabs(m[pivot * N + column])) {
+        pivot = row;
+      }
+    }
+    if (std::fabs(m[pivot * N + column]) < 1e-12f) {
+      return false;
+    }
+    for (uint32_t j = 0; j < N; j++) {
+      std::swap(m[column * N + j], m[pivot * N + j]);
+      std::swap(inverse[column * N + j], inverse[pivot * N + j]);
+    }
+    const float scale = 1.0f / m[column * N + column];
+    for (uint32_t j = 0; j < N; j++) {
+      m[column * N + j] *= scale;
+      inverse[column * N + j] *= scale;
+    }
+    for (uint32_t row = 0; row < N; row++) {
+      if (row != column) {
+        const float factor = m[row * N + column];
+        for (uint32_t j = 0; j < N; j++) {
+          m[row * N + j] -= factor * m[column * N + j];
+          inverse[row * N + j] -= factor * inverse[column * N + j];
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// D x, the differences between consecutive accelerations; the first row is
+// x_0 itself, its bounds carry the previous acceleration
+void differences(const Vector &x, Vector &result)
+{
+  result[0] = x[0];
+  for (uint32_t i = 1; i < N; i++) {
+    result[i] = x[i] - x[i - 1];
+  }
+}
+
+// D' w
+void differencesTransposed(const float *w, Vector &result)
+{
+  for (uint32_t i = 0; i + 1 < N; i++) {
+    result[i] = w[i] - w[i + 1];
+  }
+  result[N - 1] = w[N - 1];
+}
+
+}
+
+MpcConfig defaultMpcConfig()
+{
+  MpcConfig config;
+  config.horizonStep = 0.05f;
+  config.trackingWeight = 1.0f;
+  config.rateWeight = 0.05f;
+  config.effortWeight = 0.001f;
+  // Only motion bounds the solve in time as well
+  config.solveTimeout = 0.0f;
+  config.maxIterations = 400;
+  return config;
+}
+
+MpcState initialMpcState()
+{
+  MpcState state;
+  state.x.fill(0.0f);
+  state.z.fill(0.0f);
+  state.y.fill(0.0f);
+  state.iterations = 0;
+  state.solves = 0;
+  state.timeouts = 0;
+  return state;
+}
+
+MpcModel mpcSetUp(const MpcConfig &config)
+{
+  // Speeds over the horizon are v0 + S x with S lower triangular of the step,
+  // P = 2 (wt S'S + wr D'D + we I)
+  const float h = config.horizonStep;
+  Matrix hessian;
+  for (uint32_t i = 0; i < N; i++) {
+    for (uint32_t j = 0; j < N; j++) {
+      // (S'S)_ij = h^2 (N - max(i, j))
+      const float trackingTerm = h * h * static_cast<float>(N - std::max(i, j));
+      const uint32_t distance = (i > j) ? i - j : j - i;
+      const float rateTerm = (distance == 0) ? ((i + 1 < N) ? 2.0f : 1.0f) : ((distance == 1) ? -1.0f : 0.0f);
+      const float effortTerm = (i == j) ? 1.0f : 0.0f;
+      hessian[i * N + j] = 2.0f * (config.trackingWeight * trackingTerm
+          + config.rateWeight * rateTerm + config.effortWeight * effortTerm);
+    }
+  }
+
+  // A = [I; D], so A'A = I + D'D
+  Matrix kkt = hessian;
+  for (uint32_t i = 0; i < N; i++) {
+    for (uint32_t j = 0; j < N; j++) {
+      const uint32_t distance = (i > j) ? i - j : j - i;
+      const float differenceTerm = (distance == 0) ? ((i + 1 < N) ? 2.0f : 1.0f) : ((distance == 1) ? -1.0f : 0.0f);
+      kkt[i * N + j] += RHO * (((i == j) ? 1.0f : 0.0f) + differenceTerm) + ((i == j) ? SIGMA : 0.0f);
+    }
+  }
+
+  MpcModel model;
+  model.hessian = hessian;
+  if (!invert(kkt, model.inverse)) {
+    model.inverse.fill(0.0f);
+  }
+  return model;
+}
+
+bool mpcStep(const MpcConfig &config, const MpcModel &model, MpcState &state,
+    const MpcInputs &inputs, float modelGain, float &torque)
+{
+  const bool timed{config.solveTimeout > 0.0f};
+  const auto started = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+  const auto timeout = std::chrono::duration<float>(config.solveTimeout);
+  const float h = config.horizonStep;
+  state.solves++;
+
+  // Reference over the horizon, following the trajectory slope up to the request
+  Vector error;
+  for (uint32_t k = 0; k < N; k++) {
+    float reference = inputs.reference + inputs.referenceAcceleration * h * static_cast<float>(k + 1);
+    reference = (inputs.referenceAcceleration >= 0.0f) ?
+      std::min(reference, std::max(inputs.speedRequest, inputs.reference)) :
+      std::max(reference, std::min(inputs.speedRequest, inputs.reference));
+    error[k] = inputs.speed - reference;
+  }
+
+  // q = 2 wt S'(v0 - r) - 2 wr u_prev e0, S' is a suffix sum
+  const float previous = inputs.previousTorque / modelGain;
+  Vector q;
+  float suffix{0.0f};
+  for (uint32_t k = N; k-- > 0;) {
+    suffix += error[k];
+    q[k] = 2.0f * config.trackingWeight * h * suffix;
+  }
+  q[0] -= 2.0f * config.rateWeight * previous;
+
+  // Bounds on the accelerations from torque and power at the speed the last
+  // plan predicts, and on their changes from the torque rate
+  std::array<float, CONSTRAINTS> lower;
+  std::array<float, CONSTRAINTS> upper;
+  const float powerTorque = 100.0f * inputs.powerLimit * inputs.wheelRadius / inputs.gearRatio;
+  const float rate = inputs.maxTorqueRate * h / modelGain;
+  float predicted = inputs.speed;
+  for (uint32_t k = 0; k < N; k++) {
+    const float speed = std::max(std::fabs(predicted), 0.1f);
+    const float maxTorque = std::min(inputs.torqueMax, powerTorque / speed);
+    const float minTorque = (predicted < inputs.regenCutoffSpeed) ? 0.0f : std::max(inputs.torqueMin, -powerTorque / speed);
+    upper[k] = maxTorque / modelGain;
+    lower[k] = std::min(minTorque, maxTorque) / modelGain;
+    lower[N + k] = -rate;
+    upper[N + k] = rate;
+    predicted += h * state.x[k];
+  }
+  // The first change happens within one control cycle
+  const float firstRate = inputs.maxTorqueRate * ((inputs.dt > 0.0f) ? inputs.dt : h) / modelGain;
+  lower[N] = previous - firstRate;
+  upper[N] = previous + firstRate;
+
+  // ADMM iterations, warm started from the last plan
+  Vector x = state.x;
+  std::array<float, CONSTRAINTS> z = state.z;
+  std::array<float, CONSTRAINTS> y = state.y;
+  Vector rhs;
+  Vector xTilde;
+  Vector dxTilde;
+  Vector aty;
+  bool converged{false};
+  uint32_t iteration{0};
+  while (iteration < config.maxIterations) {
+    // rhs = sigma x - q + A'(rho z - y)
+    std::array<float, CONSTRAINTS> w;
+    for (uint32_t i = 0; i < CONSTRAINTS; i++) {
+      w[i] = RHO * z[i] - y[i];
+    }
+    differencesTransposed(w.data() + N, rhs);
+    for (uint32_t i = 0; i < N; i++) {
+      rhs[i] += SIGMA * x[i] - q[i] + w[i];
+    }
+    multiply(model.inverse, rhs, xTilde);
+    differences(xTilde, dxTilde);
+
+    for (uint32_t i = 0; i < CONSTRAINTS; i++) {
+      const float zTilde = (i < N) ? xTilde[i] : dxTilde[i - N];
+      const float relaxed = ALPHA * zTilde + (1.0f - ALPHA) * z[i];
+      const float next = std::min(std::max(relaxed + y[i] / RHO, lower[i]), upper[i]);
+      y[i] += RHO * (relaxed - next);
+      z[i] = next;
+    }
+    for (uint32_t i = 0; i < N; i++) {
+      x[i] = ALPHA * xTilde[i] + (1.0f - ALPHA) * x[i];
+    }
+    iteration++;
+
+    if (iteration % CHECK_EVERY == 0) {
+      // Primal residual A x - z and dual residual P x + q + A'y
+      Vector dx;
+      differences(x, dx);
+      float primal{0.0f};
+      float primalScale{0.0f};
+      for (uint32_t i = 0; i < N; i++) {
+        primal = std::max(primal, std::max(std::fabs(x[i] - z[i]), std::fabs(dx[i] - z[N + i])));
+        primalScale = std::max(primalScale, std::max(std::fabs(x[i]), std::fabs(dx[i])));
+        primalScale = std::max(primalScale, std::max(std::fabs(z[i]), std::fabs(z[N + i])));
+      }
+      Vector px;
+      multiply(model.hessian, x, px);
+      differencesTransposed(y.data() + N, aty);
+      float dual{0.0f};
+      float dualScale{0.0f};
+      for (uint32_t i = 0; i < N; i++) {
+        dual = std::max(dual, std::fabs(px[i] + q[i] + y[i] + aty[i]));
+        dualScale = std::max(dualScale, std::max(std::fabs(px[i]), std::fabs(q[i])));
+        dualScale = std::max(dualScale, std::fabs(y[i] + aty[i]));
+      }
+      if (primal < TOLERANCE + RELATIVE_TOLERANCE * primalScale
+          && dual < TOLERANCE + RELATIVE_TOLERANCE * dualScale) {
+        converged = true;
+        break;
+      }
+      if (timed && std::chrono::steady_clock::now() - started > timeout) {
+        break;
+      }
+    }
+  }
+  state.iterations = iteration;
+
+  if (!converged) {
+    // Resume from the unfinished iterate next cycle, unless it diverged
+    bool finite{true};
+    for (uint32_t i = 0; i < N; i++) {
+      finite = finite && std::isfinite(x[i]);
+    }
+    if (finite) {
+      state.x = x;
+      state.z = z;
+      state.y = y;
+    } else {
+      state.x.fill(0.0f);
+      state.z.fill(0.0f);
+      state.y.fill(0.0f);
+    }
+    state.timeouts++;
+    return false;
+  }
+  state.x = x;
+  state.z = z;
+  state.y = y;
+  // Within the torque and the rate bounds of the first step
+  const float first = std::min(std::max(x[0], std::max(lower[0], lower[N])), std::min(upper[0], upper[N]));
+  torque = first * modelGain;
+  return true;
+}
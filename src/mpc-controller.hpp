@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPC_CONTROLLER_H
+#define MPC_CONTROLLER_H
+
+#include <array>
+#include <cstdint>
+
+// Model-predictive speed controller over a short, fixed horizon. The model
+// is the car as a point mass driven by the total motor torque; the decision
+// variables are the accelerations the torque produces at each horizon step.
+// The QP minimises the speed tracking error, torque changes and effort
+// subject to motor torque, power and torque rate limits. It is solved by
+// ADMM with the KKT matrix inverted once when the configuration changes, so
+// a cycle is a fixed number of dense matrix-vector products over arrays of
+// compile-time size.
+
+constexpr uint32_t MPC_HORIZON{10};
+
+struct MpcConfig {
+  float horizonStep;           // Time between horizon points [s]
+  float trackingWeight;        // On the speed error [1/(m/s)^2]
+  float rateWeight;            // On acceleration changes between steps
+  float effortWeight;          // On acceleration
+  float solveTimeout;          // Fall back to the P law beyond this, 0 for none [s]
+  uint32_t maxIterations;      // Fall back to the P law beyond this
+};
+
+// Precomputed from the configuration
+struct MpcModel {
+  std::array<float, MPC_HORIZON * MPC_HORIZON> inverse;  // (P + sigma I + rho A'A)^-1, row-major
+  std::array<float, MPC_HORIZON * MPC_HORIZON> hessian;  // P, for the dual residual
+};
+
+struct MpcState {
+  std::array<float, MPC_HORIZON> x;       // Planned accelerations [m/s^2]
+  std::array<float, 2 * MPC_HORIZON> z;   // Constrained values of [x; D x]
+  std::array<float, 2 * MPC_HORIZON> y;   // Dual variables
+  uint32_t iterations;                    // Of the last solve
+  uint64_t solves;
+  uint64_t timeouts;
+};
+
+struct MpcInputs {
+  float speed;                 // Current vehicle speed [m/s]
+  float reference;             // Reference speed now [m/s]
+  float referenceAcceleration; // Slope of the reference [m/s^2]
+  float speedRequest;          // Where the reference is heading [m/s]
+  float previousTorque;        // Total torque applied in the last cycle [cNm]
+  float torqueMin;             // Total motor torque limits [cNm]
+  float torqueMax;
+  float maxTorqueRate;         // Total torque change [cNm/s]
+  float powerLimit;            // Total motor power, both directions [W]
+  float regenCutoffSpeed;      // No negative torque below this [m/s]
+  float gearRatio;
+  float wheelRadius;           // [m]
+  float dt;                    // Until the next step, for the first torque change [s]
+};
+
+MpcConfig defaultMpcConfig();
+MpcState initialMpcState();
+MpcModel mpcSetUp(const MpcConfig &config);
+
+// Returns false if the solver ran out of iterations, or of time when a
+// timeout is set, torque is then left untouched. Without a timeout the
+// result only depends on the inputs, as replays and sweeps need. Otherwise torque is the total torque to apply [cNm].
+bool mpcStep(const MpcConfig &config, const MpcModel &model, MpcState &state,
+    const MpcInputs &inputs, float modelGain, float &torque);
+#endif
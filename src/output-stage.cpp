@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "output-stage.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Largest magnitude converted from float, well inside int32_t
+const float FLOAT_RANGE{2.0e9f};
+const int64_t INT32_RANGE{std::numeric_limits<int32_t>::max()};
+
+// NaN and infinity become zero torque
+int32_t saturate(float value)
+{
+  const float finite = std::isfinite(value) ? value : 0.0f;
+  return static_cast<int32_t>(std::min(std::max(finite, -FLOAT_RANGE), FLOAT_RANGE));
+}
+
+int64_t clamp(int64_t value, int64_t lower, int64_t upper)
+{
+  return std::min(std::max(value, lower), upper);
+}
+
+// Rounded, with anything beyond int32_t as no limit at all
+int64_t integerLimit(double value)
+{
+  return std::llround(std::min(value, static_cast<double>(INT32_RANGE)));
+}
+
+}
+
+OutputStageConfig defaultOutputStageConfig()
+{
+  OutputStageConfig config;
+  config.torqueMin = {{-MOTOR_TORQUE_MAX, -MOTOR_TORQUE_MAX}};
+  config.torqueMax = {{MOTOR_TORQUE_MAX, MOTOR_TORQUE_MAX}};
+  // The rate is limited only when configured
+  config.maxTorqueRate = std::numeric_limits<float>::max();
+  config.powerLimit = 2.0f * MOTOR_POWER_MAX;
+  config.powerMinSpeed = 0.1f;
+  return config;
+}
+
+OutputStageState initialOutputStageState()
+{
+  OutputStageState state;
+  state.output = {{0, 0}};
+  state.limited = 0;
+  return state;
+}
+
+OutputStageModel outputStageSetUp(const OutputStageConfig &config, float wheelRadius, float gearRatio)
+{
+  OutputStageModel model;
+  for (uint32_t i = LEFT; i <= RIGHT; i++) {
+    // Zero torque is always allowed
+    model.torqueMin[i] = std::min(saturate(config.torqueMin[i]), 0);
+    model.torqueMax[i] = std::max(saturate(config.torqueMax[i]), 0);
+  }
+  model.torqueRate = integerLimit(0.5 * static_cast<double>(config.maxTorqueRate));
+  // T [cNm] = 100 * P / omega_motor = 100 * P * r / (gear * v), with v in [mm/s]
+  const double powerTorque = 0.5 * static_cast<double>(config.powerLimit) * 100.0
+      * static_cast<double>(wheelRadius) / static_cast<double>(gearRatio) * 1000.0;
+  model.powerTorque = (powerTorque < static_cast<double>(INT32_RANGE) * static_cast<double>(INT32_RANGE)) ?
+    std::llround(powerTorque) : INT32_RANGE * INT32_RANGE;
+  model.minSpeed = std::max(saturate(config.powerMinSpeed * 1000.0f), 1);
+  return model;
+}
+
+MotorTorques outputStageUpdate(const OutputStageModel &model, OutputStageState &state,
+    const WheelPair &torque, const WheelPair &wheelSpeed, int32_t dt)
+{
+  // Without elapsed time the slew limit would hold the output forever
+  const int64_t step = (dt > 0 && model.torqueRate < INT32_RANGE) ? model.torqueRate * dt / 1000000 : INT32_RANGE;
+
+  uint32_t limited{0};
+  for (uint32_t i = LEFT; i <= RIGHT; i++) {
+    const int64_t requested = saturate(torque[i]);
+    const int64_t speed = std::max(saturate(std::fabs(wheelSpeed[i]) * 1000.0f), model.minSpeed);
+    const int64_t power = std::min(model.powerTorque / speed, INT32_RANGE);
+    const int64_t previous = state.output[i];
+
+    // Slew first, the torque and power limits then win over the rate. Only
+    // growing torque is slewed, anything towards zero (the slip limiter, the
+    // watchdog) passes within the cycle.
+    const int64_t slewed = clamp(requested, std::min<int64_t>(previous, 0) - step, std::max<int64_t>(previous, 0) + step);
+    const int64_t upper = std::min<int64_t>(model.torqueMax[i], power);
+    const int64_t lower = std::max<int64_t>(model.torqueMin[i], -power);
+    const int64_t output = clamp(slewed, lower, upper);
+
+    const uint32_t torqueLimited = static_cast<uint32_t>(slewed > model.torqueMax[i])
+      | static_cast<uint32_t>(slewed < model.torqueMin[i]);
+    const uint32_t powerLimited = static_cast<uint32_t>(slewed > power) | static_cast<uint32_t>(slewed < -power);
+    limited |= static_cast<uint32_t>(slewed != requested) << (LIMIT_RATE * 2 + i)
+      | torqueLimited << (LIMIT_TORQUE * 2 + i) | powerLimited << (LIMIT_POWER * 2 + i);
+    state.output[i] = static_cast<int32_t>(output);
+  }
+  state.limited = limited;
+  return state.output;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUT_STAGE_H
+#define OUTPUT_STAGE_H
+
+#include "torque-distribution.hpp"
+
+#include <array>
+#include <cstdint>
+
+// Last stage before the torque requests go out: per motor torque limits, a
+// power limit at the speed of the wheel the motor drives and a torque slew
+// limit. The configuration is converted once into integer limits; a step is
+// integer arithmetic with min/max only, no data-dependent branches, and its
+// result is exactly the integer torque that is sent.
+
+using MotorTorques = std::array<int32_t, 2>;
+
+enum OutputLimit : uint8_t {
+  LIMIT_TORQUE,
+  LIMIT_POWER,
+  LIMIT_RATE,
+  OUTPUT_LIMITS
+};
+
+struct OutputStageConfig {
+  WheelPair torqueMin;         // Per motor [cNm]
+  WheelPair torqueMax;         // Per motor [cNm]
+  float maxTorqueRate;         // Total torque change, half per motor [cNm/s]
+  float powerLimit;            // Total motor power, half per motor, both directions [W]
+  float powerMinSpeed;         // The power limit stays constant below this wheel speed [m/s]
+};
+
+// Integer form of the configuration for a given car
+struct OutputStageModel {
+  MotorTorques torqueMin;      // [cNm]
+  MotorTorques torqueMax;      // [cNm]
+  int64_t torqueRate;          // Per motor [cNm/s]
+  int64_t powerTorque;         // Per motor power limit as torque times wheel speed [cNm mm/s]
+  int32_t minSpeed;            // [mm/s]
+};
+
+struct OutputStageState {
+  MotorTorques output;         // As last sent [cNm]
+  uint32_t limited;            // Bit (limit * 2 + motor) for each OutputLimit that cut the request
+};
+
+OutputStageConfig defaultOutputStageConfig();
+OutputStageState initialOutputStageState();
+OutputStageModel outputStageSetUp(const OutputStageConfig &config, float wheelRadius, float gearRatio);
+
+// Torque [cNm] and the speed of the wheel driven by each motor [m/s], dt in
+// [us]; a step without elapsed time is not slew limited
+MotorTorques outputStageUpdate(const OutputStageModel &model, OutputStageState &state,
+    const WheelPair &torque, const WheelPair &wheelSpeed, int32_t dt);
+#endif
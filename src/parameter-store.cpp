@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parameter-store.hpp"
+
+#include <sys/stat.h>
+
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+MotionParameters defaultMotionParameters()
+{
+  MotionParameters parameters;
+  parameters.version = 0;
+  parameters.mass = 217.4f;
+  parameters.wheelRadius = 0.22f;
+  parameters.gearRatio = 16.0f;
+  parameters.regenCutoffSpeed = 5.0f / 3.6f;
+  parameters.controller = defaultControllerConfig(modelGainOf(parameters));
+  parameters.estimator = defaultEstimatorConfig();
+  parameters.distribution = defaultDistributionConfig();
+  parameters.watchdog = defaultWatchdogConfig();
+  parameters.trajectory = defaultTrajectoryConfig();
+  parameters.mpc = defaultMpcConfig();
+  parameters.output = defaultOutputStageConfig();
+  // Feed-forward of the trajectory acceleration through the model
+  parameters.controller.feedForwardGain = modelGainOf(parameters);
+  return parameters;
+}
+
+float modelGainOf(const MotionParameters &parameters)
+{
+  return parameters.mass * parameters.wheelRadius / parameters.gearRatio * 100.0f;
+}
+
+bool parseParameters(const ParameterValues &values, MotionParameters &parameters, std::string &error)
+{
+  MotionParameters result = defaultMotionParameters();
+  result.version = parameters.version;
+
+  // Every key looked at, whatever is left over is not a parameter
+  std::set<std::string> known;
+  auto has = [&values, &known](const std::string &key) {
+      known.insert(key);
+      return values.count(key) != 0;
+    };
+  // Given as flags on the command line, may also be set to 0 in a file
+  auto isSet = [&values, &known](const std::string &key) {
+      known.insert(key);
+      auto entry = values.find(key);
+      return entry != values.end() && entry->second != "0" && entry->second != "false";
+    };
+  auto readFloat = [&values, &known](const std::string &key, float &value) {
+      known.insert(key);
+      auto entry = values.find(key);
+      if (entry != values.end()) {
+        // std::stof takes nan and inf as well
+        const float parsed = std::stof(entry->second);
+        if (!std::isfinite(parsed)) {
+          throw std::invalid_argument(key + "=" + entry->second);
+        }
+        value = parsed;
+      }
+    };
+
+  try {
+    readFloat("mass", result.mass);
+    readFloat("wheel-radius", result.wheelRadius);
+    readFloat("gear-ratio", result.gearRatio);
+    readFloat("regen-cutoff", result.regenCutoffSpeed);
+    if (!(result.mass > 0.0f && result.wheelRadius > 0.0f && result.gearRatio > 0.0f)) {
+      error = "mass, wheel-radius and gear-ratio must be positive";
+      return false;
+    }
+
+    // Gains default to the model of the (possibly changed) car
+    const float modelGain = modelGainOf(result);
+    ControllerConfig &controller = result.controller;
+    controller = defaultControllerConfig(modelGain);
+    if (has("controller") && !parseControllerType(values.at("controller"), controller.type)) {
+      error = "unknown controller " + values.at("controller");
+      return false;
+    }
+    if (has("anti-windup") && !parseAntiWindup(values.at("anti-windup"), controller.antiWindup)) {
+      error = "unknown anti-windup " + values.at("anti-windup");
+      return false;
+    }
+    readFloat("kp", controller.kp);
+    readFloat("ki", controller.ki);
+    readFloat("kd", controller.kd);
+    readFloat("td", controller.derivativeFilterTime);
+    readFloat("kb", controller.backCalculationGain);
+    readFloat("torque-min", controller.outputMin);
+    readFloat("torque-max", controller.outputMax);
+    if (!(controller.outputMin <= controller.outputMax)) {
+      error = "torque-min must not exceed torque-max";
+      return false;
+    }
+    float feedForward{1.0f};
+    readFloat("feed-forward", feedForward);
+    controller.feedForwardGain = feedForward * modelGain;
+
+    DistributionConfig &distribution = result.distribution;
+    readFloat("wheel-base", distribution.wheelBase);
+    readFloat("yaw-gain", distribution.yawGain);
+    readFloat("slip-limit", distribution.slipLimit);
+    readFloat("slip-band", distribution.slipBand);
+    float motorMax{distribution.motorMax[LEFT]};
+    readFloat("motor-max", motorMax);
+    distribution.motorMax = {{motorMax, motorMax}};
+    distribution.motorMin = {{-motorMax, -motorMax}};
+    result.output.torqueMax = distribution.motorMax;
+    result.output.torqueMin = distribution.motorMin;
+    distribution.rearWheelDrive = !isSet("front-wheel-drive");
+    if (!(distribution.wheelBase > 0.0f && distribution.slipBand > 0.0f && motorMax > 0.0f)) {
+      error = "wheel-base, slip-band and motor-max must be positive";
+      return false;
+    }
+
+    EstimatorConfig &estimator = result.estimator;
+    readFloat("outlier-threshold", estimator.outlierThreshold);
+    readFloat("outlier-ratio", estimator.outlierRatio);
+    readFloat("correction-time", estimator.correctionTime);
+    estimator.averageSamples = !isSet("no-sample-averaging");
+
+    WatchdogConfig &watchdog = result.watchdog;
+    watchdog.enabled = !isSet("no-watchdog");
+    readFloat("wheel-speed-timeout", watchdog.wheelSpeedTimeout);
+    readFloat("speed-request-timeout", watchdog.speedRequestTimeout);
+    readFloat("degraded-time", watchdog.degradedTime);
+    readFloat("ramp-rate", watchdog.rampRate);
+    if (!(watchdog.rampRate > 0.0f)) {
+      error = "ramp-rate must be positive";
+      return false;
+    }
+
+    TrajectoryConfig &trajectory = result.trajectory;
+    trajectory.enabled = !isSet("no-interpolation");
+    readFloat("max-interval", trajectory.maxInterval);
+    readFloat("max-acceleration", trajectory.maxAcceleration);
+    readFloat("max-deceleration", trajectory.maxDeceleration);
+    readFloat("lateral-acceleration-limit", trajectory.lateralAccelerationLimit);
+    readFloat("preview-timeout", trajectory.previewTimeout);
+    if (!(trajectory.maxAcceleration > 0.0f && trajectory.maxDeceleration > 0.0f)) {
+      error = "max-acceleration and max-deceleration must be positive";
+      return false;
+    }
+
+    MpcConfig &mpc = result.mpc;
+    readFloat("mpc-step", mpc.horizonStep);
+    readFloat("mpc-tracking-weight", mpc.trackingWeight);
+    readFloat("mpc-rate-weight", mpc.rateWeight);
+    readFloat("mpc-effort-weight", mpc.effortWeight);
+    float timeout{mpc.solveTimeout * 1e6f};
+    readFloat("mpc-timeout", timeout);
+    mpc.solveTimeout = timeout * 1e-6f;
+    float iterations{static_cast<float>(mpc.maxIterations)};
+    readFloat("mpc-iterations", iterations);
+    if (!(mpc.horizonStep > 0.0f && mpc.solveTimeout >= 0.0f && iterations >= 1.0f && iterations <= 1e6f)) {
+      error = "mpc-step and mpc-iterations must be positive, mpc-timeout must not be negative";
+      return false;
+    }
+    mpc.maxIterations = static_cast<uint32_t>(iterations);
+
+    OutputStageConfig &output = result.output;
+    readFloat("max-torque-rate", output.maxTorqueRate);
+    readFloat("power-limit", output.powerLimit);
+    if (!(output.maxTorqueRate > 0.0f && output.powerLimit > 0.0f)) {
+      error = "max-torque-rate and power-limit must be positive";
+      return false;
+    }
+  } catch (std::exception &e) {
+    error = std::string{"invalid number: "} + e.what();
+    return false;
+  }
+  for (auto &entry : values) {
+    if (known.count(entry.first) == 0) {
+      error = "unknown parameter " + entry.first;
+      return false;
+    }
+  }
+
+  parameters = result;
+  return true;
+}
+
+bool readParameterFile(const std::string &file, ParameterValues &values)
+{
+  std::ifstream in(file);
+  if (!in.good()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    line = line.substr(0, line.find('#'));
+    for (auto &entry : parseParameterString(line)) {
+      values[entry.first] = entry.second;
+    }
+  }
+  return true;
+}
+
+ParameterValues parseParameterString(const std::string &text)
+{
+  ParameterValues values;
+  std::string normalized{text};
+  for (char &c : normalized) {
+    if (c == ';') {
+      c = ' ';
+    }
+  }
+  std::stringstream sstr(normalized);
+  std::string pair;
+  while (sstr >> pair) {
+    const size_t separator = pair.find('=');
+    if (separator == std::string::npos) {
+      values[pair] = "";
+    } else {
+      values[pair.substr(0, separator)] = pair.substr(separator + 1);
+    }
+  }
+  return values;
+}
+
+ParameterStore::ParameterStore(const MotionParameters &initial)
+  : m_publishMutex{}
+  , m_blocks{}
+  , m_current{nullptr}
+  , m_readers{0}
+  , m_version{0}
+{
+  publish(initial);
+}
+
+const MotionParameters *ParameterStore::current() const
+{
+  return m_current.load(std::memory_order_acquire);
+}
+
+bool ParameterStore::copyIfNewer(uint32_t version, MotionParameters &parameters) const
+{
+  // Announced before the load, pairs with publish() checking for readers
+  // after its store
+  m_readers.fetch_add(1, std::memory_order_seq_cst);
+  const MotionParameters *block = m_current.load(std::memory_order_seq_cst);
+  const bool newer = block->version != version;
+  if (newer) {
+    parameters = *block;
+  }
+  m_readers.fetch_sub(1, std::memory_order_release);
+  return newer;
+}
+
+uint32_t ParameterStore::publish(const MotionParameters &parameters)
+{
+  std::lock_guard<std::mutex> lock(m_publishMutex);
+  std::unique_ptr<MotionParameters> block{new MotionParameters(parameters)};
+  block->version = ++m_version;
+  m_current.store(block.get(), std::memory_order_seq_cst);
+  m_blocks.push_back(std::move(block));
+  // A reader arriving from now on loads the new block, so without one inside
+  // copyIfNewer() nobody can hold the replaced ones
+  if (m_readers.load(std::memory_order_seq_cst) == 0) {
+    m_blocks.erase(m_blocks.begin(), m_blocks.end() - 1);
+  }
+  return m_version;
+}
+
+size_t ParameterStore::retained()
+{
+  std::lock_guard<std::mutex> lock(m_publishMutex);
+  return m_blocks.size();
+}
+
+namespace {
+
+// The command line without the options of the program and the positional
+// arguments, which cluon keeps with an empty value (flags are "1")
+ParameterValues parametersOf(const ParameterValues &commandLine, const ProgramOptions &options)
+{
+  ParameterValues values;
+  for (auto &entry : commandLine) {
+    if (!entry.second.empty() && options.count(entry.first) == 0) {
+      values.insert(entry);
+    }
+  }
+  return values;
+}
+
+}
+
+ParameterSource::ParameterSource(ParameterStore &store, const ParameterValues &commandLine,
+    const ProgramOptions &options, const std::string &file)
+  : m_mutex{}
+  , m_store(store)
+  , m_commandLine{parametersOf(commandLine, options)}
+  , m_file{file}
+  , m_fileModified{0}
+  , m_overrides{}
+{
+}
+
+bool ParameterSource::reload(std::string &error)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return rebuild(error);
+}
+
+bool ParameterSource::override(const ParameterValues &values, std::string &error)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const ParameterValues previous{m_overrides};
+  for (auto &entry : values) {
+    m_overrides[entry.first] = entry.second;
+  }
+  if (!rebuild(error)) {
+    m_overrides = previous;
+    return false;
+  }
+  return true;
+}
+
+bool ParameterSource::fileChanged()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return !m_file.empty() && modificationTime() != m_fileModified;
+}
+
+int64_t ParameterSource::modificationTime() const
+{
+  struct stat status;
+  if (::stat(m_file.c_str(), &status) != 0) {
+    return 0;
+  }
+  return static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+}
+
+bool ParameterSource::rebuild(std::string &error)
+{
+  ParameterValues values{m_commandLine};
+  if (!m_file.empty()) {
+    m_fileModified = modificationTime();
+    if (!readParameterFile(m_file, values)) {
+      error = "cannot read " + m_file;
+      return false;
+    }
+  }
+  for (auto &entry : m_overrides) {
+    values[entry.first] = entry.second;
+  }
+
+  MotionParameters parameters = *m_store.current();
+  if (!parseParameters(values, parameters, error)) {
+    return false;
+  }
+  m_store.publish(parameters);
+  return true;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARAMETER_STORE_H
+#define PARAMETER_STORE_H
+
+#include "controller.hpp"
+#include "input-watchdog.hpp"
+#include "mpc-controller.hpp"
+#include "output-stage.hpp"
+#include "speed-estimator.hpp"
+#include "speed-trajectory.hpp"
+#include "torque-distribution.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// All tunable parameters of the controller as one immutable block.
+struct MotionParameters {
+  uint32_t version;
+  float mass;                  // [kg]
+  float wheelRadius;           // [m]
+  float gearRatio;
+  float regenCutoffSpeed;      // [m/s]
+  ControllerConfig controller;
+  EstimatorConfig estimator;
+  DistributionConfig distribution;
+  WatchdogConfig watchdog;
+  TrajectoryConfig trajectory;
+  MpcConfig mpc;
+  OutputStageConfig output;
+};
+
+using ParameterValues = std::map<std::string, std::string>;
+// Names of the options of a program itself (cid, freq, ...)
+using ProgramOptions = std::set<std::string>;
+
+MotionParameters defaultMotionParameters();
+// Torque in [cNm] needed per [m/s^2] of acceleration
+float modelGainOf(const MotionParameters &parameters);
+
+// Builds parameters from the defaults and the given key/value pairs, using the
+// same names as the command line (e.g. mass, kp, controller, slip-limit).
+// Returns false and leaves parameters untouched on invalid values or keys
+// that are not parameters.
+bool parseParameters(const ParameterValues &values, MotionParameters &parameters, std::string &error);
+
+// Reads "key=value" lines, '#' starts a comment
+bool readParameterFile(const std::string &file, ParameterValues &values);
+// Reads "key=value" pairs separated by ';' or whitespace
+ParameterValues parseParameterString(const std::string &text);
+
+// Publishes parameter blocks to the control path. Readers on other threads
+// copy the current block in copyIfNewer() and never lock or allocate.
+// Publishing copies the new block into fresh memory and swaps the pointer.
+// Replaced blocks are freed by a publish that finds no reader inside
+// copyIfNewer(), so a reader can never see a block freed under it, and only
+// the blocks replaced while a copy was running are kept a little longer.
+class ParameterStore {
+  public:
+    explicit ParameterStore(const MotionParameters &initial);
+    ParameterStore(const ParameterStore &) = delete;
+    ParameterStore &operator=(const ParameterStore &) = delete;
+
+  public:
+    // Valid until the next publish, for the publishing thread
+    const MotionParameters *current() const;
+    // Copies the current block unless it has the given version
+    bool copyIfNewer(uint32_t version, MotionParameters &parameters) const;
+    // Returns the version of the published block
+    uint32_t publish(const MotionParameters &parameters);
+    // Blocks held by the store, the current one included
+    size_t retained();
+
+  private:
+    std::mutex m_publishMutex;
+    std::vector<std::unique_ptr<const MotionParameters>> m_blocks;
+    std::atomic<const MotionParameters *> m_current;
+    mutable std::atomic<uint32_t> m_readers;
+    uint32_t m_version;
+};
+
+// Layers the command line, an optional parameter file and runtime overrides
+// (in increasing precedence) and publishes the result to a store. A later
+// layer only changes the keys it names. The options of the program are left
+// out of the command line and, like any other unknown key, rejected in the
+// file and the overrides. Thread-safe, but not meant for the control path.
+class ParameterSource {
+  public:
+    ParameterSource(ParameterStore &store, const ParameterValues &commandLine, const ProgramOptions &options,
+        const std::string &file);
+    ParameterSource(const ParameterSource &) = delete;
+    ParameterSource &operator=(const ParameterSource &) = delete;
+
+  public:
+    // Rereads the file and publishes, keeps the current block on errors
+    bool reload(std::string &error);
+    // Adds runtime overrides and publishes, rejected as a whole on errors
+    bool override(const ParameterValues &values, std::string &error);
+    // Whether the file was modified since it was last read
+    bool fileChanged();
+
+  private:
+    int64_t modificationTime() const;
+    bool rebuild(std::string &error);
+
+  private:
+    std::mutex m_mutex;
+    ParameterStore &m_store;
+    const ParameterValues m_commandLine;
+    const std::string m_file;
+    int64_t m_fileModified;
+    ParameterValues m_overrides;
+};
+#endif
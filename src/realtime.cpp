@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "realtime.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+// Upper bound of the stack that is touched, the control thread is a
+// std::thread with the default stack of several megabytes
+const uint32_t MAX_STACK_PREFAULT{1024 * 1024};
+
+size_t pageSize()
+{
+  const long size = sysconf(_SC_PAGESIZE);
+  return (size > 0) ? static_cast<size_t>(size) : 4096;
+}
+
+// Touches every page of a stack frame of the given size; noinline so the
+// frame is really allocated below the caller
+__attribute__((noinline)) uint8_t touchStack(uint32_t bytes)
+{
+  volatile uint8_t stack[MAX_STACK_PREFAULT];
+  const size_t page = pageSize();
+  stack[0] = 0;
+  for (size_t i = 0; i < bytes && i < MAX_STACK_PREFAULT; i += page) {
+    stack[i] = 0;
+  }
+  return stack[0];
+}
+
+void setResult(RealtimeStatus &status, RealtimeSetting setting, bool applied, int32_t error)
+{
+  status.applied[setting] = applied;
+  status.error[setting] = applied ? 0 : error;
+}
+
+}
+
+RealtimeConfig defaultRealtimeConfig()
+{
+  RealtimeConfig config;
+  config.priority = 0;
+  config.cpu = -1;
+  config.lockMemory = false;
+  config.heapPrefault = 0;
+  config.stackPrefault = 0;
+  return config;
+}
+
+RealtimeStatus initialRealtimeStatus()
+{
+  RealtimeStatus status;
+  status.requested.fill(false);
+  status.applied.fill(false);
+  status.error.fill(0);
+  return status;
+}
+
+const char *realtimeSettingName(RealtimeSetting setting)
+{
+  switch (setting) {
+    case RT_MEMORY_LOCK:
+      return "memory lock";
+    case RT_HEAP_PREFAULT:
+      return "heap prefault";
+    case RT_STACK_PREFAULT:
+      return "stack prefault";
+    case RT_AFFINITY:
+      return "CPU affinity";
+    case RT_SCHEDULING:
+      return "SCHED_FIFO";
+    case RT_SETTINGS:
+      break;
+  }
+  return "";
+}
+
+void setUpRealtimeProcess(const RealtimeConfig &config, RealtimeStatus &status)
+{
+  if (config.lockMemory) {
+    status.requested[RT_MEMORY_LOCK] = true;
+    const bool locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    setResult(status, RT_MEMORY_LOCK, locked, errno);
+  }
+
+  if (config.heapPrefault > 0) {
+    // Freed memory stays in the heap and large blocks do not get their own
+    // mappings, so the prefaulted pages are what later allocations reuse
+    status.requested[RT_HEAP_PREFAULT] = true;
+    bool prefaulted = mallopt(M_TRIM_THRESHOLD, -1) == 1 && mallopt(M_MMAP_MAX, 0) == 1;
+    uint8_t *heap = prefaulted ? static_cast<uint8_t *>(std::malloc(config.heapPrefault)) : nullptr;
+    if (heap != nullptr) {
+      const size_t page = pageSize();
+      for (size_t i = 0; i < config.heapPrefault; i += page) {
+        heap[i] = 0;
+      }
+      std::free(heap);
+    }
+    setResult(status, RT_HEAP_PREFAULT, heap != nullptr, prefaulted ? ENOMEM : EINVAL);
+  }
+}
+
+void setUpRealtimeThread(const RealtimeConfig &config, RealtimeStatus &status)
+{
+  if (config.stackPrefault > 0) {
+    status.requested[RT_STACK_PREFAULT] = true;
+    static_cast<void>(touchStack(config.stackPrefault));
+    setResult(status, RT_STACK_PREFAULT, config.stackPrefault <= MAX_STACK_PREFAULT, EINVAL);
+  }
+
+  if (config.cpu >= 0) {
+    status.requested[RT_AFFINITY] = true;
+    int32_t error{EINVAL};
+    bool pinned{false};
+    if (config.cpu < CPU_SETSIZE) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(static_cast<size_t>(config.cpu), &cpus);
+      error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      // Read back, a cpuset of the container may still override it
+      cpu_set_t actual;
+      CPU_ZERO(&actual);
+      pinned = error == 0 && pthread_getaffinity_np(pthread_self(), sizeof(actual), &actual) == 0
+        && CPU_COUNT(&actual) == 1 && CPU_ISSET(static_cast<size_t>(config.cpu), &actual);
+    }
+    setResult(status, RT_AFFINITY, pinned, error);
+  }
+
+  if (config.priority > 0) {
+    status.requested[RT_SCHEDULING] = true;
+    sched_param parameters;
+    std::memset(&parameters, 0, sizeof(parameters));
+    parameters.sched_priority = config.priority;
+    const int32_t error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+    int32_t policy{0};
+    const bool scheduled = error == 0 && pthread_getschedparam(pthread_self(), &policy, &parameters) == 0
+      && policy == SCHED_FIFO && parameters.sched_priority == config.priority;
+    setResult(status, RT_SCHEDULING, scheduled, error);
+  }
+}
+
+std::string realtimeReport(const RealtimeStatus &status)
+{
+  std::ostringstream report;
+  for (uint32_t i = 0; i < RT_SETTINGS; i++) {
+    if (!status.requested[i]) {
+      continue;
+    }
+    report << realtimeSettingName(static_cast<RealtimeSetting>(i)) << ": ";
+    if (status.applied[i]) {
+      report << "applied\n";
+    } else {
+      report << "not applied (" << std::strerror(status.error[i]) << ")\n";
+    }
+  }
+  return report.str();
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+// Real-time execution profile for the control thread. Memory is locked and
+// prefaulted once for the process, then the control thread is pinned to a
+// CPU and moved to SCHED_FIFO. Every setting is read back from the kernel
+// after it was made, failures (typically missing CAP_SYS_NICE or
+// CAP_IPC_LOCK) leave the default and are reported, they do not stop the
+// service.
+
+enum RealtimeSetting : uint8_t {
+  RT_MEMORY_LOCK,
+  RT_HEAP_PREFAULT,
+  RT_STACK_PREFAULT,
+  RT_AFFINITY,
+  RT_SCHEDULING,
+  RT_SETTINGS
+};
+
+struct RealtimeConfig {
+  int32_t priority;            // SCHED_FIFO priority 1 to 99, 0 keeps the default scheduling
+  int32_t cpu;                 // Negative leaves the thread on all CPUs
+  bool lockMemory;             // Current and future pages
+  uint32_t heapPrefault;       // Heap kept resident for the process [bytes]
+  uint32_t stackPrefault;      // Stack touched on the control thread [bytes]
+};
+
+struct RealtimeStatus {
+  std::array<bool, RT_SETTINGS> requested;
+  std::array<bool, RT_SETTINGS> applied;
+  std::array<int32_t, RT_SETTINGS> error;   // errno of a failed setting
+};
+
+RealtimeConfig defaultRealtimeConfig();
+RealtimeStatus initialRealtimeStatus();
+const char *realtimeSettingName(RealtimeSetting setting);
+
+// Memory locking and heap prefaulting, best before further threads start
+void setUpRealtimeProcess(const RealtimeConfig &config, RealtimeStatus &status);
+// Stack prefaulting, CPU affinity and scheduling of the calling thread
+void setUpRealtimeThread(const RealtimeConfig &config, RealtimeStatus &status);
+// One line per requested setting
+std::string realtimeReport(const RealtimeStatus &status);
+
+// Calls cycle() at the given frequency until it returns false, on absolute
+// deadlines so that the period does not drift with the cycle time. After an
+// overrun of more than a period, the missed cycles are skipped.
+template <typename F>
+uint64_t runAtFrequency(float freq, F &&cycle)
+{
+  const int64_t period = static_cast<int64_t>(1e9f / freq);
+  timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  uint64_t skipped{0};
+  while (cycle()) {
+    int64_t next = static_cast<int64_t>(deadline.tv_sec) * 1000000000 + deadline.tv_nsec + period;
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t current = static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    if (current - next > period) {
+      skipped += static_cast<uint64_t>((current - next) / period);
+      next = current;
+    }
+    deadline.tv_sec = static_cast<time_t>(next / 1000000000);
+    deadline.tv_nsec = static_cast<long>(next % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) != 0) {
+    }
+  }
+  return skipped;
+}
+#endif
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Reading of one sensor, value[1] is used by sensors sending a pair
+struct TimedSample {
+  int64_t sampleTime;          // [us]
+  int64_t received;            // [us]
+  float value[2];
+};
+
+struct SampleDrain {
+  uint32_t count;              // Samples handed to the visitor
+  uint32_t lost;               // Overwritten before they were drained
+};
+
+// History of the last N samples of one sensor between the receiving thread
+// and step(). Pushing overwrites the oldest sample and never waits; the
+// consumer drains everything pushed since its previous drain in one pass and
+// can look at the newest sample at any time. Meant for one producer per
+// sensor, but a slot is claimed with a fetch-and-add and published through a
+// sequence number of its own, so concurrent producers stay safe. Like
+// SeqLock, the samples are kept in relaxed atomic words.
+template <typename T, uint32_t N>
+class SampleRing {
+  static_assert(std::is_trivially_copyable<T>::value, "SampleRing needs a trivially copyable type");
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SampleRing needs a power of two size");
+
+  public:
+    SampleRing()
+      : m_head{0}
+      , m_tail{0}
+      , m_slots{}
+    {
+    }
+
+    // Copies continue from the samples and drain position of the other ring
+    SampleRing(const SampleRing &other)
+      : m_head{0}
+      , m_tail{0}
+      , m_slots{}
+    {
+      copyFrom(other);
+    }
+
+    SampleRing &operator=(const SampleRing &other)
+    {
+      if (this != &other) {
+        copyFrom(other);
+      }
+      return *this;
+    }
+
+  public:
+    void push(const T &sample)
+    {
+      Words words{};
+      std::memcpy(words.data(), &sample, sizeof(T));
+      const uint64_t position = m_head.fetch_add(1, std::memory_order_acq_rel);
+      Slot &slot = m_slots[position & MASK];
+      slot.sequence.store(0, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < WORDS; i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+      }
+      slot.sequence.store(position + 1, std::memory_order_release);
+    }
+
+    // Newest published sample, false before the first one
+    bool latest(T &sample) const
+    {
+      uint64_t head = m_head.load(std::memory_order_acquire);
+      while (head > 0) {
+        // A producer may have claimed the newest slot and not yet filled it
+        for (uint64_t position = head; position > 0 && head - position < N; position--) {
+          if (read(position - 1, sample)) {
+            return true;
+          }
+        }
+        head = m_head.load(std::memory_order_acquire);
+      }
+      return false;
+    }
+
+    // Hands every sample since the previous drain to visit, oldest first.
+    // Only from the consuming thread.
+    template <typename F>
+    SampleDrain drain(F &&visit)
+    {
+      SampleDrain result{0, 0};
+      const uint64_t head = m_head.load(std::memory_order_acquire);
+      if (head - m_tail > N) {
+        result.lost += static_cast<uint32_t>(head - N - m_tail);
+        m_tail = head - N;
+      }
+      T sample;
+      while (m_tail != head) {
+        const uint64_t sequence = m_slots[m_tail & MASK].sequence.load(std::memory_order_acquire);
+        if (sequence != m_tail + 1 && sequence <= m_tail) {
+          // Claimed but not yet published, picked up by the next drain
+          break;
+        }
+        if (read(m_tail, sample)) {
+          visit(static_cast<const T &>(sample));
+          result.count++;
+        } else {
+          result.lost++;
+        }
+        m_tail++;
+      }
+      return result;
+    }
+
+    // Samples pushed since construction
+    uint64_t pushed() const
+    {
+      return m_head.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr uint64_t MASK = N - 1;
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    using Words = std::array<uint64_t, WORDS>;
+
+    struct Slot {
+      std::atomic<uint64_t> sequence;  // Position + 1 once published, 0 while written
+      std::array<std::atomic<uint64_t>, WORDS> words;
+    };
+
+    // False if the slot holds another position or was overwritten meanwhile
+    bool read(uint64_t position, T &sample) const
+    {
+      const Slot &slot = m_slots[position & MASK];
+      const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+      if (before != position + 1) {
+        return false;
+      }
+      Words words;
+      for (size_t i = 0; i < WORDS; i++) {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != before) {
+        return false;
+      }
+      std::memcpy(&sample, words.data(), sizeof(T));
+      return true;
+    }
+
+    void copyFrom(const SampleRing &other)
+    {
+      m_head.store(other.m_head.load(std::memory_order_acquire), std::memory_order_relaxed);
+      m_tail = other.m_tail;
+      for (uint32_t i = 0; i < N; i++) {
+        m_slots[i].sequence.store(other.m_slots[i].sequence.load(std::memory_order_acquire), std::memory_order_relaxed);
+        for (size_t w = 0; w < WORDS; w++) {
+          m_slots[i].words[w].store(other.m_slots[i].words[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+      }
+    }
+
+  private:
+    std::atomic<uint64_t> m_head;  // Next position to claim
+    uint64_t m_tail;               // Next position to drain
+    std::array<Slot, N> m_slots;
+};
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <type_traits>
+
+// Sequence lock for a small, trivially copyable value. Readers never block
+// writers and retry only if a write overlapped their copy. Writers take
+// ownership with a single compare-and-swap on the sequence, so concurrent
+// writers only ever wait for each other for the duration of one update.
+// The value is kept in relaxed atomic words to keep the data race defined.
+// A thread that must never wait for a writer it may have preempted, such as
+// a SCHED_FIFO thread sharing its CPU with the writers, uses tryLoad() and
+// tryUpdate() with a bounded number of attempts instead.
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+  public:
+    SeqLock()
+      : m_sequence{0}
+      , m_words{}
+    {
+      store(T{});
+    }
+
+    // Copies take a consistent snapshot of the other value
+    SeqLock(const SeqLock &other)
+      : m_sequence{0}
+      , m_words{}
+    {
+      store(other.load());
+    }
+
+    SeqLock &operator=(const SeqLock &other)
+    {
+      if (this != &other) {
+        store(other.load());
+      }
+      return *this;
+    }
+
+  public:
+    T load() const
+    {
+      T value;
+      tryLoad(value, UNBOUNDED);
+      return value;
+    }
+
+    // False, with value untouched, if writes overlapped every one of the
+    // attempts
+    bool tryLoad(T &value, uint32_t attempts) const
+    {
+      Words words{};
+      for (uint32_t attempt = 0; attempts == UNBOUNDED || attempt < attempts; attempt++) {
+        const uint32_t before = m_sequence.load(std::memory_order_acquire);
+        for (size_t i = 0; i < WORDS; i++) {
+          words[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint32_t after = m_sequence.load(std::memory_order_relaxed);
+        if (!(before & 1u) && before == after) {
+          value = unpack(words);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void store(const T &value)
+    {
+      update([&value](T &current) { current = value; });
+    }
+
+    // Read-modify-write, e.g. to change a single member of T
+    template <typename F>
+    void update(F &&modify)
+    {
+      tryUpdate(std::forward<F>(modify), UNBOUNDED);
+    }
+
+    // False, without calling modify, if another writer held the value for
+    // all of the attempts
+    template <typename F>
+    bool tryUpdate(F &&modify, uint32_t attempts)
+    {
+      uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+      for (uint32_t attempt = 1; (sequence & 1u) || !m_sequence.compare_exchange_weak(sequence, sequence + 1,
+            std::memory_order_acquire, std::memory_order_relaxed); attempt++) {
+        if (attempts != UNBOUNDED && attempt >= attempts) {
+          return false;
+        }
+        // Lets a writer preempted on this CPU finish
+        if (attempt % SPINS == 0) {
+          std::this_thread::yield();
+        }
+        sequence = m_sequence.load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_release);
+
+      Words words{};
+      for (size_t i = 0; i < WORDS; i++) {
+        words[i] = m_words[i].load(std::memory_order_relaxed);
+      }
+      T value = unpack(words);
+      modify(value);
+      std::memcpy(words.data(), &value, sizeof(T));
+      for (size_t i = 0; i < WORDS; i++) {
+        m_words[i].store(words[i], std::memory_order_relaxed);
+      }
+
+      m_sequence.store(sequence + 2, std::memory_order_release);
+      return true;
+    }
+
+    static constexpr uint32_t UNBOUNDED = std::numeric_limits<uint32_t>::max();
+
+  private:
+    static constexpr uint32_t SPINS = 64;
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    using Words = std::array<uint64_t, WORDS>;
+
+    static T unpack(const Words &words)
+    {
+      T value;
+      std::memcpy(&value, words.data(), sizeof(T));
+      return value;
+    }
+
+  private:
+    std::atomic<uint32_t> m_sequence;
+    std::array<std::atomic<uint64_t>, WORDS> m_words;
+};
+#endif
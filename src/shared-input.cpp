@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shared-input.hpp"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <new>
+
+namespace {
+
+const size_t ALIGNMENT{64};
+const size_t WORDS{sizeof(SharedInputRecord) / sizeof(uint64_t)};
+
+size_t headerSize()
+{
+  return (sizeof(SharedInputHeader) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+size_t segmentSize(uint32_t capacity)
+{
+  return ALIGNMENT + headerSize() + capacity * sizeof(SharedInputSlot);
+}
+
+// The user area of cluon::SharedMemory follows its own header, the ring
+// starts at the next cache line in every process that maps it
+char *alignedStart(char *data)
+{
+  const uintptr_t address = reinterpret_cast<uintptr_t>(data);
+  return data + (ALIGNMENT - address % ALIGNMENT) % ALIGNMENT;
+}
+
+// Shared between processes, so not FUTEX_PRIVATE_FLAG
+void futexWait(std::atomic<uint32_t> &word, uint32_t expected, int64_t timeout)
+{
+  timespec relative;
+  relative.tv_sec = static_cast<time_t>(timeout / 1000000);
+  relative.tv_nsec = static_cast<long>(timeout % 1000000 * 1000);
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, &relative, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t> &word)
+{
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+int64_t now()
+{
+  return cluon::time::toMicroseconds(cluon::time::now());
+}
+
+uint32_t roundUpToPowerOfTwo(uint32_t value)
+{
+  uint32_t result{1};
+  while (result < value && result < (1u << 31)) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}
+
+SharedInputWriter::SharedInputWriter(const std::string &name)
+  : m_memory{new cluon::SharedMemory(name)}
+  , m_header{nullptr}
+  , m_slots{nullptr}
+  , m_mask{0}
+{
+  if (!m_memory->valid() || m_memory->size() < segmentSize(0)) {
+    return;
+  }
+  char *start = alignedStart(m_memory->data());
+  SharedInputHeader *header = reinterpret_cast<SharedInputHeader *>(start);
+  const uint32_t capacity = header->capacity;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header->magic != SHARED_INPUT_MAGIC || header->version != SHARED_INPUT_VERSION
+      || capacity == 0 || (capacity & (capacity - 1)) != 0 || m_memory->size() < segmentSize(capacity)) {
+    return;
+  }
+  m_header = header;
+  m_slots = reinterpret_cast<SharedInputSlot *>(start + headerSize());
+  m_mask = capacity - 1;
+}
+
+bool SharedInputWriter::isOpen() const
+{
+  return m_header != nullptr;
+}
+
+void SharedInputWriter::write(const SharedInputRecord &record)
+{
+  if (m_header == nullptr) {
+    return;
+  }
+  SharedInputRecord stamped = record;
+  if (stamped.written == 0) {
+    stamped.written = now();
+  }
+  std::array<uint64_t, WORDS> words;
+  std::memcpy(words.data(), &stamped, sizeof(stamped));
+
+  const uint64_t position = m_header->head.fetch_add(1, std::memory_order_acq_rel);
+  SharedInputSlot &slot = m_slots[position & m_mask];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < WORDS; i++) {
+    slot.words[i].store(words[i], std::memory_order_relaxed);
+  }
+  slot.sequence.store(position + 1, std::memory_order_release);
+
+  // Pairs with the reader announcing itself before it checks published
+  m_header->published.fetch_add(1, std::memory_order_seq_cst);
+  if (m_header->waiting.load(std::memory_order_seq_cst) > 0) {
+    futexWake(m_header->published);
+  }
+}
+
+SharedInputReader::SharedInputReader(const std::string &name, uint32_t capacity)
+  : m_memory{nullptr}
+  , m_header{nullptr}
+  , m_slots{nullptr}
+  , m_mask{0}
+  , m_position{0}
+  , m_holePosition{UINT64_MAX}
+  , m_holeSince{0}
+  , m_received{0}
+  , m_lost{0}
+{
+  const uint32_t slots = roundUpToPowerOfTwo(capacity);
+  m_memory.reset(new cluon::SharedMemory(name, static_cast<uint32_t>(segmentSize(slots))));
+  if (!m_memory->valid() || m_memory->size() < segmentSize(slots)) {
+    return;
+  }
+  char *start = alignedStart(m_memory->data());
+  SharedInputHeader *header = new (start) SharedInputHeader();
+  SharedInputSlot *ring = reinterpret_cast<SharedInputSlot *>(start + headerSize());
+  for (uint32_t i = 0; i < slots; i++) {
+    new (&ring[i]) SharedInputSlot();
+  }
+  header->version = SHARED_INPUT_VERSION;
+  header->capacity = slots;
+  // Writers only attach once everything above is in place
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = SHARED_INPUT_MAGIC;
+
+  m_header = header;
+  m_slots = ring;
+  m_mask = slots - 1;
+}
+
+bool SharedInputReader::isOpen() const
+{
+  return m_header != nullptr;
+}
+
+uint32_t SharedInputReader::read(SharedInputRecord *records, uint32_t max, int64_t timeout)
+{
+  if (m_header == nullptr || max == 0) {
+    return 0;
+  }
+  const uint32_t seen = m_header->published.load(std::memory_order_acquire);
+  uint32_t count = drain(records, max);
+  if (count == 0 && timeout > 0) {
+    // Only until a hole times out if records wait behind one
+    const int64_t wait = (m_holePosition == m_position) ? std::min(timeout, SHARED_INPUT_HOLE_TIMEOUT) : timeout;
+    m_header->waiting.fetch_add(1, std::memory_order_seq_cst);
+    if (m_header->published.load(std::memory_order_seq_cst) == seen) {
+      futexWait(m_header->published, seen, wait);
+    }
+    m_header->waiting.fetch_sub(1, std::memory_order_relaxed);
+    count = drain(records, max);
+  }
+  m_received.fetch_add(count, std::memory_order_relaxed);
+  return count;
+}
+
+uint64_t SharedInputReader::received() const
+{
+  return m_received.load(std::memory_order_relaxed);
+}
+
+uint64_t SharedInputReader::lost() const
+{
+  return m_lost.load(std::memory_order_relaxed);
+}
+
+void SharedInputReader::wake()
+{
+  if (m_header != nullptr) {
+    m_header->published.fetch_add(1, std::memory_order_seq_cst);
+    futexWake(m_header->published);
+  }
+}
+
+bool SharedInputReader::publishedAfter(uint64_t head) const
+{
+  for (uint64_t position = m_position + 1; position < head; position++) {
+    if (m_slots[position & m_mask].sequence.load(std::memory_order_acquire) >= position + 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t SharedInputReader::drain(SharedInputRecord *records, uint32_t max)
+{
+  uint32_t count{0};
+  uint64_t lost{0};
+  while (count < max) {
+    const uint64_t head = m_header->head.load(std::memory_order_acquire);
+    if (m_position == head) {
+      break;
+    }
+    // Writers went round the ring since the last read
+    if (head - m_position > m_mask + 1) {
+      lost += head - (m_mask + 1) - m_position;
+      m_position = head - (m_mask + 1);
+    }
+
+    const SharedInputSlot &slot = m_slots[m_position & m_mask];
+    const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+    if (before != m_position + 1) {
+      if (before > m_position + 1) {
+        lost++;
+        m_position++;
+        continue;
+      }
+      // Claimed but not yet published, records behind it wait for it until
+      // the hole times out
+      if (!publishedAfter(head)) {
+        break;
+      }
+      const int64_t time = now();
+      if (m_holePosition != m_position) {
+        m_holePosition = m_position;
+        m_holeSince = time;
+      }
+      if (time - m_holeSince < SHARED_INPUT_HOLE_TIMEOUT) {
+        break;
+      }
+      lost++;
+      m_position++;
+      continue;
+    }
+    std::array<uint64_t, WORDS> words;
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == before) {
+      std::memcpy(&records[count], words.data(), sizeof(SharedInputRecord));
+      count++;
+    } else {
+      lost++;
+    }
+    m_position++;
+  }
+  if (lost > 0) {
+    m_lost.fetch_add(lost, std::memory_order_relaxed);
+  }
+  return count;
+}
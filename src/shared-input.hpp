@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARED_INPUT_H
+#define SHARED_INPUT_H
+
+#include "cluon-complete.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Input channel for producers on the same machine, in place of UDP
+// multicast. The controller creates a cluon::SharedMemory segment holding a
+// ring of fixed-layout records; any number of producer processes attach to
+// it and write without locks. A record is claimed with one fetch-and-add,
+// filled and published through a sequence number per slot, the reader checks
+// that sequence around its copy and skips records that were overwritten
+// before it got to them. A reader with nothing to read sleeps on a futex in
+// the segment, which producers only touch when someone is waiting. A record
+// claimed but not published while later ones are, e.g. by a producer that
+// died in the middle of its write, holds the reader up for
+// SHARED_INPUT_HOLE_TIMEOUT at most and is then counted as lost.
+
+enum class SharedInputKind : uint32_t {
+  LeftWheelSpeed,              // value[0] [m/s]
+  RightWheelSpeed,             // value[0] [m/s]
+  RearWheelSpeeds,             // value[0] left, value[1] right [m/s]
+  SpeedRequest                 // value[0] [m/s]
+};
+
+struct SharedInputRecord {
+  int64_t sampleTime;          // [us]
+  int64_t written;             // Set by the producer [us]
+  float value[2];
+  SharedInputKind kind;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(SharedInputRecord) == 32, "SharedInputRecord is the layout shared with producers");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+    "Atomics in shared memory need to be lock-free");
+
+const uint32_t SHARED_INPUT_MAGIC{0x4e494d53}; // "SMIN"
+const uint32_t SHARED_INPUT_VERSION{1};
+const int64_t SHARED_INPUT_HOLE_TIMEOUT{200};  // [us], far above the time a write takes
+
+// In the segment, after the header of cluon::SharedMemory
+struct SharedInputSlot {
+  std::atomic<uint64_t> sequence;  // Position + 1 once published, 0 while written
+  std::array<std::atomic<uint64_t>, sizeof(SharedInputRecord) / sizeof(uint64_t)> words;
+};
+
+struct SharedInputHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t reserved;
+  std::atomic<uint64_t> head;      // Next position to claim
+  std::atomic<uint32_t> published; // Futex word, counts published records
+  std::atomic<uint32_t> waiting;   // Readers asleep on published
+};
+
+// Producer side, attaches to the segment of a running controller
+class SharedInputWriter {
+  public:
+    explicit SharedInputWriter(const std::string &name);
+    SharedInputWriter(const SharedInputWriter &) = delete;
+    SharedInputWriter &operator=(const SharedInputWriter &) = delete;
+
+  public:
+    bool isOpen() const;
+    // Never blocks; written is stamped with the current time if zero
+    void write(const SharedInputRecord &record);
+
+  private:
+    std::unique_ptr<cluon::SharedMemory> m_memory;
+    SharedInputHeader *m_header;
+    SharedInputSlot *m_slots;
+    uint64_t m_mask;
+};
+
+// Consumer side, owns the segment. One reader per segment.
+class SharedInputReader {
+  public:
+    // Capacity is rounded up to a power of two
+    SharedInputReader(const std::string &name, uint32_t capacity);
+    SharedInputReader(const SharedInputReader &) = delete;
+    SharedInputReader &operator=(const SharedInputReader &) = delete;
+
+  public:
+    bool isOpen() const;
+    // Copies at most max records written since the last call, oldest first.
+    // Without any, sleeps up to timeout [us] for the next one.
+    uint32_t read(SharedInputRecord *records, uint32_t max, int64_t timeout);
+    uint64_t received() const;
+    // Overwritten before they were read, or never published
+    uint64_t lost() const;
+    // Wakes a read() that is sleeping, e.g. to stop
+    void wake();
+
+  private:
+    uint32_t drain(SharedInputRecord *records, uint32_t max);
+    // Whether a record after the current position was published
+    bool publishedAfter(uint64_t head) const;
+
+  private:
+    std::unique_ptr<cluon::SharedMemory> m_memory;
+    SharedInputHeader *m_header;
+    SharedInputSlot *m_slots;
+    uint64_t m_mask;
+    uint64_t m_position;
+    uint64_t m_holePosition;     // Unpublished record later ones wait for
+    int64_t m_holeSince;         // [us]
+    std::atomic<uint64_t> m_received;
+    std::atomic<uint64_t> m_lost;
+};
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "speed-estimator.hpp"
+
+#include <cmath>
+
+EstimatorConfig defaultEstimatorConfig()
+{
+  EstimatorConfig config;
+  config.outlierThreshold = 1.0f;
+  config.outlierRatio = 0.1f;
+  config.correctionTime = 0.05f;
+  config.maxPredictionTime = 0.5f;
+  config.averageSamples = true;
+  return config;
+}
+
+EstimatorState initialEstimatorState()
+{
+  EstimatorState state;
+  state.speed = 0.0f;
+  state.timeWithoutMeasurement = 0.0f;
+  state.initialized = 0;
+  return state;
+}
+
+namespace {
+
+// Median of the available measurements, used as reference before there is a
+// prediction to compare against
+float medianOf(const SpeedMeasurements &measurements)
+{
+  std::array<float, SPEED_SOURCES> values;
+  uint32_t count{0};
+  for (uint32_t i = 0; i < SPEED_SOURCES; i++) {
+    if (measurements.available & (1u << i)) {
+      values[count++] = measurements.speed[i];
+    }
+  }
+  // Insertion sort, there are at most five values
+  for (uint32_t i = 1; i < count; i++) {
+    const float value = values[i];
+    uint32_t j = i;
+    while (j > 0 && values[j - 1] > value) {
+      values[j] = values[j - 1];
+      j--;
+    }
+    values[j] = value;
+  }
+  if (count % 2 == 1) {
+    return values[count / 2];
+  }
+  return 0.5f * (values[count / 2 - 1] + values[count / 2]);
+}
+
+}
+
+SpeedEstimate estimatorUpdate(const EstimatorConfig &config, EstimatorState &state,
+    const SpeedMeasurements &measurements, float dt)
+{
+  SpeedEstimate estimate{state.speed, false, 0};
+  if (measurements.available == 0 && !state.initialized) {
+    return estimate;
+  }
+
+  // Predict with the IMU, hold the last estimate without it
+  const float acceleration = measurements.accelerationAvailable ? measurements.acceleration : 0.0f;
+  const float predicted = state.initialized ? state.speed + acceleration * dt : medianOf(measurements);
+
+  // Reject measurements deviating from the prediction, a wheel spinning up
+  // under traction or locking under braking
+  const float threshold = config.outlierThreshold + config.outlierRatio * std::fabs(predicted);
+  float sum{0.0f};
+  uint32_t count{0};
+  for (uint32_t i = 0; i < SPEED_SOURCES; i++) {
+    const uint32_t use = ((measurements.available >> i) & 1u)
+      & static_cast<uint32_t>(std::fabs(measurements.speed[i] - predicted) <= threshold);
+    sum += use ? measurements.speed[i] : 0.0f;
+    count += use;
+    estimate.used |= use << i;
+  }
+
+  if (count > 0) {
+    const float measured = sum / static_cast<float>(count);
+    const float gain = state.initialized ? dt / (config.correctionTime + dt) : 1.0f;
+    state.speed = predicted + gain * (measured - predicted);
+    state.timeWithoutMeasurement = 0.0f;
+    state.initialized = 1;
+  } else {
+    state.speed = predicted;
+    state.timeWithoutMeasurement += dt;
+    // Start over from the measurements once the prediction is no longer trusted
+    if (state.timeWithoutMeasurement > config.maxPredictionTime) {
+      state.initialized = 0;
+    }
+  }
+
+  estimate.speed = state.speed;
+  estimate.valid = state.initialized && state.timeWithoutMeasurement <= config.maxPredictionTime;
+  return estimate;
+}
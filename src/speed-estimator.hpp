@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPEED_ESTIMATOR_H
+#define SPEED_ESTIMATOR_H
+
+#include <array>
+#include <cstdint>
+
+// Vehicle speed estimate from the four wheel speeds, an optional external
+// ground speed and the longitudinal acceleration of the IMU. The IMU drives
+// the prediction, speed measurements that deviate too far from it (a spinning
+// or locked wheel) are rejected and the rest corrects it through a
+// complementary filter. Runs in constant time; all state is plain data.
+
+enum SpeedSource : uint8_t {
+  FRONT_LEFT = 0,
+  FRONT_RIGHT,
+  REAR_LEFT,
+  REAR_RIGHT,
+  GROUND_SPEED,
+  SPEED_SOURCES
+};
+
+struct SpeedMeasurements {
+  std::array<float, SPEED_SOURCES> speed;  // [m/s]
+  uint32_t available;                      // Bit mask over SpeedSource
+  float acceleration;                      // Longitudinal [m/s^2]
+  uint32_t accelerationAvailable;
+};
+
+struct EstimatorConfig {
+  float outlierThreshold;       // Allowed deviation from the prediction [m/s]
+  float outlierRatio;           // Additional allowed deviation relative to speed
+  float correctionTime;         // Time constant of the measurement correction [s]
+  float maxPredictionTime;      // Estimate becomes invalid without measurements [s]
+  bool averageSamples;          // Wheel speeds are the mean of the samples since the last update, not the latest
+};
+
+struct EstimatorState {
+  float speed;
+  float timeWithoutMeasurement;
+  uint32_t initialized;
+};
+
+struct SpeedEstimate {
+  float speed;
+  bool valid;
+  uint32_t used;                // Bit mask of measurements used in this update
+};
+
+EstimatorConfig defaultEstimatorConfig();
+EstimatorState initialEstimatorState();
+
+SpeedEstimate estimatorUpdate(const EstimatorConfig &config, EstimatorState &state,
+    const SpeedMeasurements &measurements, float dt);
+#endif
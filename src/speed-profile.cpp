@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "speed-profile.hpp"
+
+std::vector<ProfilePoint> syntheticProfile(const std::string &name)
+{
+  std::vector<ProfilePoint> profile;
+  if (name == "acceleration") {
+    // Standing start, full request for the 75 m acceleration event
+    profile.push_back({0.0f, 0.0f});
+    profile.push_back({1.0f, 25.0f});
+    profile.push_back({8.0f, 25.0f});
+  } else {
+    // Endurance-like speed steps between corners and straights
+    const float speeds[] = {8.0f, 14.0f, 6.0f, 12.0f, 10.0f, 16.0f, 5.0f, 11.0f};
+    float time = 0.0f;
+    profile.push_back({time, 0.0f});
+    for (int32_t lap = 0; lap < 3; lap++) {
+      for (float speed : speeds) {
+        time += 1.0f;
+        profile.push_back({time, speed});
+        time += 3.0f;
+        profile.push_back({time, speed});
+      }
+    }
+  }
+  return profile;
+}
+
+std::vector<ProfilePoint> recordedProfile(const std::string &file)
+{
+  std::vector<ProfilePoint> profile;
+  cluon::Player player(file, false, false);
+  int64_t start{0};
+  while (player.hasMoreData()) {
+    auto next = player.getNextEnvelopeToBeReplayed();
+    if (next.first && next.second.dataType() == opendlv::proxy::GroundSpeedRequest::ID()
+        && next.second.senderStamp() == 1500) {
+      const int64_t sampleTime = cluon::time::toMicroseconds(next.second.sampleTimeStamp());
+      if (start == 0) {
+        start = sampleTime;
+      }
+      auto gsr = cluon::extractMessage<opendlv::proxy::GroundSpeedRequest>(std::move(next.second));
+      profile.push_back({static_cast<float>(sampleTime - start) * 1e-6f, gsr.groundSpeed()});
+    }
+  }
+  return profile;
+}
+
+float profileSpeedAt(const std::vector<ProfilePoint> &profile, float time, size_t &segment)
+{
+  if (profile.empty()) {
+    return 0.0f;
+  }
+  while (segment + 1 < profile.size() && profile[segment + 1].time <= time) {
+    segment++;
+  }
+  float request = profile[segment].speedRequest;
+  if (segment + 1 < profile.size() && time > profile[segment].time) {
+    const ProfilePoint &a = profile[segment];
+    const ProfilePoint &b = profile[segment + 1];
+    request = a.speedRequest + (b.speedRequest - a.speedRequest) * (time - a.time) / (b.time - a.time);
+  }
+  return request;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPEED_PROFILE_H
+#define SPEED_PROFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Ground speed request profiles over time that the offline tools drive the
+// controller with, synthetic or taken from a recording.
+
+struct ProfilePoint {
+  float time;          // [s]
+  float speedRequest;  // [m/s]
+};
+
+// "acceleration" is a standing start to 25 m/s, anything else endurance-like
+// speed steps between corners and straights
+std::vector<ProfilePoint> syntheticProfile(const std::string &name);
+// Ground speed requests with senderStamp 1500, relative to the first one
+std::vector<ProfilePoint> recordedProfile(const std::string &file);
+
+// Linear interpolation of the profile, constant after the last point. The
+// segment is advanced in place, so stepping forward in time stays O(1).
+float profileSpeedAt(const std::vector<ProfilePoint> &profile, float time, size_t &segment);
+#endif
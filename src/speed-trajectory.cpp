@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "speed-trajectory.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+TrajectoryConfig defaultTrajectoryConfig()
+{
+  TrajectoryConfig config;
+  config.enabled = true;
+  config.maxInterval = 0.2f;
+  config.maxAcceleration = 15.0f;
+  config.maxDeceleration = 15.0f;
+  config.lateralAccelerationLimit = 0.0f;
+  config.previewTimeout = 0.5f;
+  return config;
+}
+
+TrajectoryState initialTrajectoryState()
+{
+  TrajectoryState state;
+  state.sinceRequest = 0.0f;
+  state.segmentElapsed = 0.0f;
+  state.segmentDuration = 0.0f;
+  state.segmentStartSpeed = 0.0f;
+  state.segmentEndSpeed = 0.0f;
+  state.reference = 0.0f;
+  state.acceleration = 0.0f;
+  state.initialized = 0;
+  return state;
+}
+
+float previewCurvature(float azimuthAngle, float distance)
+{
+  // Pure pursuit arc through the point
+  return (distance > 0.0f) ? 2.0f * std::sin(azimuthAngle) / distance : 0.0f;
+}
+
+float trajectoryUpdate(const TrajectoryConfig &config, TrajectoryState &state,
+    const TrajectoryInputs &inputs, float dt)
+{
+  if (!config.enabled) {
+    const float previous = state.reference;
+    // The request as is, accelerating by its change since the last step
+    state.reference = inputs.speedRequest;
+    state.acceleration = (state.initialized && dt > 0.0f) ? (state.reference - previous) / dt : 0.0f;
+    state.initialized = 1;
+    return state.reference;
+  }
+
+  // Intervals only matter up to maxInterval, which keeps the times bounded
+  state.sinceRequest = std::min(state.sinceRequest + dt, config.maxInterval);
+  state.segmentElapsed = std::min(state.segmentElapsed + dt, state.segmentDuration);
+  if (!state.initialized) {
+    state.reference = inputs.vehicleSpeed;
+    state.segmentEndSpeed = inputs.vehicleSpeed;
+    state.sinceRequest = 0.0f;
+    state.initialized = 1;
+  }
+  const float previous = state.reference;
+  if (inputs.newRequest) {
+    state.segmentDuration = std::max(state.sinceRequest, dt);
+    state.segmentElapsed = dt;
+    state.segmentStartSpeed = state.reference;
+    state.segmentEndSpeed = inputs.speedRequest;
+    state.sinceRequest = 0.0f;
+  }
+
+  const float progress = (state.segmentDuration > 0.0f) ?
+    std::min(state.segmentElapsed / state.segmentDuration, 1.0f) : 1.0f;
+  float target = state.segmentStartSpeed + (state.segmentEndSpeed - state.segmentStartSpeed) * progress;
+
+  // Slow down ahead of the corner instead of in it
+  if (config.lateralAccelerationLimit > 0.0f && inputs.previewValid
+      && std::fabs(inputs.previewCurvature) > 0.0f) {
+    target = std::min(target, std::sqrt(config.lateralAccelerationLimit / std::fabs(inputs.previewCurvature)));
+  }
+
+  if (dt > 0.0f) {
+    const float change = std::min(std::max(target - previous, -config.maxDeceleration * dt),
+        config.maxAcceleration * dt);
+    state.reference = previous + change;
+    state.acceleration = change / dt;
+  } else {
+    // Without a sample time there is nothing to shape
+    state.reference = target;
+    state.acceleration = 0.0f;
+  }
+  return state.reference;
+}
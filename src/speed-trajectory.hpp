@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPEED_TRAJECTORY_H
+#define SPEED_TRAJECTORY_H
+
+#include <cstdint>
+
+// Turns the sparse ground speed requests into a reference trajectory at the
+// control rate. A new request starts a linear segment from the current
+// reference that reaches it after the interval seen between the last two
+// requests, so a step in the request becomes a ramp with a known slope. The
+// slope is the acceleration for the feed-forward term. An optional preview
+// point ahead on the path caps the reference to the speed its curvature
+// allows. Time is counted in control steps, which keeps replays and
+// simulations faster than real time consistent.
+
+struct TrajectoryConfig {
+  bool enabled;                // Otherwise the requests pass through unchanged
+  float maxInterval;           // Longest ramp for a new request [s]
+  float maxAcceleration;       // [m/s^2]
+  float maxDeceleration;       // [m/s^2]
+  float lateralAccelerationLimit;  // For the preview speed cap, 0 disables it [m/s^2]
+  float previewTimeout;        // Preview points older than this are ignored [s]
+};
+
+struct TrajectoryState {
+  float sinceRequest;          // Control time since the last new request [s]
+  float segmentElapsed;        // [s]
+  float segmentDuration;       // [s]
+  float segmentStartSpeed;
+  float segmentEndSpeed;
+  float reference;             // [m/s]
+  float acceleration;          // [m/s^2]
+  uint32_t initialized;
+};
+
+struct TrajectoryInputs {
+  float speedRequest;
+  bool newRequest;             // First step that sees this request
+  float vehicleSpeed;          // Starting point of the first segment
+  float previewCurvature;      // Of the path to the preview point [1/m]
+  bool previewValid;
+};
+
+TrajectoryConfig defaultTrajectoryConfig();
+TrajectoryState initialTrajectoryState();
+
+// Curvature of the arc from the vehicle through a preview point at the given
+// azimuth [rad] and distance [m]
+float previewCurvature(float azimuthAngle, float distance);
+
+// Advances the trajectory by dt [s] and returns the reference speed,
+// state.acceleration holds the matching acceleration
+float trajectoryUpdate(const TrajectoryConfig &config, TrajectoryState &state,
+    const TrajectoryInputs &inputs, float dt);
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "torque-distribution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+DistributionConfig defaultDistributionConfig()
+{
+  DistributionConfig config;
+  config.rearWheelDrive = true;
+  config.wheelBase = 1.53f;
+  config.trackWidth = 1.2f;
+  config.yawGain = 0.0f;
+  config.slipLimit = 0.15f;
+  config.slipBand = 0.1f;
+  config.slipMinSpeed = 2.0f;
+  config.motorMin = {{-MOTOR_TORQUE_MAX, -MOTOR_TORQUE_MAX}};
+  config.motorMax = {{MOTOR_TORQUE_MAX, MOTOR_TORQUE_MAX}};
+  return config;
+}
+
+DistributionOutput distributeTorque(const DistributionConfig &config, const DistributionInputs &inputs)
+{
+  DistributionOutput output;
+
+  // Kinematic yaw rate target of the steering request, the torque difference
+  // goes to the outer wheel
+  output.yawRateTarget = inputs.vehicleSpeed * std::tan(inputs.steeringAngle) / config.wheelBase;
+  const float yawTorque = config.yawGain * output.yawRateTarget;
+  const WheelPair side{{-0.5f, 0.5f}};
+
+  // Slip only counts with a valid reference, the limiter then scales the
+  // wheel torque down linearly over the slip band
+  const float valid = (inputs.vehicleSpeedValid && inputs.wheelSpeedValid) ? 1.0f : 0.0f;
+  const float reference = std::max(std::fabs(inputs.vehicleSpeed), config.slipMinSpeed);
+  const float direction = (inputs.torque < 0.0f) ? -1.0f : 1.0f;
+
+  for (uint32_t i = 0; i < 2; i++) {
+    const float share = 0.5f * inputs.torque + side[i] * yawTorque;
+    output.slip[i] = valid * (inputs.wheelSpeed[i] - inputs.vehicleSpeed) / reference;
+    const float excess = std::max(direction * output.slip[i] - config.slipLimit, 0.0f);
+    output.slipFactor[i] = std::max(1.0f - excess / config.slipBand, 0.0f);
+    output.torque[i] = std::min(std::max(share * output.slipFactor[i], config.motorMin[i]), config.motorMax[i]);
+  }
+  return output;
+}
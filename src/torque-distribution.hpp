@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TORQUE_DISTRIBUTION_H
+#define TORQUE_DISTRIBUTION_H
+
+#include <array>
+#include <cstdint>
+
+// Splits the total torque request between the left and right motor. A yaw
+// moment proportional to the kinematic yaw rate target of the steering
+// request shifts torque to the outer wheel, a slip limiter cuts the torque of
+// a spinning (or, when braking, locking) driven wheel in the same cycle and
+// every motor is kept within its own limits. Both wheels are computed as one
+// lane pair with the same arithmetic and no data-dependent branches.
+
+using WheelPair = std::array<float, 2>;
+
+const uint32_t LEFT{0};
+const uint32_t RIGHT{1};
+
+// Drivetrain limits of the car per motor, as in the vehicle model
+const float MOTOR_TORQUE_MAX{2100.0f};  // [cNm]
+const float MOTOR_POWER_MAX{40000.0f};  // [W]
+
+struct DistributionConfig {
+  bool rearWheelDrive;         // Slip of the rear instead of the front wheels
+  float wheelBase;             // [m]
+  float trackWidth;            // [m]
+  float yawGain;               // Torque difference per target yaw rate [cNm / (rad/s)]
+  float slipLimit;             // Slip ratio where the limiter starts cutting
+  float slipBand;              // Slip ratio above the limit where the torque is zero
+  float slipMinSpeed;          // Lower bound of the reference speed in the slip ratio [m/s]
+  WheelPair motorMin;          // [cNm]
+  WheelPair motorMax;          // [cNm]
+};
+
+struct DistributionInputs {
+  float torque;                // Total requested torque [cNm]
+  float vehicleSpeed;          // [m/s]
+  bool vehicleSpeedValid;
+  WheelPair wheelSpeed;        // Driven wheels [m/s]
+  bool wheelSpeedValid;
+  float steeringAngle;         // Positive to the left [rad]
+};
+
+struct DistributionOutput {
+  WheelPair torque;            // [cNm]
+  WheelPair slip;
+  WheelPair slipFactor;        // 1 without intervention, 0 at full cut
+  float yawRateTarget;         // [rad/s]
+};
+
+DistributionConfig defaultDistributionConfig();
+
+DistributionOutput distributeTorque(const DistributionConfig &config, const DistributionInputs &inputs);
+#endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "torque-request-sender.hpp"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <ctime>
+#include <string>
+
+namespace {
+
+// Offsets of the field keys within the envelope, see TorqueRequestEnvelope()
+constexpr size_t TORQUE_LEFT{5 + 6 + 2};
+constexpr size_t TORQUE_RIGHT{TORQUE_LEFT + 6};
+constexpr size_t SENT{5 + 6 + 14};
+constexpr size_t SAMPLE_TIME{SENT + 14 + 14};
+
+constexpr int32_t TORQUE_REQUEST_DUAL_ID{2010};
+constexpr uint16_t OD4_PORT{12175};
+
+// Varints always take five bytes, enough for 32 bits, so that the layout
+// does not depend on the values
+size_t writeVarInt(char *out, uint32_t value)
+{
+  for (size_t i = 0; i < 4; i++) {
+    out[i] = static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out[4] = static_cast<char>(value & 0x7f);
+  return 5;
+}
+
+uint32_t zigZag(int32_t value)
+{
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+// Key and varint of an int32 field
+size_t writeInt32Field(char *out, uint32_t id, int32_t value)
+{
+  out[0] = static_cast<char>(id << 3);
+  return 1 + writeVarInt(out + 1, zigZag(value));
+}
+
+// cluon::data::TimeStamp as a nested message
+size_t writeTimeStamp(char *out, uint32_t id, int64_t time)
+{
+  out[0] = static_cast<char>(id << 3 | 2);
+  out[1] = 12;
+  writeInt32Field(out + 2, 1, static_cast<int32_t>(time / 1000000));
+  writeInt32Field(out + 8, 2, static_cast<int32_t>(time % 1000000));
+  return 14;
+}
+
+}
+
+TorqueRequestEnvelope::TorqueRequestEnvelope(uint32_t senderStamp)
+  : m_buffer{}
+{
+  // OD4 header, magic bytes followed by the 24 bit little-endian length
+  const uint32_t length = static_cast<uint32_t>(SIZE - 5);
+  char *out = m_buffer.data();
+  out[0] = static_cast<char>(0x0D);
+  out[1] = static_cast<char>(0xA4);
+  out[2] = static_cast<char>(length & 0xff);
+  out[3] = static_cast<char>((length >> 8) & 0xff);
+  out[4] = static_cast<char>((length >> 16) & 0xff);
+  size_t position = 5;
+
+  position += writeInt32Field(out + position, 1, TORQUE_REQUEST_DUAL_ID);
+  out[position++] = static_cast<char>(2 << 3 | 2);
+  out[position++] = 12;
+  position += writeInt32Field(out + position, 1, 0);
+  position += writeInt32Field(out + position, 2, 0);
+  position += writeTimeStamp(out + position, 3, 0);
+  position += writeTimeStamp(out + position, 4, 0);
+  position += writeTimeStamp(out + position, 5, 0);
+  out[position++] = static_cast<char>(6 << 3);
+  writeVarInt(out + position, senderStamp);
+}
+
+void TorqueRequestEnvelope::encode(int32_t torqueLeft, int32_t torqueRight, int64_t sampleTime, int64_t sent)
+{
+  char *out = m_buffer.data();
+  writeVarInt(out + TORQUE_LEFT + 1, zigZag(torqueLeft));
+  writeVarInt(out + TORQUE_RIGHT + 1, zigZag(torqueRight));
+  writeTimeStamp(out + SENT, 3, sent);
+  writeTimeStamp(out + SAMPLE_TIME, 5, sampleTime);
+}
+
+const char *TorqueRequestEnvelope::data() const
+{
+  return m_buffer.data();
+}
+
+size_t TorqueRequestEnvelope::size() const
+{
+  return SIZE;
+}
+
+TorqueRequestSender::TorqueRequestSender(uint16_t cid, uint32_t senderStamp)
+  : m_socket{::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)}
+  , m_address{}
+  , m_envelope{senderStamp}
+  , m_errors{0}
+{
+  // Same multicast group as cluon::OD4Session
+  const std::string group{"225.0.0." + std::to_string(cid)};
+  std::memset(&m_address, 0, sizeof(m_address));
+  m_address.sin_family = AF_INET;
+  m_address.sin_addr.s_addr = ::inet_addr(group.c_str());
+  m_address.sin_port = htons(OD4_PORT);
+}
+
+TorqueRequestSender::~TorqueRequestSender()
+{
+  if (m_socket >= 0) {
+    ::close(m_socket);
+  }
+}
+
+bool TorqueRequestSender::isOpen() const
+{
+  return m_socket >= 0;
+}
+
+bool TorqueRequestSender::send(int32_t torqueLeft, int32_t torqueRight, int64_t sampleTime)
+{
+  struct timespec now;
+  ::clock_gettime(CLOCK_REALTIME, &now);
+  const int64_t sent = static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+  m_envelope.encode(torqueLeft, torqueRight, sampleTime, sent);
+
+  const ssize_t bytesSent = ::sendto(m_socket, m_envelope.data(), m_envelope.size(), 0,
+      reinterpret_cast<const struct sockaddr *>(&m_address), sizeof(m_address));
+  if (bytesSent != static_cast<ssize_t>(m_envelope.size())) {
+    m_errors++;
+    return false;
+  }
+  return true;
+}
+
+uint64_t TorqueRequestSender::errors() const
+{
+  return m_errors;
+}
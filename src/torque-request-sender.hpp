@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TORQUE_REQUEST_SENDER_H
+#define TORQUE_REQUEST_SENDER_H
+
+#include <netinet/in.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// An OD4 envelope carrying an opendlv.cfsdProxy.TorqueRequestDual, encoded
+// once with fixed-width varints so that every field sits at a constant
+// offset. Each request only patches the torques and the timestamps into the
+// buffer, which a FromProtoVisitor decodes like any other envelope.
+class TorqueRequestEnvelope {
+  public:
+    // Header, dataType, payload, sent, received, sampleTimeStamp, senderStamp
+    static constexpr size_t SIZE{5 + 6 + 14 + 14 + 14 + 14 + 6};
+
+  public:
+    explicit TorqueRequestEnvelope(uint32_t senderStamp);
+
+  public:
+    // Times in microseconds since the epoch
+    void encode(int32_t torqueLeft, int32_t torqueRight, int64_t sampleTime, int64_t sent);
+    const char *data() const;
+    size_t size() const;
+
+  private:
+    std::array<char, SIZE> m_buffer;
+};
+
+// Sends torque requests to an OD4 session without going through
+// cluon::OD4Session::send(), which builds the envelope on the heap and
+// serializes it through string streams. Sending encodes into the
+// preallocated envelope and passes it to sendto(), nothing is allocated.
+// Not thread-safe, owned by the thread running the control loop.
+class TorqueRequestSender {
+  public:
+    TorqueRequestSender(uint16_t cid, uint32_t senderStamp);
+    TorqueRequestSender(const TorqueRequestSender &) = delete;
+    TorqueRequestSender &operator=(const TorqueRequestSender &) = delete;
+    ~TorqueRequestSender();
+
+  public:
+    bool isOpen() const;
+    // Stamped as sent now, the sample time in microseconds since the epoch
+    bool send(int32_t torqueLeft, int32_t torqueRight, int64_t sampleTime);
+    uint64_t errors() const;
+
+  private:
+    int m_socket;
+    struct sockaddr_in m_address;
+    TorqueRequestEnvelope m_envelope;
+    uint64_t m_errors;
+};
+#endif
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "vehicle-model.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const float GRAVITY{9.81f};
+
+// Simulated clock of the closed loop, offset so that no input is stamped zero
+const int64_t START_TIME{1000000};
+
+}
+
+VehicleConfig defaultVehicleConfig()
+{
+  VehicleConfig config;
+  config.rearWheelDrive = true;
+  config.mass = 217.4f;
+  config.wheelRadius = 0.22f;
+  config.gearRatio = 16.0f;
+  config.dragArea = 0.8f;
+  config.rollingResistance = 0.015f;
+  config.drivenAxleLoad = 0.55f;
+  config.loadTransfer = 0.18f;
+  config.motorTorqueMax = 21.0f;
+  config.motorPowerMax = 40000.0f;
+  config.motorTimeConstant = 0.005f;
+  config.wheelInertia = 0.3f;
+  config.slipStiffness = 15.0f;
+  config.friction = 1.5f;
+  config.slipMinSpeed = 1.0f;
+  return config;
+}
+
+VehicleConfig vehicleConfigOf(const MotionParameters &parameters)
+{
+  VehicleConfig config = defaultVehicleConfig();
+  config.rearWheelDrive = parameters.distribution.rearWheelDrive;
+  config.mass = parameters.mass;
+  config.wheelRadius = parameters.wheelRadius;
+  config.gearRatio = parameters.gearRatio;
+  return config;
+}
+
+VehicleState initialVehicleState()
+{
+  VehicleState state;
+  state.time = 0.0f;
+  state.position = 0.0f;
+  state.speed = 0.0f;
+  state.acceleration = 0.0f;
+  state.wheelSpeed = {{0.0f, 0.0f}};
+  state.motorTorque = {{0.0f, 0.0f}};
+  state.slip = {{0.0f, 0.0f}};
+  return state;
+}
+
+void vehicleStep(const VehicleConfig &config, VehicleState &state, const WheelPair &torqueRequest, float dt)
+{
+  if (dt <= 0.0f) {
+    return;
+  }
+
+  // Static weight on each driven wheel, shifted to the rear axle when accelerating
+  const float transfer = config.mass * state.acceleration * config.loadTransfer;
+  const float axleLoad = config.mass * GRAVITY * config.drivenAxleLoad
+    + (config.rearWheelDrive ? transfer : -transfer);
+  const float load = 0.5f * std::max(axleLoad, 0.0f);
+  const float peakForce = config.friction * load;
+  const float reference = std::max(state.speed, config.slipMinSpeed);
+  // Tire force per slip speed in the linear range [N / (m/s)]
+  const float stiffness = config.slipStiffness * load / reference;
+
+  const float lag = dt / (config.motorTimeConstant + dt);
+  const float motorSpeedPerSpeed = config.gearRatio / config.wheelRadius;
+  const float gain = dt * config.wheelRadius / config.wheelInertia;
+
+  float tireForce{0.0f};
+  for (uint32_t i = LEFT; i <= RIGHT; i++) {
+    const float motorSpeed = std::fabs(state.wheelSpeed[i]) * motorSpeedPerSpeed;
+    const float limit = std::min(config.motorTorqueMax, config.motorPowerMax / std::max(motorSpeed, 1.0f));
+    const float target = std::min(std::max(torqueRequest[i] * 0.01f, -limit), limit);
+    state.motorTorque[i] += (target - state.motorTorque[i]) * lag;
+    const float drive = state.motorTorque[i] * config.gearRatio;
+
+    // Implicit in the tire force, which dominates the wheel dynamics
+    float wheelSpeed = (state.wheelSpeed[i] + gain * (drive + stiffness * config.wheelRadius * state.speed))
+      / (1.0f + gain * stiffness * config.wheelRadius);
+    float force = stiffness * (wheelSpeed - state.speed);
+    if (std::fabs(force) > peakForce) {
+      // Spinning or locking, the tire transfers its peak force and the rest
+      // accelerates the wheel, at least as far as the slip of the peak force
+      force = std::copysign(peakForce, force);
+      const float saturated = state.speed + force / stiffness;
+      wheelSpeed = state.wheelSpeed[i] + gain * (drive - force * config.wheelRadius);
+      wheelSpeed = (force > 0.0f) ? std::max(wheelSpeed, saturated) : std::min(wheelSpeed, saturated);
+    }
+    if (wheelSpeed < 0.0f) {
+      // Locked rather than turning backwards
+      wheelSpeed = 0.0f;
+      force = std::max(-stiffness * state.speed, -peakForce);
+    }
+    state.wheelSpeed[i] = wheelSpeed;
+    state.slip[i] = (wheelSpeed - state.speed) / reference;
+    tireForce += force;
+  }
+
+  // Rolling resistance opposes motion, at standstill only as far as the drive
+  // force goes; the car does not reverse
+  const float resistance = config.dragArea * state.speed * state.speed;
+  const float rolling = config.rollingResistance * config.mass * GRAVITY;
+  const float force = (state.speed > 0.0f) ?
+    tireForce - resistance - rolling : std::max(tireForce - rolling, 0.0f);
+  const float speed = std::max(state.speed + force / config.mass * dt, 0.0f);
+
+  state.acceleration = (speed - state.speed) / dt;
+  state.position += 0.5f * (state.speed + speed) * dt;
+  state.speed = speed;
+  state.time += dt;
+}
+
+ClosedLoopConfig defaultClosedLoopConfig()
+{
+  ClosedLoopConfig config;
+  config.dt = 0.001f;
+  config.requestPeriod = 0.05f;
+  config.distance = 75.0f;
+  config.settleTime = 0.0f;
+  return config;
+}
+
+ClosedLoopResult runClosedLoop(Motion &motion, const VehicleConfig &vehicle, const ClosedLoopConfig &config,
+    const std::vector<ProfilePoint> &profile, std::vector<ClosedLoopSample> *trace)
+{
+  ClosedLoopResult result;
+  result.steps = 0;
+  result.distanceTime = -1.0f;
+  result.finalSpeed = 0.0f;
+  result.maxSpeed = 0.0f;
+  result.trackingError = 0.0f;
+  result.maxSlip = 0.0f;
+  result.effort = 0.0f;
+  result.jerk = 0.0f;
+  if (profile.empty() || config.dt <= 0.0f) {
+    return result;
+  }
+
+  // Counted in steps rather than accumulated in float, for runs of any length
+  const uint64_t steps = static_cast<uint64_t>(std::ceil(profile.back().time / config.dt));
+  const uint64_t requestSteps = std::max<uint64_t>(1,
+      static_cast<uint64_t>(std::lround(config.requestPeriod / config.dt)));
+  const int64_t stepMicroseconds = std::llround(static_cast<double>(config.dt) * 1e6);
+
+  VehicleState state = initialVehicleState();
+  size_t segment{0};
+  float speedRequest{0.0f};
+  double sumError{0.0}, sumTorque{0.0}, sumJerk{0.0};
+  uint64_t settled{0};
+  for (uint64_t step = 0; step < steps; step++) {
+    const float time = static_cast<float>(static_cast<double>(step) * static_cast<double>(config.dt));
+    const int64_t now = START_TIME + static_cast<int64_t>(step) * stepMicroseconds;
+    if (step % requestSteps == 0) {
+      speedRequest = profileSpeedAt(profile, time, segment);
+      motion.setSpeedRequest(speedRequest, now, now);
+    }
+    // Sensors read the model state of the previous step
+    const float drivenLeft = state.wheelSpeed[LEFT];
+    const float drivenRight = state.wheelSpeed[RIGHT];
+    if (vehicle.rearWheelDrive) {
+      motion.setLeftWheelSpeed(state.speed, now, now);
+      motion.setRightWheelSpeed(state.speed, now, now);
+      motion.setRearWheelSpeeds(drivenLeft, drivenRight, now, now);
+    } else {
+      motion.setLeftWheelSpeed(drivenLeft, now, now);
+      motion.setRightWheelSpeed(drivenRight, now, now);
+      motion.setRearWheelSpeeds(state.speed, state.speed, now, now);
+    }
+    motion.setAcceleration(state.acceleration, now, now);
+
+    opendlv::cfsdProxy::TorqueRequestDual msgTorque = motion.step(config.dt, now);
+    const WheelPair torqueRequest{{static_cast<float>(msgTorque.torqueLeft()),
+      static_cast<float>(msgTorque.torqueRight())}};
+    const float previousAcceleration = state.acceleration;
+    vehicleStep(vehicle, state, torqueRequest, config.dt);
+
+    if (result.distanceTime < 0.0f && state.position >= config.distance) {
+      result.distanceTime = state.time;
+    }
+    result.maxSpeed = std::max(result.maxSpeed, state.speed);
+    result.maxSlip = std::max(result.maxSlip, std::max(std::fabs(state.slip[LEFT]), std::fabs(state.slip[RIGHT])));
+    if (time >= config.settleTime) {
+      const float error = speedRequest - state.speed;
+      sumError += static_cast<double>(error * error);
+      settled++;
+    }
+    const float torque = (torqueRequest[LEFT] + torqueRequest[RIGHT]) * 0.01f;
+    sumTorque += static_cast<double>(torque * torque);
+    const float jerk = (state.acceleration - previousAcceleration) / config.dt;
+    sumJerk += static_cast<double>(jerk * jerk);
+    result.steps++;
+
+    if (trace != nullptr) {
+      trace->push_back({state.time, speedRequest, state.speed, state.acceleration, torqueRequest, state.slip});
+    }
+  }
+  result.finalSpeed = state.speed;
+  const double count = static_cast<double>(std::max<uint64_t>(result.steps, 1));
+  result.trackingError = static_cast<float>(std::sqrt(sumError / static_cast<double>(std::max<uint64_t>(settled, 1))));
+  result.effort = static_cast<float>(std::sqrt(sumTorque / count));
+  result.jerk = static_cast<float>(std::sqrt(sumJerk / count));
+  return result;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VEHICLE_MODEL_H
+#define VEHICLE_MODEL_H
+
+#include "logic-motion.hpp"
+#include "speed-profile.hpp"
+#include "torque-distribution.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Longitudinal model of the car for running the controller without hardware.
+// Each driven wheel has a motor that follows its torque request with a first
+// order lag inside a torque and power limit, a rotating mass and a tire whose
+// force grows with slip up to the friction limit of its normal load. The body
+// sees the tire forces, aerodynamic drag and rolling resistance. The wheel
+// dynamics are integrated semi-implicitly, so a fixed dt of a control cycle
+// stays stable even for the stiff tire at low speed.
+
+struct VehicleConfig {
+  bool rearWheelDrive;
+  float mass;                  // Including driver [kg]
+  float wheelRadius;           // [m]
+  float gearRatio;
+  float dragArea;              // 0.5 * rho * Cd * A [kg/m]
+  float rollingResistance;     // Coefficient
+  float drivenAxleLoad;        // Share of the static weight on the driven axle
+  float loadTransfer;          // Centre of gravity height over wheel base
+  float motorTorqueMax;        // Per motor, at the motor shaft [Nm]
+  float motorPowerMax;         // Per motor [W]
+  float motorTimeConstant;     // [s]
+  float wheelInertia;          // Driven wheel with the motor reflected through the gear [kg m^2]
+  float slipStiffness;         // Tire force per normal load and unit slip ratio
+  float friction;              // Peak friction coefficient
+  float slipMinSpeed;          // Lower bound of the reference speed in the slip ratio [m/s]
+};
+
+struct VehicleState {
+  float time;                  // [s]
+  float position;              // [m]
+  float speed;                 // [m/s]
+  float acceleration;          // [m/s^2]
+  WheelPair wheelSpeed;        // Driven wheels, at the circumference [m/s]
+  WheelPair motorTorque;       // At the motor shaft [Nm]
+  WheelPair slip;
+};
+
+VehicleConfig defaultVehicleConfig();
+// The car the controller is configured for: drive, mass, wheel and gear
+VehicleConfig vehicleConfigOf(const MotionParameters &parameters);
+VehicleState initialVehicleState();
+
+// Advances the model by dt [s] with a torque request per motor [cNm]
+void vehicleStep(const VehicleConfig &config, VehicleState &state, const WheelPair &torqueRequest, float dt);
+
+// One run of a speed request profile with the controller in the loop, every
+// cycle feeding the model state back as wheel speeds and acceleration
+struct ClosedLoopConfig {
+  float dt;                    // Controller and model step [s]
+  float requestPeriod;         // Interval between speed requests [s]
+  float distance;              // Run length for the timed distance [m]
+  float settleTime;            // Tracking error only from this time on [s]
+};
+
+struct ClosedLoopSample {
+  float time;                  // [s]
+  float speedRequest;          // [m/s]
+  float speed;                 // [m/s]
+  float acceleration;          // [m/s^2]
+  WheelPair torqueRequest;     // [cNm]
+  WheelPair slip;
+};
+
+struct ClosedLoopResult {
+  uint64_t steps;
+  float distanceTime;          // Time to cover the run length, negative if not reached [s]
+  float finalSpeed;            // [m/s]
+  float maxSpeed;              // [m/s]
+  float trackingError;         // RMS speed error from the settle time on [m/s]
+  float maxSlip;
+  float effort;                // RMS total torque request [Nm]
+  float jerk;                  // RMS jerk of the body [m/s^3]
+};
+
+ClosedLoopConfig defaultClosedLoopConfig();
+
+// The trace receives one sample per step when given
+ClosedLoopResult runClosedLoop(Motion &motion, const VehicleConfig &vehicle, const ClosedLoopConfig &config,
+    const std::vector<ProfilePoint> &profile, std::vector<ClosedLoopSample> *trace);
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Runs task(index) for every index in [0, count) on a number of threads. Each
+// worker starts on its own contiguous block of indices and, once it runs dry,
+// steals the upper half of the remaining block of another worker. A block is
+// one atomic word (begin in the low, end in the high 32 bits), so both taking
+// the next index and stealing are a single compare-and-swap.
+template <typename F>
+void parallelFor(uint32_t count, uint32_t threads, F &&task)
+{
+  threads = std::max(1u, std::min(threads, std::max(count, 1u)));
+
+  auto pack = [](uint64_t begin, uint64_t end) { return begin | (end << 32); };
+  auto begin = [](uint64_t range) { return static_cast<uint32_t>(range & 0xFFFFFFFF); };
+  auto end = [](uint64_t range) { return static_cast<uint32_t>(range >> 32); };
+
+  std::unique_ptr<std::atomic<uint64_t>[]> ranges(new std::atomic<uint64_t>[threads]);
+  for (uint32_t t = 0; t < threads; t++) {
+    const uint64_t first = static_cast<uint64_t>(count) * t / threads;
+    const uint64_t last = static_cast<uint64_t>(count) * (t + 1) / threads;
+    ranges[t].store(pack(first, last));
+  }
+
+  auto worker = [&](uint32_t self) {
+      while (true) {
+        // Own block first, taken from the front
+        uint64_t range = ranges[self].load();
+        while (begin(range) < end(range)) {
+          if (ranges[self].compare_exchange_weak(range, pack(begin(range) + 1, end(range)))) {
+            task(begin(range));
+            range = ranges[self].load();
+          }
+        }
+
+        // Steal the upper half of someone else's block
+        bool stolen = false;
+        for (uint32_t i = 1; i < threads && !stolen; i++) {
+          const uint32_t victim = (self + i) % threads;
+          uint64_t victimRange = ranges[victim].load();
+          while (begin(victimRange) < end(victimRange)) {
+            const uint32_t take = (end(victimRange) - begin(victimRange) + 1) / 2;
+            const uint32_t split = end(victimRange) - take;
+            if (ranges[victim].compare_exchange_weak(victimRange, pack(begin(victimRange), split))) {
+              ranges[self].store(pack(split, end(victimRange)));
+              stolen = true;
+              break;
+            }
+          }
+        }
+        if (!stolen) {
+          return;
+        }
+      }
+    };
+
+  std::vector<std::thread> pool;
+  for (uint32_t t = 1; t < threads; t++) {
+    pool.emplace_back(worker, t);
+  }
+  worker(0);
+  for (auto &thread : pool) {
+    thread.join();
+  }
+}
+#endif
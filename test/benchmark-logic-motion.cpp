@@ -0,0 +1,423 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "batch-receiver.hpp"
+#include "benchmark.hpp"
+#include "controller-batch.hpp"
+#include "cycle-log.hpp"
+#include "emergency-stop.hpp"
+#include "logic-motion.hpp"
+#include "message-decoder.hpp"
+#include "shared-input.hpp"
+#include "torque-request-sender.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Benchmarks for the control path of Motion and the message handling around
+// it. Run with --json=<file> to get machine-readable results.
+
+namespace {
+
+// Runs writer threads hammering the Motion setters for the lifetime of the object
+class SetterLoad {
+  public:
+    SetterLoad(Motion &motion, uint32_t writers)
+      : m_running{true}
+      , m_threads{}
+    {
+      for (uint32_t w = 0; w < writers; w++) {
+        m_threads.emplace_back([this, &motion, w]() {
+            float value = 0.0f;
+            while (m_running.load(std::memory_order_relaxed)) {
+              setInput(motion, w % 3, value);
+              value += 0.001f;
+            }
+          });
+      }
+    }
+
+    ~SetterLoad()
+    {
+      m_running.store(false);
+      for (auto &t : m_threads) {
+        t.join();
+      }
+    }
+
+    SetterLoad(const SetterLoad &) = delete;
+    SetterLoad &operator=(const SetterLoad &) = delete;
+
+    static void setInput(Motion &motion, uint32_t input, float value)
+    {
+      if (input == 0) {
+        motion.setLeftWheelSpeed(value);
+      } else if (input == 1) {
+        motion.setRightWheelSpeed(value);
+      } else {
+        motion.setSpeedRequest(value);
+      }
+    }
+
+  private:
+    std::atomic<bool> m_running;
+    std::vector<std::thread> m_threads;
+};
+
+std::string encodedWheelSpeedEnvelope()
+{
+  opendlv::proxy::WheelSpeedReading msg;
+  msg.wheelSpeed(12.34f);
+  cluon::ToProtoVisitor encoder;
+  msg.accept(encoder);
+
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::proxy::WheelSpeedReading::ID());
+  envelope.serializedData(encoder.encodedData());
+  envelope.senderStamp(1904);
+  return cluon::serializeEnvelope(std::move(envelope));
+}
+
+}
+
+BENCHMARK(MotionStep)
+{
+  Motion motion;
+  motion.setSpeedRequest(10.0f);
+  motion.setLeftWheelSpeed(5.0f);
+  motion.setRightWheelSpeed(4.0f);
+
+  std::vector<BenchmarkResult> results;
+  for (const ControllerType type : {ControllerType::P, ControllerType::PI, ControllerType::PID, ControllerType::MPC}) {
+    ControllerConfig config = motion.controllerConfig();
+    config.type = type;
+    motion.setController(config);
+    const std::string names[] = {"P", "PI", "PID", "MPC"};
+    const std::string name = names[static_cast<uint8_t>(type)];
+    results.push_back(measure("MotionStep/" + name, options, 1, [&motion]() {
+        auto msgTorque = motion.step(0.01f);
+        doNotOptimize(msgTorque);
+      }));
+  }
+  return results;
+}
+
+BENCHMARK(MotionStepContended)
+{
+  std::vector<BenchmarkResult> results;
+  for (const uint32_t writers : {1u, 3u}) {
+    Motion motion;
+    SetterLoad load(motion, writers);
+    results.push_back(measure("MotionStepContended/writers:" + std::to_string(writers), options, 1, [&motion]() {
+        auto msgTorque = motion.step(0.01f);
+        doNotOptimize(msgTorque);
+      }));
+  }
+  return results;
+}
+
+BENCHMARK(MotionSetterContended)
+{
+  std::vector<BenchmarkResult> results;
+  for (const uint32_t writers : {0u, 2u}) {
+    Motion motion;
+    SetterLoad load(motion, writers);
+    float value = 0.0f;
+    results.push_back(measure("MotionSetterContended/writers:" + std::to_string(writers), options, 1, [&motion, &value]() {
+        motion.setLeftWheelSpeed(value);
+        value += 0.001f;
+      }));
+  }
+  return results;
+}
+
+// A step of 1024 vehicles, as one batch and as separate Motion instances
+BENCHMARK(ControllerBatchStep)
+{
+  const uint32_t vehicles{1024};
+  Motion prototype;
+  ControllerBatch batch(vehicles, prototype.controllerConfig(), prototype.regenCutoffSpeed());
+  for (uint32_t v = 0; v < vehicles; v++) {
+    batch.setWheelSpeeds(v, 5.0f, 4.0f);
+    batch.setSpeedRequest(v, 10.0f, 0.0f);
+  }
+
+  std::vector<BenchmarkResult> results;
+  if (ControllerBatch::vectorized()) {
+    results.push_back(measure("ControllerBatchStep/avx2", options, 1, [&batch]() {
+        batch.step(0.01f);
+        doNotOptimize(batch);
+      }));
+  }
+  results.push_back(measure("ControllerBatchStep/scalar", options, 1, [&batch]() {
+      batch.stepScalar(0.01f);
+      doNotOptimize(batch);
+    }));
+
+  prototype.setSpeedRequest(10.0f);
+  prototype.setLeftWheelSpeed(5.0f);
+  prototype.setRightWheelSpeed(4.0f);
+  std::vector<Motion> motions(vehicles, prototype);
+  BenchmarkOptions fewer = options;
+  fewer.samples = std::max(1u, options.samples / 100);
+  results.push_back(measure("ControllerBatchStep/motion", fewer, 1, [&motions]() {
+      for (Motion &motion : motions) {
+        auto msgTorque = motion.step(0.01f);
+        doNotOptimize(msgTorque);
+      }
+    }));
+  return results;
+}
+
+BENCHMARK(OutputStage)
+{
+  OutputStageModel model = outputStageSetUp(defaultOutputStageConfig(), 0.22f, 16.0f);
+  OutputStageState state = initialOutputStageState();
+  float request{0.0f};
+  return {measure("OutputStage", options, options.batch, [&model, &state, &request]() {
+      request = (request > 5000.0f) ? -5000.0f : request + 37.0f;
+      MotorTorques output = outputStageUpdate(model, state, {{request, -request}}, {{12.0f, 12.5f}}, 10000);
+      doNotOptimize(output);
+    })};
+}
+
+// What the cycle log costs the control thread, with the writer draining to a
+// file in the background as in motion --cycle-log. Pushes faster than the
+// writer keeps up are dropped, which costs about the same.
+BENCHMARK(CycleLogPush)
+{
+  const std::string file{"benchmark-cycle-log.bin"};
+  std::vector<BenchmarkResult> results;
+  {
+    Motion motion;
+    motion.step(0.01f);
+    CycleRecord record = motion.lastRecord();
+    CycleLogWriter writer(file, 8192, 1.0f, 0.01f);
+    results.push_back(measure("CycleLogPush", options, options.batch, [&writer, &record]() {
+        record.sequence++;
+        doNotOptimize(writer.push(record));
+      }));
+  }
+  std::remove(file.c_str());
+  return results;
+}
+
+// The shared memory input of motion --shm-input: the ring alone, and a record
+// from the write to the reader thread sleeping on the futex and back
+BENCHMARK(SharedInput)
+{
+  SharedInputReader reader("benchmark-shared-input", 1024);
+  SharedInputWriter writer("benchmark-shared-input");
+  SharedInputRecord record{};
+  record.kind = SharedInputKind::LeftWheelSpeed;
+  std::vector<BenchmarkResult> results;
+  results.push_back(measure("SharedInput/writeRead", options, options.batch, [&reader, &writer, &record]() {
+      record.sampleTime++;
+      writer.write(record);
+      SharedInputRecord received;
+      doNotOptimize(reader.read(&received, 1, 0));
+    }));
+
+  std::atomic<bool> running{true};
+  std::atomic<int64_t> acknowledged{0};
+  std::thread consumer([&reader, &running, &acknowledged]() {
+      std::array<SharedInputRecord, 64> records;
+      while (running.load(std::memory_order_relaxed)) {
+        const uint32_t count = reader.read(records.data(), static_cast<uint32_t>(records.size()), 100000);
+        if (count > 0) {
+          acknowledged.store(records[count - 1].sampleTime, std::memory_order_release);
+        }
+      }
+    });
+  results.push_back(measure("SharedInput/wakeUp", options, 1, [&writer, &record, &acknowledged]() {
+      record.sampleTime++;
+      record.written = 0;
+      writer.write(record);
+      while (acknowledged.load(std::memory_order_acquire) != record.sampleTime) {
+      }
+    }));
+  running.store(false, std::memory_order_relaxed);
+  reader.wake();
+  consumer.join();
+  return results;
+}
+
+// RES emergency stop to zero torque. The handler alone: decoding, latching
+// and sending the zero request. And on the wire: a RESStatus datagram to a
+// receiving thread running the handler, until the zero torque request has
+// come back over the multicast group of the session.
+BENCHMARK(EmergencyStop)
+{
+  const uint16_t cid{251};
+  const uint16_t port{12201};
+  opendlv::cfsdProxyCANReading::RESStatus status;
+  status.resStatus(1).resEStop(1).resQuality(100).resButtons(0);
+  cluon::ToProtoVisitor encoder;
+  status.accept(encoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::cfsdProxyCANReading::RESStatus::ID());
+  envelope.serializedData(encoder.encodedData());
+  envelope.received(cluon::time::now());
+  envelope.sampleTimeStamp(cluon::time::now());
+
+  Motion motion;
+  TorqueRequestSender sender{cid, 2101};
+  std::vector<BenchmarkResult> results;
+  results.push_back(measure("EmergencyStop/handler", options, options.batch, [&motion, &sender, &envelope]() {
+      doNotOptimize(handleResStatus(motion, &sender, nullptr, envelope));
+    }));
+
+  std::atomic<uint64_t> zeroRequests{0};
+  BatchReceiverConfig config;
+  config.batch = 1;
+  config.busyPoll = 0;
+  BatchReceiver torqueReceiver("225.0.0." + std::to_string(cid), 12175, config,
+      [&zeroRequests](cluon::data::Envelope &&received) {
+        if (received.dataType() == opendlv::cfsdProxy::TorqueRequestDual::ID()) {
+          zeroRequests.fetch_add(1, std::memory_order_release);
+        }
+      });
+  BatchReceiver resReceiver("127.0.0.1", port, config, [&motion, &sender](cluon::data::Envelope &&received) {
+      handleResStatus(motion, &sender, nullptr, received);
+    });
+  cluon::UDPSender resSender("127.0.0.1", port);
+  const std::string datagram = cluon::serializeEnvelope(cluon::data::Envelope{envelope});
+  BenchmarkOptions fewer = options;
+  fewer.samples = std::max(1u, options.samples / 100);
+  results.push_back(measure("EmergencyStop/toZeroTorque", fewer, 1, [&resSender, &datagram, &zeroRequests]() {
+      const uint64_t before = zeroRequests.load(std::memory_order_acquire);
+      resSender.send(std::string{datagram});
+      // Gives up after a second on a lost datagram, which then shows as max
+      const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+      while (zeroRequests.load(std::memory_order_acquire) == before && std::chrono::steady_clock::now() < until) {
+      }
+    }));
+  resReceiver.stop();
+  torqueReceiver.stop();
+  return results;
+}
+
+// The mutex exchange Motion used before, for comparison
+BENCHMARK(MutexInputReference)
+{
+  std::mutex mutex;
+  float left{5.0f}, right{4.0f}, request{10.0f};
+  return {measure("MutexInputReference", options, 1, [&]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      float error = request - (left + right) / 2.0f;
+      doNotOptimize(error);
+    })};
+}
+
+BENCHMARK(TorqueRequestEncode)
+{
+  opendlv::cfsdProxy::TorqueRequestDual msgTorque;
+  msgTorque.torqueLeft(1234);
+  msgTorque.torqueRight(-1234);
+  return {measure("TorqueRequestEncode/ToProtoVisitor", options, options.batch, [&msgTorque]() {
+      cluon::ToProtoVisitor encoder;
+      msgTorque.accept(encoder);
+      std::string data = encoder.encodedData();
+      doNotOptimize(data);
+    })};
+}
+
+// Whole envelope as sent on the control path, the generic way through
+// OD4Session::send() against the preencoded one
+BENCHMARK(TorqueRequestSend)
+{
+  opendlv::cfsdProxy::TorqueRequestDual msgTorque;
+  msgTorque.torqueLeft(1234);
+  msgTorque.torqueRight(-1234);
+  const cluon::data::TimeStamp sampleTime = cluon::time::now();
+  std::vector<BenchmarkResult> results;
+  results.push_back(measure("TorqueRequestSend/serializeEnvelope", options, options.batch,
+        [&msgTorque, &sampleTime]() {
+      cluon::ToProtoVisitor encoder;
+      msgTorque.accept(encoder);
+      cluon::data::Envelope envelope;
+      envelope.dataType(opendlv::cfsdProxy::TorqueRequestDual::ID());
+      envelope.serializedData(encoder.encodedData());
+      envelope.sent(cluon::time::now());
+      envelope.sampleTimeStamp(sampleTime);
+      envelope.senderStamp(2101);
+      std::string data = cluon::serializeEnvelope(std::move(envelope));
+      doNotOptimize(data);
+    }));
+
+  TorqueRequestEnvelope preencoded{2101};
+  const int64_t sampleTimeUs = cluon::time::toMicroseconds(sampleTime);
+  results.push_back(measure("TorqueRequestSend/preencoded", options, options.batch,
+        [&preencoded, &msgTorque, sampleTimeUs]() {
+      preencoded.encode(msgTorque.torqueLeft(), msgTorque.torqueRight(), sampleTimeUs,
+          cluon::time::toMicroseconds(cluon::time::now()));
+      doNotOptimize(preencoded);
+    }));
+  return results;
+}
+
+BENCHMARK(WheelSpeedDecode)
+{
+  const std::string data = encodedWheelSpeedEnvelope();
+  std::stringstream sstr(data);
+  cluon::data::Envelope envelope = cluon::extractEnvelope(sstr).second;
+
+  std::vector<BenchmarkResult> results;
+  results.push_back(measure("WheelSpeedDecode/extractMessage", options, options.batch, [&envelope]() {
+      cluon::data::Envelope copy{envelope};
+      auto msg = cluon::extractMessage<opendlv::proxy::WheelSpeedReading>(std::move(copy));
+      doNotOptimize(msg);
+    }));
+  // As in the handlers of motion, without copying the envelope
+  results.push_back(measure("WheelSpeedDecode/decodeMessage", options, options.batch, [&envelope]() {
+      auto msg = decodeMessage<opendlv::proxy::WheelSpeedReading>(envelope);
+      doNotOptimize(msg);
+    }));
+  results.push_back(measure("WheelSpeedDecode/decodeFloatMessage", options, options.batch, [&envelope]() {
+      auto msg = decodeFloatMessage<opendlv::proxy::WheelSpeedReading>(envelope);
+      doNotOptimize(msg);
+    }));
+  return results;
+}
+
+int32_t main(int32_t argc, char **argv) {
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  BenchmarkOptions options;
+  options.samples = (commandlineArguments.count("samples") != 0) ?
+    static_cast<uint32_t>(std::stoi(commandlineArguments["samples"])) : 100000;
+  options.batch = (commandlineArguments.count("batch") != 0) ?
+    static_cast<uint32_t>(std::stoi(commandlineArguments["batch"])) : 10;
+
+  std::vector<BenchmarkResult> results = runBenchmarks(options, commandlineArguments["filter"]);
+  printTable(results);
+  if (commandlineArguments.count("json") != 0) {
+    writeJson(commandlineArguments["json"], results);
+  }
+  return 0;
+}
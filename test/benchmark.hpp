@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness in the spirit of Google Benchmark. Benchmarks
+// register themselves with BENCHMARK(name) and report a latency distribution
+// per operation. Results are printed as a table and can be written as JSON
+// with stable keys, so runs of different commits can be diffed.
+
+struct BenchmarkOptions {
+  uint32_t samples;
+  uint32_t batch;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  uint64_t iterations;
+  double mean;  // All times in [ns] per operation
+  double min;
+  double p50;
+  double p90;
+  double p99;
+  double p999;
+  double max;
+};
+
+using BenchmarkFunction = std::function<std::vector<BenchmarkResult>(const BenchmarkOptions &)>;
+
+inline std::vector<std::pair<std::string, BenchmarkFunction>> &benchmarkRegistry()
+{
+  static std::vector<std::pair<std::string, BenchmarkFunction>> registry;
+  return registry;
+}
+
+struct BenchmarkRegistration {
+  BenchmarkRegistration(const std::string &name, BenchmarkFunction function)
+  {
+    benchmarkRegistry().emplace_back(name, function);
+  }
+};
+
+#define BENCHMARK(NAME) \
+  std::vector<BenchmarkResult> NAME(const BenchmarkOptions &); \
+  static BenchmarkRegistration registration_##NAME{#NAME, NAME}; \
+  std::vector<BenchmarkResult> NAME(const BenchmarkOptions &options)
+
+// Keeps the compiler from optimising away a computed value
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Summarises samples holding the duration of `batch` operations each
+inline BenchmarkResult summarize(const std::string &name, std::vector<int64_t> &samples, uint32_t batch)
+{
+  BenchmarkResult result{name, 0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  if (samples.empty()) {
+    return result;
+  }
+  std::sort(samples.begin(), samples.end());
+  const double perOperation = 1.0 / static_cast<double>(std::max(batch, 1u));
+  auto at = [&samples, perOperation](double q) {
+      return static_cast<double>(samples[static_cast<size_t>(q * static_cast<double>(samples.size() - 1))]) * perOperation;
+    };
+  double sum{0.0};
+  for (int64_t s : samples) {
+    sum += static_cast<double>(s);
+  }
+  result.iterations = static_cast<uint64_t>(samples.size()) * std::max(batch, 1u);
+  result.mean = sum / static_cast<double>(samples.size()) * perOperation;
+  result.min = at(0.0);
+  result.p50 = at(0.5);
+  result.p90 = at(0.9);
+  result.p99 = at(0.99);
+  result.p999 = at(0.999);
+  result.max = at(1.0);
+  return result;
+}
+
+// Times `batch` calls of body() per sample
+template <typename F>
+inline BenchmarkResult measure(const std::string &name, const BenchmarkOptions &options, uint32_t batch, F &&body)
+{
+  std::vector<int64_t> samples(options.samples);
+  for (uint32_t i = 0; i < options.samples; i++) {
+    const auto before = std::chrono::steady_clock::now();
+    for (uint32_t b = 0; b < batch; b++) {
+      body();
+    }
+    const auto after = std::chrono::steady_clock::now();
+    samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+  }
+  return summarize(name, samples, batch);
+}
+
+inline void printTable(const std::vector<BenchmarkResult> &results)
+{
+  std::cout << "name;iterations;mean_ns;p50_ns;p90_ns;p99_ns;p999_ns;max_ns" << std::endl;
+  for (const BenchmarkResult &r : results) {
+    std::cout << r.name << ';' << r.iterations << ';' << r.mean << ';' << r.p50 << ';' << r.p90
+      << ';' << r.p99 << ';' << r.p999 << ';' << r.max << std::endl;
+  }
+}
+
+inline void writeJson(const std::string &file, const std::vector<BenchmarkResult> &results)
+{
+  std::ofstream out(file, std::ios::out | std::ios::trunc);
+  out << "{\n  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult &r = results[i];
+    out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+      << ", \"time_unit\": \"ns\", \"mean\": " << r.mean << ", \"min\": " << r.min
+      << ", \"p50\": " << r.p50 << ", \"p90\": " << r.p90 << ", \"p99\": " << r.p99
+      << ", \"p999\": " << r.p999 << ", \"max\": " << r.max << "}"
+      << ((i + 1 < results.size()) ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+}
+
+// Runs all registered benchmarks whose name contains filter
+inline std::vector<BenchmarkResult> runBenchmarks(const BenchmarkOptions &options, const std::string &filter)
+{
+  std::vector<BenchmarkResult> results;
+  for (auto &benchmark : benchmarkRegistry()) {
+    if (filter.empty() || benchmark.first.find(filter) != std::string::npos) {
+      for (BenchmarkResult &r : benchmark.second(options)) {
+        results.push_back(r);
+      }
+    }
+  }
+  return results;
+}
+#endif
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "cfsd-extended-message-set.hpp"
+#include "batch-receiver.hpp"
+#include "torque-request-sender.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+const uint16_t TEST_PORT{12199};
+
+// Waits up to a second for the receiver to see the given datagrams
+bool waitForDatagrams(const BatchReceiver &receiver, uint64_t datagrams)
+{
+  for (uint32_t i = 0; i < 1000 && receiver.counters().datagrams < datagrams; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return receiver.counters().datagrams >= datagrams;
+}
+
+}
+
+TEST_CASE("A burst of datagrams should be received in batches and decoded") {
+  // Checked here, Catch is not to be used from the receiving thread
+  std::atomic<uint32_t> envelopes{0};
+  std::atomic<uint32_t> unexpected{0};
+  std::atomic<int64_t> lastSampleTime{0};
+  BatchReceiverConfig config;
+  config.batch = 16;
+  config.busyPoll = 0;
+  BatchReceiver receiver("127.0.0.1", TEST_PORT, config,
+      [&envelopes, &unexpected, &lastSampleTime](cluon::data::Envelope &&envelope) {
+        if (envelope.dataType() != opendlv::cfsdProxy::TorqueRequestDual::ID()
+            || cluon::time::toMicroseconds(envelope.received()) <= 0) {
+          unexpected++;
+        }
+        lastSampleTime.store(cluon::time::toMicroseconds(envelope.sampleTimeStamp()));
+        envelopes++;
+      });
+  REQUIRE(receiver.isOpen());
+
+  cluon::UDPSender sender("127.0.0.1", TEST_PORT);
+  TorqueRequestEnvelope envelope{2101};
+  for (int64_t i = 1; i <= 40; i++) {
+    envelope.encode(100, 100, 1530000000000000 + i, 1530000000000000 + i);
+    sender.send(std::string(envelope.data(), envelope.size()));
+  }
+  sender.send(std::string("not an envelope"));
+
+  REQUIRE(waitForDatagrams(receiver, 41));
+  receiver.stop();
+  const BatchReceiverCounters counters = receiver.counters();
+  REQUIRE(envelopes == 40);
+  REQUIRE(unexpected == 0);
+  REQUIRE(lastSampleTime == 1530000000000040);
+  REQUIRE(counters.invalid == 1);
+  REQUIRE(counters.kernelDrops == 0);
+  REQUIRE(counters.syscalls <= counters.datagrams);
+  REQUIRE(counters.maxBatch <= 16);
+}
+
+TEST_CASE("Busy polling should only last for the configured time after traffic") {
+  BatchReceiverConfig config;
+  config.batch = 4;
+  config.busyPoll = 2000;
+  BatchReceiver receiver("127.0.0.1", TEST_PORT + 1, config, [](cluon::data::Envelope &&) {});
+  REQUIRE(receiver.isOpen());
+
+  cluon::UDPSender sender("127.0.0.1", TEST_PORT + 1);
+  TorqueRequestEnvelope envelope{2101};
+  envelope.encode(0, 0, 1, 1);
+  sender.send(std::string(envelope.data(), envelope.size()));
+  REQUIRE(waitForDatagrams(receiver, 1));
+
+  // Polling stops after 2 ms, later checks block again
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const uint64_t polls = receiver.counters().emptyPolls;
+  REQUIRE(polls > 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  REQUIRE(receiver.counters().emptyPolls == polls);
+}
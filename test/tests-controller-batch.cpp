@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "controller-batch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const float MODEL_GAIN{217.4f * 0.22f / 16.0f * 100.0f};
+const float REGEN_CUTOFF{5.0f / 3.6f};
+
+// A different law, anti-windup and saturation for every vehicle
+ControllerConfig configOf(uint32_t vehicle)
+{
+  ControllerConfig config = defaultControllerConfig(MODEL_GAIN);
+  config.type = static_cast<ControllerType>(vehicle % 3);
+  config.antiWindup = static_cast<AntiWindup>((vehicle / 3) % 3);
+  config.kp = MODEL_GAIN * (0.5f + 0.1f * static_cast<float>(vehicle % 7));
+  config.kd = 20.0f;
+  config.feedForwardGain = MODEL_GAIN;
+  config.outputMax = 500.0f + 100.0f * static_cast<float>(vehicle % 5);
+  config.outputMin = -config.outputMax;
+  return config;
+}
+
+// Motion without the estimator, trajectory and distribution stages
+int32_t referenceStep(const ControllerConfig &config, ControllerState &state,
+    float left, float right, float request, float acceleration, float dt)
+{
+  const float speed = (left + right) * 0.5f;
+  float torque = controllerStep(config, state, request - speed, acceleration, dt);
+  if (speed < REGEN_CUTOFF && torque < 0.0f) {
+    torque = 0.0f;
+  }
+  controllerTrackOutput(config, state, torque, dt);
+  return static_cast<int32_t>(torque * 0.5f);
+}
+
+void compareWithController(bool scalar)
+{
+  // Not a multiple of the vector width
+  const uint32_t vehicles{37};
+  ControllerBatch batch(vehicles, defaultControllerConfig(MODEL_GAIN), REGEN_CUTOFF);
+  std::vector<ControllerConfig> configs;
+  std::vector<ControllerState> states(vehicles, initialControllerState());
+  for (uint32_t v = 0; v < vehicles; v++) {
+    configs.push_back(configOf(v));
+    batch.configure(v, configs[v], REGEN_CUTOFF);
+  }
+
+  std::vector<int32_t> expected(vehicles);
+  for (uint32_t step = 0; step < 300; step++) {
+    for (uint32_t v = 0; v < vehicles; v++) {
+      const float request = (step / 50 % 2 == 0) ? 10.0f + static_cast<float>(v) : 0.0f;
+      const float left = 0.03f * static_cast<float>(step + v);
+      const float right = left + 0.1f;
+      const float acceleration = (step % 50 < 10) ? 2.0f : 0.0f;
+      batch.setWheelSpeeds(v, left, right);
+      batch.setSpeedRequest(v, request, acceleration);
+      expected[v] = referenceStep(configs[v], states[v], left, right, request, acceleration, 0.01f);
+    }
+    if (scalar) {
+      batch.stepScalar(0.01f);
+    } else {
+      batch.step(0.01f);
+    }
+    // Bit for bit, both paths run the same operations in the same order
+    for (uint32_t v = 0; v < vehicles; v++) {
+      REQUIRE(batch.torque(v)[LEFT] == expected[v]);
+      REQUIRE(batch.torque(v)[RIGHT] == expected[v]);
+      REQUIRE(batch.state(v).integral == states[v].integral);
+      REQUIRE(batch.state(v).derivative == states[v].derivative);
+    }
+  }
+}
+
+}
+
+TEST_CASE("The scalar batch should compute the same torques as single controllers") {
+  compareWithController(true);
+}
+
+TEST_CASE("The batch should compute the same torques on the vectorized path") {
+  compareWithController(false);
+}
+
+TEST_CASE("Reconfiguring a vehicle should restart only its controller") {
+  ControllerConfig config = defaultControllerConfig(MODEL_GAIN);
+  config.type = ControllerType::PI;
+  ControllerBatch batch(3, config, REGEN_CUTOFF);
+  REQUIRE(batch.size() == 3);
+  for (uint32_t v = 0; v < 3; v++) {
+    batch.setSpeedRequest(v, 10.0f, 0.0f);
+    batch.setWheelSpeeds(v, 5.0f, 5.0f);
+  }
+  batch.step(0.01f);
+  batch.step(0.01f);
+  REQUIRE(batch.state(1).integral > 0.0f);
+
+  batch.configure(1, config, REGEN_CUTOFF);
+  REQUIRE(batch.state(1).integral == Approx(0.0f));
+  REQUIRE(batch.state(1).initialized == 0);
+  REQUIRE(batch.state(0).integral > 0.0f);
+  REQUIRE(batch.state(2).integral == batch.state(0).integral);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "controller.hpp"
+
+TEST_CASE("P controller output should be proportional to the speed error") {
+  ControllerConfig config = defaultControllerConfig(100.0f);
+  ControllerState state = initialControllerState();
+
+  REQUIRE(controllerStep(config, state, 2.0f, 0.0f, 0.01f) == Approx(200.0f));
+  REQUIRE(controllerStep(config, state, 2.0f, 0.0f, 0.01f) == Approx(200.0f));
+  REQUIRE(state.integral == Approx(0.0f));
+}
+
+TEST_CASE("PI controller should integrate a constant speed error") {
+  ControllerConfig config = defaultControllerConfig(100.0f);
+  config.type = ControllerType::PI;
+  config.ki = 50.0f;
+  ControllerState state = initialControllerState();
+
+  float output = 0.0f;
+  for (int i = 0; i < 100; i++) {
+    output = controllerStep(config, state, 1.0f, 0.0f, 0.01f);
+  }
+  REQUIRE(state.integral == Approx(50.0f));
+  REQUIRE(output == Approx(150.0f));
+}
+
+TEST_CASE("Anti-windup should keep the integral bounded while saturated") {
+  ControllerConfig config = defaultControllerConfig(100.0f);
+  config.type = ControllerType::PI;
+  config.ki = 100.0f;
+  config.outputMax = 150.0f;
+
+  ControllerState none = initialControllerState();
+  ControllerState clamping = initialControllerState();
+  ControllerState backCalculation = initialControllerState();
+  for (int i = 0; i < 1000; i++) {
+    config.antiWindup = AntiWindup::None;
+    controllerStep(config, none, 1.0f, 0.0f, 0.01f);
+    config.antiWindup = AntiWindup::Clamping;
+    REQUIRE(controllerStep(config, clamping, 1.0f, 0.0f, 0.01f) <= 150.0f);
+    config.antiWindup = AntiWindup::BackCalculation;
+    REQUIRE(controllerStep(config, backCalculation, 1.0f, 0.0f, 0.01f) <= 150.0f);
+  }
+
+  REQUIRE(none.integral == Approx(1000.0f));
+  REQUIRE(clamping.integral < 60.0f);
+  // Settles where ki * error balances kb * (unsaturated - saturated)
+  REQUIRE(backCalculation.integral == Approx(150.0f).epsilon(0.01));
+}
+
+TEST_CASE("PID derivative should be filtered and feed-forward added") {
+  ControllerConfig config = defaultControllerConfig(100.0f);
+  config.type = ControllerType::PID;
+  config.ki = 0.0f;
+  config.kd = 10.0f;
+  config.feedForwardGain = 20.0f;
+  ControllerState state = initialControllerState();
+
+  // No derivative kick on the first step
+  REQUIRE(controllerStep(config, state, 1.0f, 2.0f, 0.01f) == Approx(140.0f));
+
+  // Error step of 1 m/s in 0.01 s, raw derivative term 1000 cNm filtered
+  const float output = controllerStep(config, state, 2.0f, 0.0f, 0.01f);
+  REQUIRE(state.derivative > 0.0f);
+  REQUIRE(state.derivative < 1000.0f);
+  REQUIRE(output == Approx(200.0f + state.derivative));
+}
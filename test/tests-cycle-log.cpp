@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cycle-log.hpp"
+#include "logic-motion.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Steps should record the regeneration cutoff and what was sent") {
+  Motion motion;
+  const int64_t now{1000000};
+  // Braking request below the cutoff speed
+  motion.setLeftWheelSpeed(1.0f, now, now);
+  motion.setRightWheelSpeed(1.0f, now, now);
+  motion.setSpeedRequest(0.0f, now, now);
+
+  opendlv::cfsdProxy::TorqueRequestDual msg = motion.step(0.01f, now);
+  const CycleRecord record = motion.lastRecord();
+
+  REQUIRE(record.sequence == 1);
+  REQUIRE(record.time == now);
+  REQUIRE(record.speedRequestReceived == now);
+  REQUIRE(record.speedError < 0.0f);
+  REQUIRE(record.controllerTorque < 0.0f);
+  REQUIRE((record.flags & CYCLE_REGEN_CLAMPED) != 0);
+  REQUIRE((record.flags & CYCLE_MPC_ACTIVE) == 0);
+  REQUIRE(record.torque[0] == msg.torqueLeft());
+  REQUIRE(record.torque[1] == msg.torqueRight());
+
+  motion.step(0.01f, now + 10000);
+  REQUIRE(motion.lastRecord().sequence == 2);
+}
+
+TEST_CASE("A full ring should drop records instead of waiting") {
+  const std::string file{"tests-cycle-log-ring.bin"};
+  // The writer does not wake up during the test
+  CycleLogWriter writer(file, 3, 100.0f, 100.0f);
+  REQUIRE(writer.isOpen());
+  REQUIRE(writer.capacity() == 4);
+
+  CycleRecord record{};
+  for (uint64_t i = 1; i <= 6; i++) {
+    record.sequence = i;
+    writer.push(record);
+  }
+  REQUIRE(writer.pushed() == 4);
+  REQUIRE(writer.dropped() == 2);
+
+  writer.stop();
+  REQUIRE(writer.written() == 4);
+  std::vector<CycleRecord> records;
+  std::string error;
+  REQUIRE(readCycleLog(file, records, error));
+  REQUIRE(records.size() == 4);
+  REQUIRE(records.back().sequence == 4);
+  std::remove(file.c_str());
+}
+
+TEST_CASE("Logged records should read back unchanged and convert to CSV") {
+  const std::string file{"tests-cycle-log.bin"};
+  Motion motion;
+  std::vector<CycleRecord> expected;
+  {
+    CycleLogWriter writer(file, 16, 0.001f, 0.001f);
+    int64_t now{1000000};
+    motion.setSpeedRequest(10.0f, now, now);
+    for (uint32_t i = 0; i < 100; i++) {
+      motion.setLeftWheelSpeed(0.05f * static_cast<float>(i), now, now);
+      motion.setRightWheelSpeed(0.05f * static_cast<float>(i), now, now);
+      motion.step(0.01f, now);
+      expected.push_back(motion.lastRecord());
+      // Gives the writer a chance to keep up with the small ring
+      while (!writer.push(expected.back())) {
+        std::this_thread::yield();
+      }
+      now += 10000;
+    }
+  }
+
+  std::vector<CycleRecord> records;
+  std::string error;
+  REQUIRE(readCycleLog(file, records, error));
+  REQUIRE(records.size() == expected.size());
+  for (size_t i = 0; i < records.size(); i++) {
+    REQUIRE(records[i].sequence == expected[i].sequence);
+    REQUIRE(records[i].time == expected[i].time);
+    REQUIRE(records[i].speedError == Approx(expected[i].speedError));
+    REQUIRE(records[i].torque[0] == expected[i].torque[0]);
+  }
+
+  std::ostringstream csv;
+  writeCycleCsvHeader(csv, ';');
+  writeCycleCsvRow(csv, records.front(), ';');
+  std::string header;
+  std::string row;
+  std::istringstream lines(csv.str());
+  std::getline(lines, header);
+  std::getline(lines, row);
+  REQUIRE(header.compare(0, 14, "sequence;time;") == 0);
+  REQUIRE(row.compare(0, 10, "1;1000000;") == 0);
+  REQUIRE(std::count(header.begin(), header.end(), ';') == std::count(row.begin(), row.end(), ';'));
+
+  std::remove(file.c_str());
+  REQUIRE_FALSE(readCycleLog(file, records, error));
+}
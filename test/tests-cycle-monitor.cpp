@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cycle-monitor.hpp"
+
+TEST_CASE("Cycles on time should have no jitter or overruns") {
+  CycleMonitor monitor(100.0f);
+  REQUIRE(monitor.period() == 10000);
+
+  for (int64_t i = 0; i < 10; i++) {
+    monitor.record(i * 10000, i * 10000 + 200);
+  }
+
+  REQUIRE(monitor.cycles() == 10);
+  REQUIRE(monitor.overruns() == 0);
+  REQUIRE(monitor.maxJitter() == 0);
+  REQUIRE(monitor.maxComputeTime() == 200);
+}
+
+TEST_CASE("Late or too long cycles should be reported as overruns") {
+  CycleMonitor monitor(100.0f);
+
+  monitor.record(0, 100);
+  monitor.record(11000, 11100);
+  REQUIRE(monitor.lastJitter() == 1000);
+  REQUIRE(monitor.overruns() == 0);
+
+  // Started more than one period late
+  monitor.record(32000, 32100);
+  REQUIRE(monitor.overruns() == 1);
+
+  // Work does not fit into one period
+  monitor.record(42000, 55000);
+  REQUIRE(monitor.overruns() == 2);
+  REQUIRE(monitor.maxJitter() == 11000);
+}
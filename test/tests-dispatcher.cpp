@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "dispatcher.hpp"
+
+namespace {
+
+struct Counter {
+  uint32_t calls;
+  float lastValue;
+};
+
+void onWheelSpeed(Counter &counter, const cluon::data::Envelope &envelope)
+{
+  counter.calls++;
+  counter.lastValue = decodeMessage<opendlv::proxy::WheelSpeedReading>(envelope).wheelSpeed();
+}
+
+cluon::data::Envelope makeEnvelope(float wheelSpeed, uint32_t senderStamp)
+{
+  opendlv::proxy::WheelSpeedReading msg;
+  msg.wheelSpeed(wheelSpeed);
+  cluon::ToProtoVisitor encoder;
+  msg.accept(encoder);
+
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::proxy::WheelSpeedReading::ID());
+  envelope.serializedData(encoder.encodedData());
+  envelope.senderStamp(senderStamp);
+  return envelope;
+}
+
+}
+
+TEST_CASE("Envelopes should be routed by message ID and senderStamp to all subscribers") {
+  Counter left{0, 0.0f};
+  Counter right{0, 0.0f};
+  Counter any{0, 0.0f};
+
+  Dispatcher<3> dispatcher{{{
+    makeRoute<Counter, onWheelSpeed>(opendlv::proxy::WheelSpeedReading::ID(), 1904, left),
+    makeRoute<Counter, onWheelSpeed>(opendlv::proxy::WheelSpeedReading::ID(), 1903, right),
+    makeRoute<Counter, onWheelSpeed>(opendlv::proxy::WheelSpeedReading::ID(), ANY_SENDER_STAMP, any)
+  }}};
+
+  // Nothing is delivered before the dispatcher is started
+  REQUIRE(dispatcher.dispatch(makeEnvelope(1.0f, 1904)) == 0);
+  dispatcher.start();
+
+  REQUIRE(dispatcher.dispatch(makeEnvelope(2.0f, 1904)) == 2);
+  REQUIRE(dispatcher.dispatch(makeEnvelope(3.0f, 1903)) == 2);
+  REQUIRE(dispatcher.dispatch(makeEnvelope(4.0f, 1)) == 1);
+
+  REQUIRE(left.calls == 1);
+  REQUIRE(left.lastValue == Approx(2.0f));
+  REQUIRE(right.calls == 1);
+  REQUIRE(right.lastValue == Approx(3.0f));
+  REQUIRE(any.calls == 3);
+  REQUIRE(any.lastValue == Approx(4.0f));
+}
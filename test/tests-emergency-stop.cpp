@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "cfsd-extended-message-set.hpp"
+#include "batch-receiver.hpp"
+#include "emergency-stop.hpp"
+#include "message-decoder.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint16_t TEST_CID{252};
+
+cluon::data::Envelope makeResStatus(int32_t eStop, int64_t received)
+{
+  opendlv::cfsdProxyCANReading::RESStatus status;
+  status.resStatus(1).resEStop(eStop).resQuality(100).resButtons(0);
+  cluon::ToProtoVisitor encoder;
+  status.accept(encoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::cfsdProxyCANReading::RESStatus::ID());
+  envelope.serializedData(encoder.encodedData());
+  envelope.received(cluon::time::fromMicroseconds(received));
+  envelope.sampleTimeStamp(cluon::time::fromMicroseconds(received));
+  return envelope;
+}
+
+}
+
+TEST_CASE("An emergency stop should hold the torque at zero until released and requested again") {
+  Motion motion;
+  motion.setSpeedRequest(10.0f, 1000, 1000);
+  motion.setLeftWheelSpeed(5.0f, 1000, 1000);
+  motion.setRightWheelSpeed(5.0f, 1000, 1000);
+  REQUIRE(motion.step(0.01f, 2000).torqueLeft() > 0);
+
+  REQUIRE(motion.setEmergencyStop(true, 3000));
+  REQUIRE_FALSE(motion.setEmergencyStop(true, 3100));
+  REQUIRE(motion.emergencyStopped());
+  auto msgTorque = motion.step(0.01f, 3200);
+  REQUIRE(msgTorque.torqueLeft() == 0);
+  REQUIRE(msgTorque.torqueRight() == 0);
+  REQUIRE((motion.lastRecord().flags & CYCLE_EMERGENCY_STOP) != 0);
+  REQUIRE(motion.outputStageState().output[0] == 0);
+
+  // Released, but the last speed request is from before the stop
+  motion.setEmergencyStop(false, 4000);
+  REQUIRE(motion.step(0.01f, 4100).torqueLeft() == 0);
+  REQUIRE(motion.emergencyStopped());
+
+  motion.setSpeedRequest(10.0f, 5000, 5000);
+  REQUIRE(motion.step(0.01f, 5100).torqueLeft() > 0);
+  REQUIRE_FALSE(motion.emergencyStopped());
+  REQUIRE((motion.lastRecord().flags & CYCLE_EMERGENCY_STOP) == 0);
+}
+
+TEST_CASE("An emergency stop pressed again before it was lifted should stay latched") {
+  Motion motion;
+  motion.setEmergencyStop(true, 1000);
+  motion.setEmergencyStop(false, 2000);
+  motion.setEmergencyStop(true, 3000);
+  motion.setSpeedRequest(10.0f, 4000, 4000);
+  motion.setLeftWheelSpeed(5.0f, 4000, 4000);
+  motion.setRightWheelSpeed(5.0f, 4000, 4000);
+  REQUIRE(motion.step(0.01f, 4100).torqueLeft() == 0);
+  REQUIRE(motion.emergencyStopped());
+}
+
+TEST_CASE("A RESStatus with the emergency stop should send zero torque right away") {
+  std::atomic<uint32_t> zeroRequests{0};
+  BatchReceiverConfig config;
+  config.batch = 4;
+  config.busyPoll = 0;
+  BatchReceiver receiver("225.0.0." + std::to_string(TEST_CID), 12175, config,
+      [&zeroRequests](cluon::data::Envelope &&envelope) {
+        if (envelope.dataType() == opendlv::cfsdProxy::TorqueRequestDual::ID() && envelope.senderStamp() == 2101) {
+          auto msg = decodeMessage<opendlv::cfsdProxy::TorqueRequestDual>(envelope);
+          zeroRequests += (msg.torqueLeft() == 0 && msg.torqueRight() == 0) ? 1 : 0;
+        }
+      });
+  REQUIRE(receiver.isOpen());
+
+  Motion motion;
+  TorqueRequestSender sender{TEST_CID, 2101};
+  EmergencyStopResult result = handleResStatus(motion, &sender, nullptr, makeResStatus(0, 1000));
+  REQUIRE_FALSE(result.stop);
+  REQUIRE_FALSE(result.sent);
+  REQUIRE_FALSE(motion.emergencyStopped());
+
+  result = handleResStatus(motion, &sender, nullptr, makeResStatus(1, 2000));
+  REQUIRE(result.stop);
+  REQUIRE(result.latched);
+  REQUIRE(result.sent);
+  REQUIRE(motion.emergencyStopped());
+  REQUIRE_FALSE(handleResStatus(motion, &sender, nullptr, makeResStatus(1, 2100)).latched);
+
+  for (uint32_t i = 0; i < 1000 && zeroRequests < 2; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  REQUIRE(zeroRequests == 2);
+}
+
+TEST_CASE("Without its own sender the emergency stop should send zero torque through the fallback") {
+  Motion motion;
+  std::vector<int64_t> sampleTimes;
+  ZeroTorqueFallback fallback = [&sampleTimes](const cluon::data::TimeStamp &sampleTime) {
+      sampleTimes.push_back(cluon::time::toMicroseconds(sampleTime));
+      return true;
+    };
+  EmergencyStopResult result = handleResStatus(motion, nullptr, fallback, makeResStatus(0, 1000));
+  REQUIRE_FALSE(result.sent);
+  REQUIRE(sampleTimes.empty());
+
+  result = handleResStatus(motion, nullptr, fallback, makeResStatus(1, 2000));
+  REQUIRE(result.latched);
+  REQUIRE(result.sent);
+  REQUIRE(sampleTimes == std::vector<int64_t>{2000});
+
+  // Nothing left to send with
+  result = handleResStatus(motion, nullptr, nullptr, makeResStatus(1, 3000));
+  REQUIRE(result.stop);
+  REQUIRE_FALSE(result.sent);
+  REQUIRE(motion.emergencyStopped());
+}
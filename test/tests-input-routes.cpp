@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "input-routes.hpp"
+
+#include <map>
+#include <string>
+
+namespace {
+
+template <typename T>
+cluon::data::Envelope makeEnvelope(T &message, uint32_t senderStamp, int64_t time)
+{
+  cluon::ToProtoVisitor encoder;
+  message.accept(encoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(static_cast<int32_t>(T::ID()));
+  envelope.serializedData(encoder.encodedData());
+  envelope.senderStamp(senderStamp);
+  envelope.sampleTimeStamp(cluon::time::fromMicroseconds(time));
+  envelope.received(cluon::time::fromMicroseconds(time + 10));
+  return envelope;
+}
+
+}
+
+TEST_CASE("Sender stamps should come from the command line, any sender otherwise") {
+  const std::map<std::string, std::string> arguments{{"imu-id", "112"}, {"preview-id", "7"}};
+  InputSenderStamps stamps = inputSenderStamps(arguments);
+  REQUIRE(stamps.imu == 112);
+  REQUIRE(stamps.preview == 7);
+  REQUIRE(stamps.groundSpeed == ANY_SENDER_STAMP);
+  REQUIRE(stamps.steering == ANY_SENDER_STAMP);
+}
+
+TEST_CASE("Sensor routes should feed Motion from the configured senders only") {
+  Motion motion;
+  InputFeed feed{motion, false, 0};
+  InputSenderStamps stamps = inputSenderStamps({{"ground-speed-id", "5"}});
+  Dispatcher<SENSOR_ROUTES> dispatcher{sensorRoutes(feed, stamps)};
+  dispatcher.start();
+
+  opendlv::proxy::WheelSpeedReading wheelSpeed;
+  wheelSpeed.wheelSpeed(3.0f);
+  REQUIRE(dispatcher.dispatch(makeEnvelope(wheelSpeed, 1904, 1000)) == 1);
+  opendlv::proxy::GroundSpeedReading groundSpeed;
+  groundSpeed.groundSpeed(4.0f);
+  REQUIRE(dispatcher.dispatch(makeEnvelope(groundSpeed, 6, 1100)) == 0);
+  REQUIRE(dispatcher.dispatch(makeEnvelope(groundSpeed, 5, 1200)) == 1);
+  opendlv::proxy::GroundSteeringRequest steering;
+  steering.groundSteering(0.1f);
+  REQUIRE(dispatcher.dispatch(makeEnvelope(steering, 99, 1300)) == 1);
+  motion.step(0.01f, 2000);
+
+  MotionInputs inputs = motion.lastInputs();
+  REQUIRE(inputs.leftWheelSpeed == Approx(3.0f));
+  REQUIRE(inputs.leftWheelSpeedSampleTime == 1000);
+  REQUIRE(inputs.leftWheelSpeedReceived == 1010);
+  REQUIRE(inputs.groundSpeed == Approx(4.0f));
+  REQUIRE(inputs.groundSpeedReceived == 1210);
+  REQUIRE(inputs.steeringRequest == Approx(0.1f));
+
+  // A replay stamps every input with its own time
+  feed.replayTime = 5000;
+  REQUIRE(dispatcher.dispatch(makeEnvelope(wheelSpeed, 1903, 1000)) == 1);
+  motion.step(0.01f, 6000);
+  REQUIRE(motion.lastInputs().rightWheelSpeedReceived == 5000);
+}
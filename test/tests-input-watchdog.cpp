@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "input-watchdog.hpp"
+#include "logic-motion.hpp"
+
+namespace {
+
+const int64_t NOW{1000000000};
+
+uint32_t staleAfter(int64_t wheelSpeedAge, int64_t speedRequestAge)
+{
+  return staleInputs(defaultWatchdogConfig(),
+      {{NOW - wheelSpeedAge, NOW - wheelSpeedAge, NOW - speedRequestAge}}, NOW);
+}
+
+}
+
+TEST_CASE("Inputs older than their timeout should be stale") {
+  REQUIRE(staleAfter(50000, 400000) == 0);
+  REQUIRE(staleAfter(150000, 400000) == (1u << WATCH_LEFT_WHEEL_SPEED | 1u << WATCH_RIGHT_WHEEL_SPEED));
+  REQUIRE(staleAfter(50000, 600000) == 1u << WATCH_SPEED_REQUEST);
+  // Never received
+  REQUIRE(staleInputs(defaultWatchdogConfig(), {{0, NOW, NOW}}, NOW) == 1u << WATCH_LEFT_WHEEL_SPEED);
+}
+
+TEST_CASE("A single stale wheel speed should only degrade") {
+  WatchdogConfig config = defaultWatchdogConfig();
+  WatchdogState state = initialWatchdogState();
+  const WheelPair torque{{500.0f, 500.0f}};
+
+  for (int i = 0; i < 100; i++) {
+    watchdogUpdate(config, state, 1u << WATCH_LEFT_WHEEL_SPEED, torque, 0.01f);
+  }
+  REQUIRE(state.state == FailSafeState::Degraded);
+  REQUIRE(state.output[LEFT] == Approx(500.0f));
+}
+
+TEST_CASE("A stale speed request should ramp torque to zero at the configured rate") {
+  WatchdogConfig config = defaultWatchdogConfig();
+  config.degradedTime = 0.045f;
+  config.rampRate = 10000.0f;
+  WatchdogState state = initialWatchdogState();
+  const WheelPair torque{{500.0f, -300.0f}};
+
+  watchdogUpdate(config, state, 0, torque, 0.01f);
+  REQUIRE(state.state == FailSafeState::Nominal);
+
+  // Degraded for the first 40 ms
+  for (int i = 0; i < 4; i++) {
+    watchdogUpdate(config, state, 1u << WATCH_SPEED_REQUEST, torque, 0.01f);
+    REQUIRE(state.state == FailSafeState::Degraded);
+  }
+  WheelPair output = watchdogUpdate(config, state, 1u << WATCH_SPEED_REQUEST, torque, 0.01f);
+  REQUIRE(state.state == FailSafeState::SafeStop);
+  REQUIRE(output[LEFT] == Approx(400.0f));
+  REQUIRE(output[RIGHT] == Approx(-200.0f));
+
+  for (int i = 0; i < 10; i++) {
+    output = watchdogUpdate(config, state, 1u << WATCH_SPEED_REQUEST, torque, 0.01f);
+  }
+  REQUIRE(output[LEFT] == Approx(0.0f));
+  REQUIRE(output[RIGHT] == Approx(0.0f));
+
+  // Latched while anything is still stale
+  watchdogUpdate(config, state, 1u << WATCH_LEFT_WHEEL_SPEED, torque, 0.01f);
+  REQUIRE(state.state == FailSafeState::SafeStop);
+  output = watchdogUpdate(config, state, 0, torque, 0.01f);
+  REQUIRE(state.state == FailSafeState::Nominal);
+  REQUIRE(output[LEFT] == Approx(500.0f));
+}
+
+TEST_CASE("Motion should stop requesting torque when the inputs stop arriving") {
+  Motion motion;
+  motion.setSpeedRequest(10.0f, NOW, NOW);
+  motion.setLeftWheelSpeed(5.0f, NOW, NOW);
+  motion.setRightWheelSpeed(5.0f, NOW, NOW);
+  REQUIRE(motion.step(0.01f, NOW).torqueLeft() > 0);
+
+  // No new inputs for a second
+  opendlv::cfsdProxy::TorqueRequestDual msg;
+  for (int i = 1; i <= 100; i++) {
+    msg = motion.step(0.01f, NOW + i * 10000);
+  }
+  REQUIRE(motion.watchdogState().state == FailSafeState::SafeStop);
+  REQUIRE(msg.torqueLeft() == 0);
+  REQUIRE(msg.torqueRight() == 0);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "latency-histogram.hpp"
+
+TEST_CASE("Percentiles should be within the bucket resolution") {
+  LatencyHistogram histogram;
+  for (int64_t i = 1; i <= 1000; i++) {
+    histogram.record(i);
+  }
+
+  REQUIRE(histogram.count() == 1000);
+  REQUIRE(histogram.max() == 1000);
+  REQUIRE(histogram.mean() == Approx(500.5f));
+  REQUIRE(histogram.percentile(0.5f) >= 500);
+  REQUIRE(histogram.percentile(0.5f) <= 500 * 1.125);
+  REQUIRE(histogram.percentile(0.99f) >= 990);
+  REQUIRE(histogram.percentile(0.99f) <= 1000);
+}
+
+TEST_CASE("Small, negative and huge values should be recorded") {
+  LatencyHistogram histogram;
+  histogram.record(-5);
+  histogram.record(3);
+  histogram.record(int64_t{1} << 40);
+
+  REQUIRE(histogram.count() == 3);
+  REQUIRE(histogram.percentile(0.0f) == 0);
+  REQUIRE(histogram.percentile(0.5f) == 3);
+  REQUIRE(histogram.percentile(1.0f) == histogram.max());
+}
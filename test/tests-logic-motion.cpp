@@ -35,3 +35,93 @@ TEST_CASE("Speed request should result in non-zero torque") {
   REQUIRE(msgTorque.torqueLeft() > 0);
   REQUIRE(msgTorque.torqueRight() > 0);
 }
+
+TEST_CASE("Inputs should be read back as one consistent snapshot") {
+  Motion motion;
+
+  motion.setSpeedRequest(10.0f);
+  motion.setLeftWheelSpeed(5.0f);
+  motion.setRightWheelSpeed(4.0f);
+
+  MotionInputs inputs = motion.inputs();
+
+  REQUIRE(inputs.speedRequest == Approx(10.0f));
+  REQUIRE(inputs.leftWheelSpeed == Approx(5.0f));
+  REQUIRE(inputs.rightWheelSpeed == Approx(4.0f));
+  REQUIRE(inputs.rightWheelSpeedReceived >= inputs.speedRequestReceived);
+}
+
+TEST_CASE("A copy should continue independently from the same state") {
+  Motion motion;
+  ControllerConfig config = motion.controllerConfig();
+  config.type = ControllerType::PI;
+  motion.setController(config);
+
+  motion.setSpeedRequest(10.0f);
+  motion.setLeftWheelSpeed(5.0f);
+  motion.setRightWheelSpeed(5.0f);
+  motion.step(0.01f);
+
+  Motion copy(motion);
+  REQUIRE(copy.inputs().speedRequest == Approx(10.0f));
+  REQUIRE(copy.step(0.01f).torqueLeft() == motion.step(0.01f).torqueLeft());
+
+  copy.setSpeedRequest(20.0f);
+  REQUIRE(motion.inputs().speedRequest == Approx(10.0f));
+}
+
+TEST_CASE("Step should keep the input times it worked on") {
+  Motion motion;
+
+  motion.setSpeedRequest(10.0f, 100, 110);
+  motion.setLeftWheelSpeed(5.0f, 200, 210);
+  motion.setRightWheelSpeed(4.0f, 300, 310);
+  motion.step(0.01f);
+
+  MotionInputs inputs = motion.lastInputs();
+  REQUIRE(inputs.speedRequestSampleTime == 100);
+  REQUIRE(inputs.speedRequestReceived == 110);
+  REQUIRE(inputs.leftWheelSpeedReceived == 210);
+  REQUIRE(inputs.rightWheelSpeedSampleTime == 300);
+}
+
+TEST_CASE("Step should average the wheel speeds received since the previous step") {
+  Motion motion;
+
+  motion.setLeftWheelSpeed(4.0f, 100, 100);
+  motion.setRightWheelSpeed(4.0f, 100, 100);
+  motion.setLeftWheelSpeed(6.0f, 200, 200);
+  motion.setRightWheelSpeed(6.0f, 200, 200);
+  motion.step(0.01f, 1000);
+
+  REQUIRE(motion.speedEstimate().speed == Approx(5.0f));
+  MotionSampleCounts counts = motion.lastSampleCounts();
+  REQUIRE(counts.leftWheelSpeed == 2);
+  REQUIRE(counts.rightWheelSpeed == 2);
+  REQUIRE(counts.rearWheelSpeeds == 0);
+  REQUIRE(motion.lastRecord().wheelSpeedSamples == 4);
+  REQUIRE(motion.lastInputs().leftWheelSpeed == Approx(6.0f));
+
+  TimedSample latest;
+  REQUIRE(motion.latestLeftWheelSpeed(latest));
+  REQUIRE(latest.sampleTime == 200);
+  REQUIRE_FALSE(motion.latestRearWheelSpeeds(latest));
+
+  // Nothing new, the measurement holds the latest value
+  motion.step(0.01f, 2000);
+  REQUIRE(motion.lastSampleCounts().leftWheelSpeed == 0);
+  REQUIRE(motion.lastRecord().wheelSpeedSamples == 0);
+}
+
+TEST_CASE("A stale wheel speed should drop out of the speed estimate") {
+  Motion motion;
+
+  const int64_t NOW{10000000};
+  motion.setLeftWheelSpeed(8.0f, NOW - 500000, NOW - 500000);
+  motion.setRightWheelSpeed(4.0f, NOW, NOW);
+  motion.step(0.01f, NOW);
+
+  REQUIRE(motion.speedEstimate().valid);
+  REQUIRE(motion.speedEstimate().speed == Approx(4.0f));
+  REQUIRE(motion.lastRecord().staleInputs == (1u << WATCH_LEFT_WHEEL_SPEED | 1u << WATCH_SPEED_REQUEST));
+}
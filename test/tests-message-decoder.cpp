@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "cfsd-extended-message-set.hpp"
+
+#include "message-decoder.hpp"
+
+#include <string>
+
+namespace {
+
+template <typename T>
+cluon::data::Envelope makeEnvelope(T &msg)
+{
+  cluon::ToProtoVisitor encoder;
+  msg.accept(encoder);
+
+  cluon::data::Envelope envelope;
+  envelope.dataType(T::ID());
+  envelope.serializedData(encoder.encodedData());
+  return envelope;
+}
+
+}
+
+TEST_CASE("Float messages should decode like through FromProtoVisitor") {
+  opendlv::proxy::WheelSpeedReading wheelSpeed;
+  wheelSpeed.wheelSpeed(12.34f);
+  REQUIRE(decodeFloatMessage<opendlv::proxy::WheelSpeedReading>(makeEnvelope(wheelSpeed)).wheelSpeed()
+      == 12.34f);
+
+  opendlv::proxy::GroundSpeedRequest speedRequest;
+  speedRequest.groundSpeed(-3.5f);
+  REQUIRE(decodeFloatMessage<opendlv::proxy::GroundSpeedRequest>(makeEnvelope(speedRequest)).groundSpeed()
+      == -3.5f);
+
+  opendlv::proxy::AccelerationReading acceleration;
+  acceleration.accelerationX(1.0f).accelerationY(-2.0f).accelerationZ(9.81f);
+  auto decoded = decodeFloatMessage<opendlv::proxy::AccelerationReading>(makeEnvelope(acceleration));
+  REQUIRE(decoded.accelerationX() == 1.0f);
+  REQUIRE(decoded.accelerationY() == -2.0f);
+  REQUIRE(decoded.accelerationZ() == 9.81f);
+
+  opendlv::cfsdProxyCANReading::WheelSpeedRare rear;
+  rear.wheelRareRight(4.0f).wheelRareLeft(5.0f);
+  auto decodedRear = decodeFloatMessage<opendlv::cfsdProxyCANReading::WheelSpeedRare>(makeEnvelope(rear));
+  REQUIRE(decodedRear.wheelRareRight() == 4.0f);
+  REQUIRE(decodedRear.wheelRareLeft() == 5.0f);
+}
+
+TEST_CASE("Int messages should decode like through FromProtoVisitor") {
+  opendlv::cfsdProxyCANReading::RESStatus status;
+  status.resStatus(1).resEStop(1).resQuality(-75).resButtons(300000);
+  auto decoded = decodeIntMessage<opendlv::cfsdProxyCANReading::RESStatus>(makeEnvelope(status));
+  auto reference = decodeMessage<opendlv::cfsdProxyCANReading::RESStatus>(makeEnvelope(status));
+  REQUIRE(decoded.resStatus() == reference.resStatus());
+  REQUIRE(decoded.resEStop() == 1);
+  REQUIRE(decoded.resQuality() == -75);
+  REQUIRE(decoded.resButtons() == 300000);
+
+  status.resEStop(0);
+  REQUIRE(decodeIntMessage<opendlv::cfsdProxyCANReading::RESStatus>(makeEnvelope(status)).resEStop() == 0);
+}
+
+TEST_CASE("Unknown fields should be skipped and missing ones read as zero") {
+  // Field 1 as varint, field 3 as string, field 2 as float 1.0
+  const std::string payload{"\x08\x96\x01\x1a\x02hi\x15\x00\x00\x80\x3f", 12};
+  std::array<float, 2> values;
+  REQUIRE(decodeFloatFields<2>(payload.data(), payload.size(), values));
+  REQUIRE(values[0] == 0.0f);
+  REQUIRE(values[1] == 1.0f);
+}
+
+TEST_CASE("Truncated payloads should be rejected") {
+  const std::string payload{"\x0d\x00\x00\x80\x3f", 5};
+  std::array<float, 1> values;
+  REQUIRE(decodeFloatFields<1>(payload.data(), payload.size(), values));
+  REQUIRE_FALSE(decodeFloatFields<1>(payload.data(), 4, values));
+  REQUIRE_FALSE(decodeFloatFields<1>("\x1a\x05hi", 4, values));
+  REQUIRE_FALSE(decodeFloatFields<1>("\x88", 1, values));
+}
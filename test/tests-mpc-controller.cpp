@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "logic-motion.hpp"
+#include "mpc-controller.hpp"
+
+#include <limits>
+
+namespace {
+
+const float MODEL_GAIN{217.4f * 0.22f / 16.0f * 100.0f};
+
+MpcInputs track(float speed, float request)
+{
+  MpcInputs inputs;
+  inputs.speed = speed;
+  inputs.reference = request;
+  inputs.referenceAcceleration = 0.0f;
+  inputs.speedRequest = request;
+  inputs.previousTorque = 0.0f;
+  inputs.torqueMin = -std::numeric_limits<float>::max();
+  inputs.torqueMax = std::numeric_limits<float>::max();
+  inputs.maxTorqueRate = 100000.0f;
+  inputs.powerLimit = 80000.0f;
+  inputs.regenCutoffSpeed = 0.0f;
+  inputs.gearRatio = 16.0f;
+  inputs.wheelRadius = 0.22f;
+  inputs.dt = 0.01f;
+  return inputs;
+}
+
+}
+
+TEST_CASE("The MPC should hold the speed without torque when on the reference") {
+  MpcConfig config = defaultMpcConfig();
+  config.solveTimeout = 1.0f;
+  MpcModel model = mpcSetUp(config);
+  MpcState state = initialMpcState();
+
+  float torque{-1.0f};
+  REQUIRE(mpcStep(config, model, state, track(10.0f, 10.0f), MODEL_GAIN, torque));
+  REQUIRE(torque == Approx(0.0f).margin(1.0f));
+}
+
+TEST_CASE("The MPC should respect the torque rate and power limits") {
+  MpcConfig config = defaultMpcConfig();
+  config.solveTimeout = 1.0f;
+  MpcModel model = mpcSetUp(config);
+  MpcState state = initialMpcState();
+
+  // Far below the reference, the torque can only rise by the rate
+  float torque{0.0f};
+  MpcInputs inputs = track(20.0f, 30.0f);
+  inputs.maxTorqueRate = 50000.0f;
+  inputs.powerLimit = 20000.0f;
+  REQUIRE(mpcStep(config, model, state, inputs, MODEL_GAIN, torque));
+  REQUIRE(torque > 0.0f);
+  REQUIRE(torque <= 500.0f + 1.0f);
+
+  // At 20 m/s, 20 kW allow 100 * 20000 W * 0.22 m / 16 / 20 m/s = 1375 cNm
+  for (int i = 0; i < 100; i++) {
+    inputs.previousTorque = torque;
+    REQUIRE(mpcStep(config, model, state, inputs, MODEL_GAIN, torque));
+    REQUIRE(torque <= 1375.0f + 5.0f);
+  }
+  REQUIRE(torque == Approx(1375.0f).margin(5.0f));
+}
+
+TEST_CASE("The MPC should not request regeneration below the cutoff speed") {
+  MpcConfig config = defaultMpcConfig();
+  config.solveTimeout = 1.0f;
+  MpcModel model = mpcSetUp(config);
+  MpcState state = initialMpcState();
+
+  MpcInputs inputs = track(1.0f, 0.0f);
+  inputs.regenCutoffSpeed = 5.0f / 3.6f;
+  float torque{0.0f};
+  REQUIRE(mpcStep(config, model, state, inputs, MODEL_GAIN, torque));
+  REQUIRE(torque >= 0.0f);
+}
+
+TEST_CASE("The MPC should only depend on its inputs without a timeout") {
+  const MpcConfig config = defaultMpcConfig();
+  REQUIRE(config.solveTimeout == Approx(0.0f));
+  MpcModel model = mpcSetUp(config);
+  MpcState first = initialMpcState();
+  MpcState second = initialMpcState();
+
+  MpcInputs inputs = track(5.0f, 25.0f);
+  for (int i = 0; i < 50; i++) {
+    float a{0.0f};
+    float b{0.0f};
+    const bool solved = mpcStep(config, model, first, inputs, MODEL_GAIN, a);
+    REQUIRE(mpcStep(config, model, second, inputs, MODEL_GAIN, b) == solved);
+    REQUIRE(first.iterations == second.iterations);
+    REQUIRE(a == Approx(b).epsilon(0.0f));
+    inputs.previousTorque = a;
+    inputs.speed += 0.1f;
+  }
+}
+
+TEST_CASE("Motion should fall back to the P law when the MPC does not finish") {
+  Motion mpc;
+  ControllerConfig config = mpc.controllerConfig();
+  config.type = ControllerType::MPC;
+  mpc.setController(config);
+  mpc.setTrajectory([] { TrajectoryConfig c = defaultTrajectoryConfig(); c.enabled = false; return c; }());
+  MpcConfig mpcConfig = defaultMpcConfig();
+  mpcConfig.maxIterations = 1;
+  mpc.setMpc(mpcConfig);
+
+  Motion p(mpc);
+  config.type = ControllerType::P;
+  p.setController(config);
+
+  for (Motion *motion : {&mpc, &p}) {
+    motion->setSpeedRequest(10.0f);
+    motion->setLeftWheelSpeed(5.0f);
+    motion->setRightWheelSpeed(5.0f);
+  }
+  REQUIRE(mpc.step(0.01f).torqueLeft() == p.step(0.01f).torqueLeft());
+  REQUIRE(mpc.mpcState().timeouts == 1);
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "output-stage.hpp"
+#include "logic-motion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Per motor: 500 cNm per 10 ms, 10 kW
+OutputStageConfig limits()
+{
+  OutputStageConfig config = defaultOutputStageConfig();
+  config.torqueMin = {{-1000.0f, -2000.0f}};
+  config.torqueMax = {{3000.0f, 4000.0f}};
+  config.maxTorqueRate = 100000.0f;
+  config.powerLimit = 20000.0f;
+  return config;
+}
+
+const float WHEEL_RADIUS{0.22f};
+const float GEAR_RATIO{16.0f};
+const int32_t DT{10000};
+
+}
+
+TEST_CASE("The output stage should keep each motor within its own torque limits") {
+  OutputStageModel model = outputStageSetUp(limits(), WHEEL_RADIUS, GEAR_RATIO);
+  OutputStageState state = initialOutputStageState();
+
+  MotorTorques output = outputStageUpdate(model, state, {{1e12f, 1e12f}}, {{1.0f, 1.0f}}, 0);
+  REQUIRE(output[LEFT] == 3000);
+  REQUIRE(output[RIGHT] == 4000);
+  REQUIRE((state.limited & (1u << (LIMIT_TORQUE * 2 + LEFT))) != 0);
+  REQUIRE((state.limited & (1u << (LIMIT_TORQUE * 2 + RIGHT))) != 0);
+
+  output = outputStageUpdate(model, state, {{-1e12f, -5000.0f}}, {{1.0f, 1.0f}}, 0);
+  REQUIRE(output[LEFT] == -1000);
+  REQUIRE(output[RIGHT] == -2000);
+
+  output = outputStageUpdate(model, state, {{250.6f, -120.4f}}, {{1.0f, 1.0f}}, 0);
+  REQUIRE(output[LEFT] == 250);
+  REQUIRE(output[RIGHT] == -120);
+  REQUIRE(state.limited == 0);
+}
+
+TEST_CASE("The output stage should limit the torque rate of each motor") {
+  OutputStageModel model = outputStageSetUp(limits(), WHEEL_RADIUS, GEAR_RATIO);
+  OutputStageState state = initialOutputStageState();
+
+  for (int32_t i = 1; i <= 4; i++) {
+    MotorTorques output = outputStageUpdate(model, state, {{3000.0f, -2000.0f}}, {{1.0f, 1.0f}}, DT);
+    REQUIRE(output[LEFT] == 500 * i);
+    REQUIRE(output[RIGHT] == -std::min(500 * i, 2000));
+    REQUIRE((state.limited & (1u << (LIMIT_RATE * 2 + LEFT))) != 0);
+  }
+  // Less torque passes at once, as requested by the slip limiter or the
+  // watchdog, only the growth on the other side of zero is slewed again
+  MotorTorques output = outputStageUpdate(model, state, {{1000.0f, -3000.0f}}, {{1.0f, 1.0f}}, DT);
+  REQUIRE(output[LEFT] == 1000);
+  REQUIRE(output[RIGHT] == -2000);
+  REQUIRE((state.limited & (1u << (LIMIT_RATE * 2 + LEFT))) == 0);
+  output = outputStageUpdate(model, state, {{-800.0f, 0.0f}}, {{1.0f, 1.0f}}, DT);
+  REQUIRE(output[LEFT] == -500);
+  REQUIRE(output[RIGHT] == 0);
+  output = outputStageUpdate(model, state, {{1000.0f, 0.0f}}, {{1.0f, 1.0f}}, DT);
+  REQUIRE(output[LEFT] == 500);
+
+  // Without elapsed time there is nothing to limit the rate against
+  output = outputStageUpdate(model, state, {{0.0f, 0.0f}}, {{1.0f, 1.0f}}, 0);
+  REQUIRE(output[LEFT] == 0);
+  REQUIRE(output[RIGHT] == 0);
+}
+
+TEST_CASE("The output stage should limit the power at the wheel speed") {
+  OutputStageModel model = outputStageSetUp(limits(), WHEEL_RADIUS, GEAR_RATIO);
+  OutputStageState state = initialOutputStageState();
+
+  // 100 * 10 kW * 0.22 m / 16 / 20 m/s = 687.5 cNm
+  MotorTorques output = outputStageUpdate(model, state, {{3000.0f, -2000.0f}}, {{20.0f, -20.0f}}, 0);
+  REQUIRE(output[LEFT] == 687);
+  REQUIRE(output[RIGHT] == -687);
+  REQUIRE((state.limited & (1u << (LIMIT_POWER * 2 + LEFT))) != 0);
+  REQUIRE((state.limited & (1u << (LIMIT_POWER * 2 + RIGHT))) != 0);
+
+  // A spinning wheel loses torque at once, regardless of the rate limit
+  output = outputStageUpdate(model, state, {{3000.0f, 0.0f}}, {{10.0f, 0.0f}}, 0);
+  REQUIRE(output[LEFT] == 1375);
+  output = outputStageUpdate(model, state, {{3000.0f, 0.0f}}, {{40.0f, 0.0f}}, DT);
+  REQUIRE(output[LEFT] == 343);
+
+  // At standstill the torque limit is all that is left
+  output = outputStageUpdate(model, state, {{3000.0f, 0.0f}}, {{0.0f, 0.0f}}, 0);
+  REQUIRE(output[LEFT] == 3000);
+}
+
+TEST_CASE("The defaults should keep each motor within the drivetrain limits") {
+  OutputStageModel model = outputStageSetUp(defaultOutputStageConfig(), WHEEL_RADIUS, GEAR_RATIO);
+  OutputStageState state = initialOutputStageState();
+
+  // 21 Nm per motor, and the rate is not limited
+  MotorTorques output = outputStageUpdate(model, state, {{150000.0f, -150000.0f}}, {{1.0f, 1.0f}}, 1000);
+  REQUIRE(output[LEFT] == 2100);
+  REQUIRE(output[RIGHT] == -2100);
+  REQUIRE((state.limited & (1u << (LIMIT_RATE * 2 + LEFT))) == 0);
+
+  // 100 * 40 kW * 0.22 m / 16 / 30 m/s = 1833.3 cNm
+  output = outputStageUpdate(model, state, {{150000.0f, -150000.0f}}, {{30.0f, 30.0f}}, 1000);
+  REQUIRE(output[LEFT] == 1833);
+  REQUIRE(output[RIGHT] == -1833);
+}
+
+TEST_CASE("The output stage should send zero torque for a request that is not a number") {
+  OutputStageModel model = outputStageSetUp(defaultOutputStageConfig(), WHEEL_RADIUS, GEAR_RATIO);
+  OutputStageState state = initialOutputStageState();
+  outputStageUpdate(model, state, {{1000.0f, 1000.0f}}, {{1.0f, 1.0f}}, DT);
+
+  MotorTorques output = outputStageUpdate(model, state, {{std::nanf(""), std::numeric_limits<float>::infinity()}},
+      {{1.0f, std::nanf("")}}, DT);
+  REQUIRE(output[LEFT] == 0);
+  REQUIRE(output[RIGHT] == 0);
+}
+
+TEST_CASE("Motion should send rate limited torque requests within the motor limits") {
+  Motion motion;
+  OutputStageConfig config = limits();
+  motion.setOutputStage(config);
+  // Only the output stage limits the motors
+  DistributionConfig distribution = defaultDistributionConfig();
+  distribution.motorMax = {{5000.0f, 5000.0f}};
+  motion.setDistribution(distribution);
+  TrajectoryConfig trajectory = defaultTrajectoryConfig();
+  trajectory.enabled = false;
+  motion.setTrajectory(trajectory);
+
+  const int64_t now{1000000000};
+  motion.setSpeedRequest(30.0f, now, now);
+  motion.setLeftWheelSpeed(0.0f, now, now);
+  motion.setRightWheelSpeed(0.0f, now, now);
+
+  int32_t previous{0};
+  for (int32_t i = 0; i < 20; i++) {
+    opendlv::cfsdProxy::TorqueRequestDual msgTorque = motion.step(0.01f, now);
+    REQUIRE(msgTorque.torqueLeft() - previous <= 500);
+    REQUIRE(msgTorque.torqueLeft() <= 3000);
+    REQUIRE(msgTorque.torqueRight() <= 4000);
+    previous = msgTorque.torqueLeft();
+  }
+  REQUIRE(previous == 3000);
+  REQUIRE(motion.outputStageState().output[LEFT] == 3000);
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "logic-motion.hpp"
+#include "parameter-store.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+TEST_CASE("Parameters should be parsed with the command line names") {
+  MotionParameters parameters = defaultMotionParameters();
+  std::string error;
+  REQUIRE(parseParameters(parseParameterString("mass=300;controller=pi kp=1200;front-wheel-drive"),
+        parameters, error));
+
+  REQUIRE(parameters.mass == Approx(300.0f));
+  REQUIRE(parameters.controller.type == ControllerType::PI);
+  REQUIRE(parameters.controller.kp == Approx(1200.0f));
+  // Unset gains follow the model of the heavier car
+  REQUIRE(parameters.controller.ki == Approx(0.5f * modelGainOf(parameters)));
+  REQUIRE_FALSE(parameters.distribution.rearWheelDrive);
+  REQUIRE(parameters.mpc.solveTimeout == Approx(0.0f));
+
+  REQUIRE(parseParameters(parseParameterString("mpc-iterations=50;mpc-timeout=500"), parameters, error));
+  REQUIRE(parameters.mpc.maxIterations == 50);
+  REQUIRE(parameters.mpc.solveTimeout == Approx(0.0005f));
+}
+
+TEST_CASE("Invalid parameters should leave the previous ones untouched") {
+  MotionParameters parameters = defaultMotionParameters();
+  std::string error;
+  REQUIRE_FALSE(parseParameters(parseParameterString("mass=300;kp=fast"), parameters, error));
+  REQUIRE_FALSE(error.empty());
+  REQUIRE(parameters.mass == Approx(217.4f));
+  REQUIRE_FALSE(parseParameters(parseParameterString("controller=bang-bang"), parameters, error));
+  REQUIRE_FALSE(parseParameters(parseParameterString("wheel-radius=0"), parameters, error));
+}
+
+TEST_CASE("Parameters that would make the torque not a number should be rejected") {
+  MotionParameters parameters = defaultMotionParameters();
+  std::string error;
+  REQUIRE_FALSE(parseParameters(parseParameterString("kp=nan"), parameters, error));
+  REQUIRE(error == "invalid number: kp=nan");
+  REQUIRE_FALSE(parseParameters(parseParameterString("ki=inf"), parameters, error));
+  REQUIRE_FALSE(parseParameters(parseParameterString("yaw-gain=-INF"), parameters, error));
+  REQUIRE_FALSE(parseParameters(parseParameterString("slip-band=0"), parameters, error));
+  REQUIRE(error == "wheel-base, slip-band and motor-max must be positive");
+  REQUIRE_FALSE(parseParameters(parseParameterString("wheel-base=-1.5"), parameters, error));
+  REQUIRE_FALSE(parseParameters(parseParameterString("motor-max=-100"), parameters, error));
+  REQUIRE_FALSE(parseParameters(parseParameterString("mpc-iterations=0"), parameters, error));
+  REQUIRE_FALSE(parseParameters(parseParameterString("mpc-timeout=-1"), parameters, error));
+  REQUIRE_FALSE(parseParameters(parseParameterString("torque-min=500;torque-max=100"), parameters, error));
+  REQUIRE(error == "torque-min must not exceed torque-max");
+  REQUIRE(parameters.controller.kp == Approx(defaultMotionParameters().controller.kp));
+  REQUIRE(parseParameters(parseParameterString("torque-min=-100;torque-max=100;slip-band=0.05"), parameters, error));
+}
+
+TEST_CASE("Unknown parameters should be rejected") {
+  MotionParameters parameters = defaultMotionParameters();
+  std::string error;
+  REQUIRE_FALSE(parseParameters(parseParameterString("mass=300;slip-limt=0.2"), parameters, error));
+  REQUIRE(error == "unknown parameter slip-limt");
+  REQUIRE(parameters.mass == Approx(217.4f));
+  REQUIRE_FALSE(parseParameters(parseParameterString("cid=111"), parameters, error));
+}
+
+TEST_CASE("Published parameters should replace the current block") {
+  ParameterStore store{defaultMotionParameters()};
+  const MotionParameters *first = store.current();
+  REQUIRE(first->version == 1);
+
+  MotionParameters parameters = *first;
+  parameters.regenCutoffSpeed = 0.0f;
+  REQUIRE(store.publish(parameters) == 2);
+  REQUIRE(store.current()->regenCutoffSpeed == Approx(0.0f));
+
+  MotionParameters copy = defaultMotionParameters();
+  REQUIRE(store.copyIfNewer(1, copy));
+  REQUIRE(copy.version == 2);
+  REQUIRE(copy.regenCutoffSpeed == Approx(0.0f));
+  REQUIRE_FALSE(store.copyIfNewer(2, copy));
+}
+
+TEST_CASE("Replaced parameter blocks should be freed once no reader can hold them") {
+  ParameterStore store{defaultMotionParameters()};
+  std::atomic<bool> running{true};
+  std::atomic<uint32_t> torn{0};
+  std::thread reader([&store, &running, &torn]() {
+      MotionParameters parameters = defaultMotionParameters();
+      uint32_t version{1};
+      while (running.load()) {
+        if (store.copyIfNewer(version, parameters)) {
+          version = parameters.version;
+          if (!(parameters.mass == Approx(static_cast<float>(version)))) {
+            torn++;
+          }
+        }
+      }
+    });
+
+  MotionParameters parameters = defaultMotionParameters();
+  for (uint32_t version = 2; version <= 2000; version++) {
+    parameters.mass = static_cast<float>(version);
+    REQUIRE(store.publish(parameters) == version);
+  }
+  running = false;
+  reader.join();
+  REQUIRE(torn == 0);
+
+  store.publish(parameters);
+  REQUIRE(store.retained() == 1);
+}
+
+TEST_CASE("Motion should pick up published parameters on the next step") {
+  ParameterStore store{defaultMotionParameters()};
+  Motion motion;
+  motion.setParameterStore(&store);
+  motion.setSpeedRequest(10.0f);
+  motion.setLeftWheelSpeed(0.0f);
+  motion.setRightWheelSpeed(0.0f);
+  motion.step(0.01f);
+
+  MotionParameters parameters = *store.current();
+  parameters.controller.outputMax = 100.0f;
+  parameters.mass = 300.0f;
+  store.publish(parameters);
+  opendlv::cfsdProxy::TorqueRequestDual msg = motion.step(0.01f);
+
+  REQUIRE(msg.torqueLeft() + msg.torqueRight() <= 100);
+  REQUIRE(motion.modelGain() == Approx(300.0f * 0.22f / 16.0f * 100.0f));
+}
+
+TEST_CASE("Parameter sources should layer file and overrides over the command line") {
+  const std::string file{"tests-parameter-store.conf"};
+  {
+    std::ofstream out(file);
+    out << "# Test car\n" << "kp=500\n" << "slip-limit=0.2 # tuned on gravel\n";
+  }
+
+  ParameterStore store{defaultMotionParameters()};
+  ParameterSource source{store, {{"./motion", ""}, {"kp", "100"}, {"ki", "50"}, {"cid", "111"}}, {"cid"}, file};
+  std::string error;
+  REQUIRE(source.reload(error));
+  REQUIRE(store.current()->controller.kp == Approx(500.0f));
+  REQUIRE(store.current()->controller.ki == Approx(50.0f));
+  REQUIRE(store.current()->distribution.slipLimit == Approx(0.2f));
+
+  REQUIRE(source.override({{"kp", "700"}}, error));
+  REQUIRE(store.current()->controller.kp == Approx(700.0f));
+  const uint32_t version = store.current()->version;
+  REQUIRE_FALSE(source.override({{"ki", "slow"}}, error));
+  REQUIRE(store.current()->version == version);
+  // Options of the program only count on its command line
+  REQUIRE_FALSE(source.override({{"cid", "112"}}, error));
+  REQUIRE(store.current()->version == version);
+
+  REQUIRE_FALSE(source.fileChanged());
+  std::remove(file.c_str());
+  REQUIRE(source.fileChanged());
+  REQUIRE_FALSE(source.reload(error));
+  REQUIRE(store.current()->version == version);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "realtime.hpp"
+
+#include <chrono>
+#include <sched.h>
+#include <thread>
+
+TEST_CASE("Only requested real-time settings should be made and reported") {
+  RealtimeStatus status{initialRealtimeStatus()};
+  RealtimeConfig config{defaultRealtimeConfig()};
+  config.stackPrefault = 64 * 1024;
+  config.cpu = 0;
+
+  // On its own thread, so the test runner keeps its affinity. Checked after
+  // the join, as assertions belong to the thread running the test.
+  int cpu{-1};
+  std::thread thread([&config, &status, &cpu]() {
+      setUpRealtimeThread(config, status);
+      cpu = sched_getcpu();
+    });
+  thread.join();
+  if (status.applied[RT_AFFINITY]) {
+    REQUIRE(cpu == 0);
+  }
+
+  REQUIRE(status.requested[RT_STACK_PREFAULT]);
+  REQUIRE(status.applied[RT_STACK_PREFAULT]);
+  REQUIRE(status.requested[RT_AFFINITY]);
+  REQUIRE_FALSE(status.requested[RT_SCHEDULING]);
+  REQUIRE_FALSE(status.requested[RT_MEMORY_LOCK]);
+
+  const std::string report = realtimeReport(status);
+  REQUIRE(report.find("stack prefault: applied") != std::string::npos);
+  REQUIRE(report.find("SCHED_FIFO") == std::string::npos);
+}
+
+TEST_CASE("An impossible setting should be reported with its error") {
+  RealtimeStatus status{initialRealtimeStatus()};
+  RealtimeConfig config{defaultRealtimeConfig()};
+  config.cpu = CPU_SETSIZE;
+
+  setUpRealtimeThread(config, status);
+  REQUIRE(status.requested[RT_AFFINITY]);
+  REQUIRE_FALSE(status.applied[RT_AFFINITY]);
+  REQUIRE(status.error[RT_AFFINITY] != 0);
+  REQUIRE(realtimeReport(status).find("CPU affinity: not applied") != std::string::npos);
+}
+
+TEST_CASE("Periodic cycles should run on absolute deadlines") {
+  uint32_t cycles{0};
+  const auto started = std::chrono::steady_clock::now();
+  runAtFrequency(1000.0f, [&cycles]() { return ++cycles < 20; });
+  const float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - started).count();
+
+  REQUIRE(cycles == 20);
+  REQUIRE(elapsed >= 0.019f);
+  REQUIRE(elapsed < 0.5f);
+}
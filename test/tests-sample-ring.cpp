@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "sample-ring.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Samples should be drained once, oldest first") {
+  SampleRing<TimedSample, 8> ring;
+  TimedSample latest;
+  REQUIRE_FALSE(ring.latest(latest));
+
+  for (int64_t i = 1; i <= 3; i++) {
+    ring.push({i, i, {static_cast<float>(i), 0.0f}});
+  }
+  REQUIRE(ring.latest(latest));
+  REQUIRE(latest.sampleTime == 3);
+
+  std::vector<int64_t> drained;
+  SampleDrain result = ring.drain([&drained](const TimedSample &sample) { drained.push_back(sample.sampleTime); });
+  REQUIRE(result.count == 3);
+  REQUIRE(result.lost == 0);
+  REQUIRE(drained == std::vector<int64_t>{1, 2, 3});
+
+  result = ring.drain([](const TimedSample &) {});
+  REQUIRE(result.count == 0);
+  REQUIRE(ring.latest(latest));
+  REQUIRE(latest.sampleTime == 3);
+}
+
+TEST_CASE("Samples overwritten before the drain should be counted as lost") {
+  SampleRing<TimedSample, 4> ring;
+  for (int64_t i = 0; i < 10; i++) {
+    ring.push({i, i, {0.0f, 0.0f}});
+  }
+  std::vector<int64_t> drained;
+  SampleDrain result = ring.drain([&drained](const TimedSample &sample) { drained.push_back(sample.sampleTime); });
+  REQUIRE(result.count == 4);
+  REQUIRE(result.lost == 6);
+  REQUIRE(drained == std::vector<int64_t>{6, 7, 8, 9});
+  REQUIRE(ring.pushed() == 10);
+}
+
+TEST_CASE("A copy should continue from the same drain position") {
+  SampleRing<TimedSample, 4> ring;
+  ring.push({1, 1, {1.0f, 0.0f}});
+  ring.drain([](const TimedSample &) {});
+  ring.push({2, 2, {2.0f, 0.0f}});
+
+  SampleRing<TimedSample, 4> copy(ring);
+  int64_t last{0};
+  REQUIRE(copy.drain([&last](const TimedSample &sample) { last = sample.sampleTime; }).count == 1);
+  REQUIRE(last == 2);
+  REQUIRE(ring.drain([](const TimedSample &) {}).count == 1);
+}
+
+TEST_CASE("A concurrent drain should only see whole samples") {
+  SampleRing<TimedSample, 16> ring;
+  std::atomic<bool> running{true};
+  std::thread producer([&ring, &running]() {
+      int64_t i{0};
+      while (running.load(std::memory_order_relaxed)) {
+        i++;
+        ring.push({i, -i, {static_cast<float>(i % 1000), -static_cast<float>(i % 1000)}});
+      }
+    });
+
+  uint64_t torn{0};
+  uint64_t seen{0};
+  int64_t previous{0};
+  uint64_t unordered{0};
+  // Until enough samples went through, whenever the producer gets going
+  const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (seen < 100000 && std::chrono::steady_clock::now() < until) {
+    ring.drain([&torn, &seen, &previous, &unordered](const TimedSample &sample) {
+        torn += sample.received != -sample.sampleTime || sample.value[0] + sample.value[1] > 0.0f;
+        unordered += sample.sampleTime <= previous;
+        previous = sample.sampleTime;
+        seen++;
+      });
+  }
+  running.store(false, std::memory_order_relaxed);
+  producer.join();
+  REQUIRE(seen > 0);
+  REQUIRE(torn == 0);
+  REQUIRE(unordered == 0);
+}
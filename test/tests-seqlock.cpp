@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "seqlock.hpp"
+
+namespace {
+
+struct Pair {
+  int64_t first;
+  int64_t second;
+};
+
+}
+
+TEST_CASE("Loads should see the value of the last update") {
+  SeqLock<Pair> lock;
+  lock.store({1, 2});
+  lock.update([](Pair &value) { value.second = 3; });
+  Pair value = lock.load();
+  REQUIRE(value.first == 1);
+  REQUIRE(value.second == 3);
+}
+
+TEST_CASE("Bounded attempts should give up while a writer holds the value") {
+  SeqLock<Pair> lock;
+  lock.store({1, 2});
+  Pair seen{0, 0};
+  bool loaded{true};
+  bool updated{true};
+  bool modified{false};
+  lock.update([&](Pair &value) {
+      value.first = 5;
+      loaded = lock.tryLoad(seen, 100);
+      updated = lock.tryUpdate([&modified](Pair &) { modified = true; }, 100);
+    });
+  REQUIRE_FALSE(loaded);
+  REQUIRE(seen.first == 0);
+  REQUIRE_FALSE(updated);
+  REQUIRE_FALSE(modified);
+
+  REQUIRE(lock.tryLoad(seen, 1));
+  REQUIRE(seen.first == 5);
+  REQUIRE(lock.tryUpdate([](Pair &value) { value.second = 7; }, 1));
+  REQUIRE(lock.load().second == 7);
+}
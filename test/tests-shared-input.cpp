@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "shared-input.hpp"
+
+#include <array>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+SharedInputRecord makeRecord(SharedInputKind kind, int64_t sampleTime, float value)
+{
+  SharedInputRecord record{};
+  record.sampleTime = sampleTime;
+  record.value[0] = value;
+  record.value[1] = -value;
+  record.kind = kind;
+  return record;
+}
+
+}
+
+TEST_CASE("Records written by a producer should be read in order") {
+  SharedInputReader reader("tests-shared-input-order", 16);
+  REQUIRE(reader.isOpen());
+  SharedInputWriter writer("tests-shared-input-order");
+  REQUIRE(writer.isOpen());
+
+  writer.write(makeRecord(SharedInputKind::LeftWheelSpeed, 10, 1.0f));
+  writer.write(makeRecord(SharedInputKind::RearWheelSpeeds, 20, 2.0f));
+  writer.write(makeRecord(SharedInputKind::SpeedRequest, 30, 3.0f));
+
+  std::array<SharedInputRecord, 8> records;
+  REQUIRE(reader.read(records.data(), 2, 0) == 2);
+  REQUIRE(records[0].kind == SharedInputKind::LeftWheelSpeed);
+  REQUIRE(records[0].sampleTime == 10);
+  REQUIRE(records[0].written > 0);
+  REQUIRE(records[1].kind == SharedInputKind::RearWheelSpeeds);
+  REQUIRE(records[1].value[1] == Approx(-2.0f));
+  REQUIRE(reader.read(records.data(), 8, 0) == 1);
+  REQUIRE(records[0].value[0] == Approx(3.0f));
+  REQUIRE(reader.read(records.data(), 8, 0) == 0);
+  REQUIRE(reader.received() == 3);
+  REQUIRE(reader.lost() == 0);
+}
+
+TEST_CASE("A producer should not attach without a reader") {
+  SharedInputWriter writer("tests-shared-input-missing");
+  REQUIRE_FALSE(writer.isOpen());
+  writer.write(makeRecord(SharedInputKind::SpeedRequest, 1, 1.0f));
+}
+
+TEST_CASE("Records overwritten before they were read should be counted as lost") {
+  SharedInputReader reader("tests-shared-input-lapped", 6);
+  SharedInputWriter writer("tests-shared-input-lapped");
+  REQUIRE(writer.isOpen());
+
+  // Rounded up to 8 slots
+  for (int64_t i = 0; i < 20; i++) {
+    writer.write(makeRecord(SharedInputKind::RightWheelSpeed, i, static_cast<float>(i)));
+  }
+  std::array<SharedInputRecord, 32> records;
+  REQUIRE(reader.read(records.data(), 32, 0) == 8);
+  REQUIRE(records[0].sampleTime == 12);
+  REQUIRE(records[7].sampleTime == 19);
+  REQUIRE(reader.lost() == 12);
+}
+
+TEST_CASE("A waiting reader should wake up for a record and time out without one") {
+  SharedInputReader reader("tests-shared-input-wake", 16);
+  SharedInputWriter writer("tests-shared-input-wake");
+  REQUIRE(writer.isOpen());
+  std::array<SharedInputRecord, 4> records;
+
+  const auto start = std::chrono::steady_clock::now();
+  REQUIRE(reader.read(records.data(), 4, 20000) == 0);
+  REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(15));
+
+  std::thread producer([&writer]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    writer.write(makeRecord(SharedInputKind::SpeedRequest, 42, 5.0f));
+  });
+  const auto waited = std::chrono::steady_clock::now();
+  const uint32_t count = reader.read(records.data(), 4, 2000000);
+  producer.join();
+  REQUIRE(count == 1);
+  REQUIRE(records[0].sampleTime == 42);
+  REQUIRE(std::chrono::steady_clock::now() - waited < std::chrono::seconds(1));
+}
+
+TEST_CASE("A record a producer never published should be skipped as lost") {
+  SharedInputReader reader("tests-shared-input-hole", 16);
+  SharedInputWriter writer("tests-shared-input-hole");
+  REQUIRE(writer.isOpen());
+
+  // A producer that claimed a slot and died before publishing it, the ring
+  // starts at the next cache line of the user area
+  cluon::SharedMemory memory("tests-shared-input-hole");
+  REQUIRE(memory.valid());
+  const uintptr_t address = reinterpret_cast<uintptr_t>(memory.data());
+  SharedInputHeader *header = reinterpret_cast<SharedInputHeader *>(memory.data() + (64 - address % 64) % 64);
+  REQUIRE(header->magic == SHARED_INPUT_MAGIC);
+  header->head.fetch_add(1);
+
+  std::array<SharedInputRecord, 8> records;
+  REQUIRE(reader.read(records.data(), 8, 0) == 0);
+  writer.write(makeRecord(SharedInputKind::SpeedRequest, 1, 1.0f));
+  writer.write(makeRecord(SharedInputKind::SpeedRequest, 2, 2.0f));
+
+  // Waits a moment for the hole, not for the whole timeout
+  const auto start = std::chrono::steady_clock::now();
+  uint32_t count{0};
+  while (count == 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(1)) {
+    count = reader.read(records.data(), 8, 1000000);
+  }
+  REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+  REQUIRE(count == 2);
+  REQUIRE(records[0].sampleTime == 1);
+  REQUIRE(records[1].sampleTime == 2);
+  REQUIRE(reader.lost() == 1);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "speed-estimator.hpp"
+
+namespace {
+
+SpeedMeasurements wheels(float fl, float fr, float rl, float rr)
+{
+  SpeedMeasurements measurements;
+  measurements.speed = {{fl, fr, rl, rr, 0.0f}};
+  measurements.available = (1u << FRONT_LEFT) | (1u << FRONT_RIGHT) | (1u << REAR_LEFT) | (1u << REAR_RIGHT);
+  measurements.acceleration = 0.0f;
+  measurements.accelerationAvailable = 0;
+  return measurements;
+}
+
+}
+
+TEST_CASE("Estimate should start from the wheel speeds and be valid") {
+  EstimatorConfig config = defaultEstimatorConfig();
+  EstimatorState state = initialEstimatorState();
+
+  SpeedMeasurements none = wheels(0.0f, 0.0f, 0.0f, 0.0f);
+  none.available = 0;
+  REQUIRE_FALSE(estimatorUpdate(config, state, none, 0.01f).valid);
+
+  SpeedEstimate estimate = estimatorUpdate(config, state, wheels(10.0f, 10.2f, 9.8f, 10.0f), 0.01f);
+  REQUIRE(estimate.valid);
+  REQUIRE(estimate.speed == Approx(10.0f));
+  REQUIRE(estimate.used == 0xF);
+}
+
+TEST_CASE("A spinning wheel should be rejected") {
+  EstimatorConfig config = defaultEstimatorConfig();
+  EstimatorState state = initialEstimatorState();
+  estimatorUpdate(config, state, wheels(10.0f, 10.0f, 10.0f, 10.0f), 0.01f);
+
+  SpeedEstimate estimate{0.0f, false, 0};
+  for (int i = 0; i < 100; i++) {
+    estimate = estimatorUpdate(config, state, wheels(10.0f, 10.0f, 15.0f, 10.0f), 0.01f);
+  }
+  REQUIRE(estimate.valid);
+  REQUIRE(estimate.speed == Approx(10.0f));
+  REQUIRE((estimate.used & (1u << REAR_LEFT)) == 0);
+}
+
+TEST_CASE("The IMU should carry the estimate when all wheels spin up") {
+  EstimatorConfig config = defaultEstimatorConfig();
+  EstimatorState state = initialEstimatorState();
+  estimatorUpdate(config, state, wheels(10.0f, 10.0f, 10.0f, 10.0f), 0.01f);
+
+  SpeedMeasurements spinning = wheels(20.0f, 20.0f, 20.0f, 20.0f);
+  spinning.acceleration = 2.0f;
+  spinning.accelerationAvailable = 1;
+  SpeedEstimate estimate{0.0f, false, 0};
+  for (int i = 0; i < 10; i++) {
+    estimate = estimatorUpdate(config, state, spinning, 0.01f);
+  }
+  REQUIRE(estimate.used == 0);
+  REQUIRE(estimate.valid);
+  REQUIRE(estimate.speed == Approx(10.2f));
+
+  // Without measurements for too long the estimate turns invalid and then
+  // starts over from the wheel speeds
+  bool invalid{false};
+  for (int i = 0; i < 60; i++) {
+    estimate = estimatorUpdate(config, state, spinning, 0.01f);
+    invalid = invalid || !estimate.valid;
+  }
+  REQUIRE(invalid);
+  REQUIRE(estimate.valid);
+  REQUIRE(estimate.speed == Approx(20.0f).margin(0.2));
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "speed-trajectory.hpp"
+
+#include <cmath>
+
+namespace {
+
+TrajectoryInputs request(float speed, bool newRequest)
+{
+  TrajectoryInputs inputs;
+  inputs.speedRequest = speed;
+  inputs.newRequest = newRequest;
+  inputs.vehicleSpeed = 0.0f;
+  inputs.previewCurvature = 0.0f;
+  inputs.previewValid = false;
+  return inputs;
+}
+
+}
+
+TEST_CASE("A step in the request should become a ramp over the request interval") {
+  TrajectoryConfig config = defaultTrajectoryConfig();
+  config.maxAcceleration = 100.0f;
+  TrajectoryState state = initialTrajectoryState();
+
+  // Requests every 100 ms at a 10 ms control rate
+  for (int i = 0; i < 10; i++) {
+    trajectoryUpdate(config, state, request(0.0f, i == 0), 0.01f);
+  }
+  REQUIRE(trajectoryUpdate(config, state, request(1.0f, true), 0.01f) == Approx(0.1f));
+  REQUIRE(state.acceleration == Approx(10.0f));
+  for (int i = 0; i < 4; i++) {
+    trajectoryUpdate(config, state, request(1.0f, false), 0.01f);
+  }
+  REQUIRE(state.reference == Approx(0.5f));
+  for (int i = 0; i < 10; i++) {
+    trajectoryUpdate(config, state, request(1.0f, false), 0.01f);
+  }
+  REQUIRE(state.reference == Approx(1.0f));
+  REQUIRE(state.acceleration == Approx(0.0f));
+}
+
+TEST_CASE("The reference should respect the acceleration limits") {
+  TrajectoryConfig config = defaultTrajectoryConfig();
+  config.maxAcceleration = 5.0f;
+  config.maxDeceleration = 10.0f;
+  TrajectoryState state = initialTrajectoryState();
+
+  trajectoryUpdate(config, state, request(10.0f, true), 0.01f);
+  REQUIRE(state.reference == Approx(0.05f));
+  for (int i = 0; i < 300; i++) {
+    trajectoryUpdate(config, state, request(10.0f, false), 0.01f);
+  }
+  REQUIRE(state.reference == Approx(10.0f));
+
+  trajectoryUpdate(config, state, request(0.0f, true), 0.01f);
+  REQUIRE(state.acceleration == Approx(-10.0f));
+}
+
+TEST_CASE("The first segment should start from the vehicle speed") {
+  TrajectoryState state = initialTrajectoryState();
+  TrajectoryInputs inputs = request(8.0f, true);
+  inputs.vehicleSpeed = 8.0f;
+  REQUIRE(trajectoryUpdate(defaultTrajectoryConfig(), state, inputs, 0.01f) == Approx(8.0f));
+  REQUIRE(state.acceleration == Approx(0.0f));
+}
+
+TEST_CASE("A preview point in a corner should cap the reference ahead of it") {
+  TrajectoryConfig config = defaultTrajectoryConfig();
+  config.lateralAccelerationLimit = 10.0f;
+  TrajectoryState state = initialTrajectoryState();
+  TrajectoryInputs inputs = request(20.0f, true);
+  inputs.vehicleSpeed = 20.0f;
+  trajectoryUpdate(config, state, inputs, 0.01f);
+
+  // Radius 10 m allows 10 m/s
+  inputs.newRequest = false;
+  inputs.previewCurvature = previewCurvature(static_cast<float>(std::asin(0.5)), 10.0f);
+  inputs.previewValid = true;
+  REQUIRE(inputs.previewCurvature == Approx(0.1f));
+  for (int i = 0; i < 100; i++) {
+    trajectoryUpdate(config, state, inputs, 0.01f);
+  }
+  REQUIRE(state.reference == Approx(10.0f));
+}
+
+TEST_CASE("Without interpolation the request should pass through") {
+  TrajectoryConfig config = defaultTrajectoryConfig();
+  config.enabled = false;
+  TrajectoryState state = initialTrajectoryState();
+  REQUIRE(trajectoryUpdate(config, state, request(1.0f, true), 0.01f) == Approx(1.0f));
+  REQUIRE(state.acceleration == Approx(0.0f));
+  REQUIRE(trajectoryUpdate(config, state, request(2.0f, true), 0.01f) == Approx(2.0f));
+  REQUIRE(state.acceleration == Approx(100.0f));
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "torque-distribution.hpp"
+
+namespace {
+
+DistributionInputs straight(float torque, float speed)
+{
+  DistributionInputs inputs;
+  inputs.torque = torque;
+  inputs.vehicleSpeed = speed;
+  inputs.vehicleSpeedValid = true;
+  inputs.wheelSpeed = {{speed, speed}};
+  inputs.wheelSpeedValid = true;
+  inputs.steeringAngle = 0.0f;
+  return inputs;
+}
+
+}
+
+TEST_CASE("Without slip or steering the torque should be split evenly") {
+  DistributionOutput output = distributeTorque(defaultDistributionConfig(), straight(1000.0f, 10.0f));
+
+  REQUIRE(output.torque[LEFT] == Approx(500.0f));
+  REQUIRE(output.torque[RIGHT] == Approx(500.0f));
+  REQUIRE(output.slipFactor[LEFT] == Approx(1.0f));
+}
+
+TEST_CASE("A spinning wheel should lose its torque in the same cycle") {
+  DistributionInputs inputs = straight(1000.0f, 10.0f);
+  inputs.wheelSpeed[LEFT] = 13.0f;
+
+  DistributionOutput output = distributeTorque(defaultDistributionConfig(), inputs);
+  REQUIRE(output.slip[LEFT] == Approx(0.3f));
+  REQUIRE(output.torque[LEFT] == Approx(0.0f));
+  REQUIRE(output.torque[RIGHT] == Approx(500.0f));
+
+  // Half way into the slip band
+  inputs.wheelSpeed[LEFT] = 12.0f;
+  output = distributeTorque(defaultDistributionConfig(), inputs);
+  REQUIRE(output.torque[LEFT] == Approx(250.0f));
+}
+
+TEST_CASE("A locking wheel should lose its braking torque") {
+  DistributionInputs inputs = straight(-1000.0f, 10.0f);
+  inputs.wheelSpeed[RIGHT] = 7.0f;
+
+  DistributionOutput output = distributeTorque(defaultDistributionConfig(), inputs);
+  REQUIRE(output.torque[LEFT] == Approx(-500.0f));
+  REQUIRE(output.torque[RIGHT] == Approx(0.0f));
+}
+
+TEST_CASE("Steering left should shift torque to the right wheel within motor limits") {
+  DistributionConfig config = defaultDistributionConfig();
+  config.yawGain = 1000.0f;
+  config.motorMax = {{700.0f, 700.0f}};
+  DistributionInputs inputs = straight(1000.0f, 10.0f);
+  inputs.steeringAngle = 0.1f;
+
+  DistributionOutput output = distributeTorque(config, inputs);
+  REQUIRE(output.yawRateTarget > 0.0f);
+  REQUIRE(output.torque[LEFT] < 500.0f);
+  REQUIRE(output.torque[RIGHT] == Approx(700.0f));
+}
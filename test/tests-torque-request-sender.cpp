@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "cfsd-extended-message-set.hpp"
+#include "torque-request-sender.hpp"
+
+#include <climits>
+#include <sstream>
+#include <string>
+
+namespace {
+
+cluon::data::Envelope decode(const TorqueRequestEnvelope &envelope)
+{
+  std::stringstream sstr(std::string(envelope.data(), envelope.size()));
+  auto result = cluon::extractEnvelope(sstr);
+  REQUIRE(result.first);
+  return result.second;
+}
+
+}
+
+TEST_CASE("A preencoded torque request should decode like one sent by OD4Session") {
+  TorqueRequestEnvelope envelope{2101};
+  envelope.encode(1234, -1234, 1530000000123456, 1530000000234567);
+
+  cluon::data::Envelope decoded = decode(envelope);
+  REQUIRE(decoded.dataType() == opendlv::cfsdProxy::TorqueRequestDual::ID());
+  REQUIRE(decoded.senderStamp() == 2101);
+  REQUIRE(cluon::time::toMicroseconds(decoded.sampleTimeStamp()) == 1530000000123456);
+  REQUIRE(cluon::time::toMicroseconds(decoded.sent()) == 1530000000234567);
+
+  auto msg = cluon::extractMessage<opendlv::cfsdProxy::TorqueRequestDual>(std::move(decoded));
+  REQUIRE(msg.torqueLeft() == 1234);
+  REQUIRE(msg.torqueRight() == -1234);
+}
+
+TEST_CASE("Reencoding should only change the patched fields") {
+  TorqueRequestEnvelope envelope{2101};
+  envelope.encode(INT_MAX, INT_MIN, 1, 2);
+  envelope.encode(0, 7, 1530000000000000, 1530000000000001);
+
+  cluon::data::Envelope decoded = decode(envelope);
+  REQUIRE(cluon::time::toMicroseconds(decoded.sampleTimeStamp()) == 1530000000000000);
+  auto msg = cluon::extractMessage<opendlv::cfsdProxy::TorqueRequestDual>(std::move(decoded));
+  REQUIRE(msg.torqueLeft() == 0);
+  REQUIRE(msg.torqueRight() == 7);
+
+  envelope.encode(INT_MAX, INT_MIN, 1, 2);
+  msg = cluon::extractMessage<opendlv::cfsdProxy::TorqueRequestDual>(decode(envelope));
+  REQUIRE(msg.torqueLeft() == INT_MAX);
+  REQUIRE(msg.torqueRight() == INT_MIN);
+}
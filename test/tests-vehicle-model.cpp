@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "vehicle-model.hpp"
+
+#include <cmath>
+
+TEST_CASE("The vehicle should accelerate by the drive force below the friction limit") {
+  VehicleConfig config = defaultVehicleConfig();
+  VehicleState state = initialVehicleState();
+
+  // 5 Nm per motor, 16 * 5 / 0.22 = 364 N per wheel, also spinning up the wheels
+  for (int i = 0; i < 500; i++) {
+    vehicleStep(config, state, {{500.0f, 500.0f}}, 0.001f);
+  }
+  const float rotatingMass = 2.0f * config.wheelInertia / (config.wheelRadius * config.wheelRadius);
+  const float expected = (2.0f * 5.0f * config.gearRatio / config.wheelRadius
+      - config.rollingResistance * config.mass * 9.81f) / (config.mass + rotatingMass);
+  REQUIRE(state.acceleration == Approx(expected).epsilon(0.02));
+  REQUIRE(state.speed == Approx(expected * 0.5f).epsilon(0.05));
+  REQUIRE(state.position == Approx(expected * 0.125f).epsilon(0.05));
+  // Small, positive slip on both driven wheels
+  REQUIRE(state.slip[LEFT] > 0.0f);
+  REQUIRE(state.slip[LEFT] < 0.1f);
+  REQUIRE(state.slip[LEFT] == Approx(state.slip[RIGHT]));
+}
+
+TEST_CASE("Full torque should spin the driven wheels at the friction limit") {
+  VehicleConfig config = defaultVehicleConfig();
+  VehicleState state = initialVehicleState();
+
+  for (int i = 0; i < 1000; i++) {
+    vehicleStep(config, state, {{10000.0f, 10000.0f}}, 0.001f);
+  }
+  // Nearly all weight shifts onto the driven axle at most
+  REQUIRE(state.acceleration > 0.0f);
+  REQUIRE(state.acceleration < config.friction * 9.81f);
+  REQUIRE(state.wheelSpeed[LEFT] > state.speed * 1.1f);
+  REQUIRE(state.motorTorque[LEFT] > 0.0f);
+  REQUIRE(state.motorTorque[LEFT] <= config.motorTorqueMax);
+}
+
+TEST_CASE("A coasting vehicle should come to rest without reversing") {
+  VehicleConfig config = defaultVehicleConfig();
+  VehicleState state = initialVehicleState();
+  state.speed = 10.0f;
+  state.wheelSpeed = {{10.0f, 10.0f}};
+
+  float previous = state.speed;
+  for (int i = 0; i < 60000; i++) {
+    vehicleStep(config, state, {{0.0f, 0.0f}}, 0.001f);
+    REQUIRE(state.speed <= previous);
+    REQUIRE(state.speed >= 0.0f);
+    REQUIRE(state.wheelSpeed[LEFT] >= 0.0f);
+    previous = state.speed;
+  }
+  REQUIRE(state.speed == Approx(0.0f).margin(1e-6f));
+}
+
+TEST_CASE("The wheel dynamics should stay stable at a slow control rate") {
+  VehicleConfig config = defaultVehicleConfig();
+  VehicleState state = initialVehicleState();
+
+  for (int i = 0; i < 500; i++) {
+    vehicleStep(config, state, {{(i % 2 == 0) ? 10000.0f : -10000.0f, 1000.0f}}, 0.02f);
+    REQUIRE(std::isfinite(state.wheelSpeed[LEFT]));
+    REQUIRE(std::fabs(state.slip[RIGHT]) < 1.0f);
+  }
+}
+
+TEST_CASE("A closed-loop acceleration run should cover 75 m in time") {
+  Motion motion;
+  ClosedLoopResult result = runClosedLoop(motion, defaultVehicleConfig(), defaultClosedLoopConfig(),
+      syntheticProfile("acceleration"), nullptr);
+  REQUIRE(result.steps == 8000);
+  REQUIRE(result.distanceTime > 3.5f);
+  REQUIRE(result.distanceTime < 5.0f);
+  REQUIRE(result.maxSpeed < 25.0f + 0.5f);
+  REQUIRE(result.finalSpeed > 20.0f);
+  // Both motors pulling for most of the run
+  REQUIRE(result.effort > 10.0f);
+  REQUIRE(result.effort < 2.0f * 21.0f * 100.0f);
+  REQUIRE(result.jerk > 0.0f);
+
+  // Once the car could have caught up, only the error it settles at is left
+  Motion settledMotion;
+  ClosedLoopConfig config = defaultClosedLoopConfig();
+  config.settleTime = 4.0f;
+  ClosedLoopResult settled = runClosedLoop(settledMotion, defaultVehicleConfig(), config,
+      syntheticProfile("acceleration"), nullptr);
+  REQUIRE(settled.trackingError < result.trackingError);
+  REQUIRE(settled.trackingError == Approx(25.0f - settled.finalSpeed).margin(0.3f));
+}
+
+TEST_CASE("A closed-loop endurance run should track the speed requests") {
+  Motion motion;
+  std::vector<ClosedLoopSample> trace;
+  ClosedLoopResult result = runClosedLoop(motion, defaultVehicleConfig(), defaultClosedLoopConfig(),
+      syntheticProfile("endurance"), &trace);
+  REQUIRE(trace.size() == result.steps);
+  REQUIRE(result.trackingError < 1.0f);
+  // No torque request below the regeneration cutoff
+  for (const ClosedLoopSample &sample : trace) {
+    if (sample.speed < motion.regenCutoffSpeed()) {
+      REQUIRE(sample.torqueRequest[LEFT] >= 0.0f);
+    }
+  }
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018  Love Mowitz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "work-stealing.hpp"
+
+#include <atomic>
+#include <vector>
+
+TEST_CASE("Every index should be processed exactly once") {
+  const uint32_t count = 10007;
+  std::vector<std::atomic<uint32_t>> visits(count);
+  for (auto &v : visits) {
+    v.store(0);
+  }
+
+  // Uneven task cost to make workers steal from each other
+  parallelFor(count, 4, [&visits](uint32_t i) {
+      volatile uint32_t spin = (i < 100) ? 10000 : 0;
+      while (spin > 0) {
+        spin = spin - 1;
+      }
+      visits[i]++;
+    });
+
+  uint32_t wrong{0};
+  for (auto &v : visits) {
+    wrong += (v.load() == 1) ? 0 : 1;
+  }
+  REQUIRE(wrong == 0);
+}
+
+TEST_CASE("An empty range should not call the task") {
+  uint32_t calls{0};
+  parallelFor(0, 4, [&calls](uint32_t) { calls++; });
+  REQUIRE(calls == 0);
+}